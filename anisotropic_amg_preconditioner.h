@@ -0,0 +1,845 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Smoothed aggregation algebraic multigrid for the pressure Schur
+// complement (P) block of the Navier-Stokes preconditioner. Designed
+// to stay robust on the strongly stretched elements in the boundary
+// layer: the aggregates follow the strong couplings (so they become
+// lines of dofs across the stretched elements), the prolongation is
+// smoothed with the filtered matrix, and the smoother solves exactly
+// for all dofs in an aggregate at once (block Gauss-Seidel).
+
+#ifndef ANISOTROPIC_AMG_PRECONDITIONER_HEADER
+#define ANISOTROPIC_AMG_PRECONDITIONER_HEADER
+
+#include "multilevel_helpers.h"
+
+namespace oomph
+{
+
+//======================================================================
+/// \short Smoothed aggregation AMG hierarchy with aggregate-block
+/// Gauss-Seidel smoothing; the scalar type T is used for the storage of
+/// the hierarchy (matrices, prolongations and block factorisations)
+/// while the vectors in the V-cycle are in double precision.
+//======================================================================
+template<class T>
+class SmoothedAggregationAMG
+{
+
+public:
+
+ /// Constructor: Set default parameters
+ SmoothedAggregationAMG() : Strength_threshold(0.08),
+                            Affinity_threshold(0.85),
+                            Ntest_vector(16),
+                            Ntest_sweep(10),
+                            Max_nlevel(20),
+                            Max_coarsest_nrow(200),
+                            Max_block_size(32),
+                            Nsmooth(1),
+                            Doc_hierarchy(true)
+  {}
+
+ /// \short Threshold for strength of connection: i and j can only be 
+ /// strongly connected if |a_ij| >= theta sqrt(|a_ii a_jj|)
+ double& strength_threshold() {return Strength_threshold;}
+
+ /// \short Threshold for the affinity of strongly connected dofs
+ /// (between 0 and 1; see find_strong_connections(...))
+ double& affinity_threshold() {return Affinity_threshold;}
+
+ /// Number of test vectors for strength of connection
+ unsigned& ntest_vector() {return Ntest_vector;}
+
+ /// Number of symmetric Gauss-Seidel sweeps on test vectors
+ unsigned& ntest_sweep() {return Ntest_sweep;}
+
+ /// Max. number of levels
+ unsigned& max_nlevel() {return Max_nlevel;}
+
+ /// Max. number of rows for (direct solve on) coarsest level
+ unsigned& max_coarsest_nrow() {return Max_coarsest_nrow;}
+
+ /// Number of pre- and post-smoothing sweeps
+ unsigned& nsmooth() {return Nsmooth;}
+
+ /// Doc the hierarchy when it's built?
+ bool& doc_hierarchy() {return Doc_hierarchy;}
+
+ /// Number of levels
+ unsigned nlevel() const {return Level.size();}
+
+ /// Number of rows on finest level
+ unsigned nrow() const {return (Level.size()==0 ? 0 : Level[0].A.nrow());}
+
+ /// Build the hierarchy for the matrix a
+ template<class S>
+ void setup(const Multilevel_Helpers::CSRMatrix<S>& a)
+  {
+   clean_up_memory();
+   Level.resize(1);
+   Level[0].A.copy(a);
+   Level[0].A.sort_rows();
+
+   // Coarsen until the matrix is small enough to be solved directly
+   // (or coarsening stagnates)
+   while (Level.size()<Max_nlevel)
+    {
+     unsigned l=Level.size()-1;
+     unsigned n=Level[l].A.nrow();
+     if (n<=Max_coarsest_nrow) break;
+     std::vector<double> affinity;
+     std::vector<bool> is_strong;
+     find_strong_connections(Level[l].A,affinity,is_strong);
+     std::vector<int> aggregate;
+     unsigned naggregate=
+      aggregate_dofs(Level[l].A,affinity,is_strong,aggregate);
+     if ((naggregate==0)||(double(naggregate)>0.8*double(n))) break;
+     setup_block_smoother(Level[l],aggregate,naggregate);
+     Level.resize(l+2);
+     build_prolongation(Level[l].A,is_strong,aggregate,naggregate,
+                        Level[l].P);
+     Multilevel_Helpers::galerkin_product(Level[l].A,Level[l].P,
+                                          Level[l].R,Level[l+1].A);
+    }
+
+   // Coarsest level: direct solve if it's small enough, otherwise
+   // (coarsening stagnated) just smooth
+   unsigned l=Level.size()-1;
+   if (Level[l].A.nrow()<=Max_coarsest_nrow*10)
+    {
+     Multilevel_Helpers::factorise_dense(Level[l].A,Coarsest_lu);
+    }
+   else
+    {
+     std::vector<double> affinity;
+     std::vector<bool> is_strong;
+     find_strong_connections(Level[l].A,affinity,is_strong);
+     std::vector<int> aggregate;
+     unsigned naggregate=
+      aggregate_dofs(Level[l].A,affinity,is_strong,aggregate);
+     setup_block_smoother(Level[l],aggregate,naggregate);
+    }
+
+   // Work vectors
+   for (unsigned k=0;k<Level.size();k++)
+    {
+     unsigned n=Level[k].A.nrow();
+     Level[k].X.assign(n,0.0);
+     Level[k].B.assign(n,0.0);
+     Level[k].Residual.assign(n,0.0);
+    }
+
+   if (Doc_hierarchy)
+    {
+     std::ostringstream doc_stream;
+     doc_hierarchy(doc_stream);
+     oomph_info << doc_stream.str();
+    }
+  }
+
+ /// \short Apply one V-cycle to rhs (with zero initial guess)
+ void solve(const double* rhs, double* soln)
+  {
+   if (Level.size()==0) return;
+   std::copy(rhs,rhs+Level[0].A.nrow(),Level[0].B.begin());
+   vcycle(0);
+   std::copy(Level[0].X.begin(),Level[0].X.end(),soln);
+  }
+
+ /// \short Operator complexity: total number of nonzeros in all levels
+ /// divided by the number of nonzeros on the finest level
+ double operator_complexity() const
+  {
+   if (Level.size()==0) return 0.0;
+   double nnz=0.0;
+   for (unsigned l=0;l<Level.size();l++)
+    {
+     nnz+=Level[l].A.nnz();
+    }
+   return nnz/double(Level[0].A.nnz());
+  }
+
+ /// Doc sizes of levels
+ void doc_hierarchy(std::ostream& outfile) const
+  {
+   outfile << "AMG hierarchy with " << Level.size() << " levels: ";
+   for (unsigned l=0;l<Level.size();l++)
+    {
+     outfile << Level[l].A.nrow() << " ";
+    }
+   outfile << "rows; operator complexity: " << operator_complexity()
+           << std::endl;
+  }
+
+ /// Wipe the hierarchy
+ void clean_up_memory()
+  {
+   Level.clear();
+   Coarsest_lu=Multilevel_Helpers::DenseLU<T>();
+  }
+
+private:
+
+ /// Matrices, smoother and work vectors on a level
+ struct AMGLevel
+ {
+  /// Matrix
+  Multilevel_Helpers::CSRMatrix<T> A;
+
+  /// Prolongation to this level from the next coarser one
+  Multilevel_Helpers::CSRMatrix<T> P;
+
+  /// Restriction from this level to the next coarser one (P^T)
+  Multilevel_Helpers::CSRMatrix<T> R;
+
+  /// Start of each smoother block in Block_dof
+  std::vector<int> Block_start;
+
+  /// Dofs in the smoother blocks
+  std::vector<int> Block_dof;
+
+  /// Start of the LU factors of each block in Block_lu
+  std::vector<int> Block_lu_start;
+
+  /// LU factors of the diagonal blocks
+  std::vector<T> Block_lu;
+
+  /// Pivots of the LU factorisations of the diagonal blocks
+  std::vector<int> Block_pivot;
+
+  /// Solution
+  std::vector<double> X;
+
+  /// Right-hand side
+  std::vector<double> B;
+
+  /// Residual
+  std::vector<double> Residual;
+ };
+
+ /// \short Aggregate the dofs, following the strong connections (three
+ /// phases, as in Vanek, Mandel & Brezina, Computing 56, 1996); returns
+ /// the number of aggregates
+ unsigned aggregate_dofs(const Multilevel_Helpers::CSRMatrix<T>& a,
+                         const std::vector<double>& affinity,
+                         const std::vector<bool>& is_strong,
+                         std::vector<int>& aggregate) const
+  {
+   unsigned n=a.nrow();
+
+   // Strong connections
+   std::vector<int> strong_start(n+1,0);
+   std::vector<int> strong;
+   for (unsigned i=0;i<n;i++)
+    {
+     for (int k=a.Row_start[i];k<a.Row_start[i+1];k++)
+      {
+       if (is_strong[k])
+        {
+         strong.push_back(a.Column_index[k]);
+        }
+      }
+     strong_start[i+1]=strong.size();
+    }
+
+   // Phase 1: Dofs whose strong neighbours are all still free seed an
+   // aggregate that contains them and their strong neighbours
+   aggregate.assign(n,-1);
+   int naggregate=0;
+   for (unsigned i=0;i<n;i++)
+    {
+     if (aggregate[i]>=0) continue;
+     bool all_free=true;
+     for (int k=strong_start[i];k<strong_start[i+1];k++)
+      {
+       if (aggregate[strong[k]]>=0)
+        {
+         all_free=false;
+         break;
+        }
+      }
+     if (!all_free) continue;
+     aggregate[i]=naggregate;
+     for (int k=strong_start[i];k<strong_start[i+1];k++)
+      {
+       aggregate[strong[k]]=naggregate;
+      }
+     naggregate++;
+    }
+
+   // Phase 2: Attach remaining dofs to the aggregate of their strongest
+   // aggregated neighbour (from phase 1)
+   std::vector<int> phase1_aggregate(aggregate);
+   for (unsigned i=0;i<n;i++)
+    {
+     if (phase1_aggregate[i]>=0) continue;
+     double strongest=-1.0;
+     for (int k=a.Row_start[i];k<a.Row_start[i+1];k++)
+      {
+       unsigned j=a.Column_index[k];
+       if (is_strong[k]&&(phase1_aggregate[j]>=0)&&(affinity[k]>strongest))
+        {
+         strongest=affinity[k];
+         aggregate[i]=phase1_aggregate[j];
+        }
+      }
+    }
+
+   // Phase 3: Remaining dofs form aggregates with their free strong
+   // neighbours
+   for (unsigned i=0;i<n;i++)
+    {
+     if (aggregate[i]>=0) continue;
+     aggregate[i]=naggregate;
+     for (int k=strong_start[i];k<strong_start[i+1];k++)
+      {
+       if (aggregate[strong[k]]<0)
+        {
+         aggregate[strong[k]]=naggregate;
+        }
+      }
+     naggregate++;
+    }
+   return naggregate;
+  }
+
+ /// \short Strength of connection. The usual criterion, 
+ /// |a_ij| >= Strength_threshold sqrt(|a_ii a_jj|), is fooled by the
+ /// large "diagonal" couplings of elements with large aspect ratios, so
+ /// we also require the algebraic "affinity" of the dofs to be large
+ /// (Livne & Brandt, SIAM J. Sci. Comput. 34, 2012): A few test vectors
+ /// are relaxed with symmetric Gauss-Seidel on A x = 0, which leaves
+ /// error components that are smooth along the strong couplings only.
+ /// For each nonzero a_ij the affinity is
+ /// c_ij = (x_i.x_j)^2/((x_i.x_i)(x_j.x_j)), where x_i is the vector of
+ /// the values of the test vectors at dof i; it's close to one if
+ /// i and j are strongly coupled. We require c_ij >= Affinity_threshold.
+ /// The aggregates then become lines across the boundary layer.
+ void find_strong_connections(const Multilevel_Helpers::CSRMatrix<T>& a,
+                              std::vector<double>& affinity,
+                              std::vector<bool>& is_strong) const
+  {
+   unsigned n=a.nrow();
+   unsigned nnz=a.nnz();
+   std::vector<T> diag;
+   a.get_diagonal(diag);
+
+   // Random test vectors (deterministic linear congruential generator)
+   unsigned ntest=Ntest_vector;
+   std::vector<double> x(n*ntest);
+   unsigned long seed=12345;
+   for (unsigned k=0;k<n*ntest;k++)
+    {
+     seed=(1103515245*seed+12345)%2147483648UL;
+     x[k]=2.0*double(seed)/2147483648.0-1.0;
+    }
+
+   // Relax
+   std::vector<double> sum(ntest);
+   for (unsigned sweep=0;sweep<2*Ntest_sweep;sweep++)
+    {
+     for (unsigned ii=0;ii<n;ii++)
+      {
+       unsigned i=(sweep%2==0 ? ii : n-1-ii);
+       if (diag[i]==T(0)) continue;
+       std::fill(sum.begin(),sum.end(),0.0);
+       for (int k=a.Row_start[i];k<a.Row_start[i+1];k++)
+        {
+         unsigned j=a.Column_index[k];
+         if (j==i) continue;
+         double a_ij=a.Value[k];
+         for (unsigned t=0;t<ntest;t++)
+          {
+           sum[t]+=a_ij*x[j*ntest+t];
+          }
+        }
+       for (unsigned t=0;t<ntest;t++)
+        {
+         x[i*ntest+t]=-sum[t]/double(diag[i]);
+        }
+      }
+    }
+
+   // Affinities
+   std::vector<double> norm_squared(n,0.0);
+   for (unsigned i=0;i<n;i++)
+    {
+     for (unsigned t=0;t<ntest;t++)
+      {
+       norm_squared[i]+=x[i*ntest+t]*x[i*ntest+t];
+      }
+    }
+   affinity.assign(nnz,0.0);
+   is_strong.assign(nnz,false);
+   for (unsigned i=0;i<n;i++)
+    {
+     for (int k=a.Row_start[i];k<a.Row_start[i+1];k++)
+      {
+       unsigned j=a.Column_index[k];
+       if (j==i) continue;
+       double product=0.0;
+       for (unsigned t=0;t<ntest;t++)
+        {
+         product+=x[i*ntest+t]*x[j*ntest+t];
+        }
+       double denominator=norm_squared[i]*norm_squared[j];
+       if (denominator>0.0)
+        {
+         affinity[k]=product*product/denominator;
+        }
+       is_strong[k]=(affinity[k]>=Affinity_threshold)&&
+        (std::fabs(double(a.Value[k]))>=Strength_threshold*
+         std::sqrt(std::fabs(double(diag[i])*double(diag[j]))));
+      }
+    }
+
+   // Symmetrise
+   std::vector<int> next(a.Row_start.begin(),a.Row_start.end()-1);
+   for (unsigned i=0;i<n;i++)
+    {
+     for (int k=a.Row_start[i];k<a.Row_start[i+1];k++)
+      {
+       unsigned j=a.Column_index[k];
+       if (j<=i) continue;
+       // Find (j,i) (rows are sorted, so we can advance a pointer)
+       while ((next[j]<a.Row_start[j+1])&&
+              (unsigned(a.Column_index[next[j]])<i))
+        {
+         next[j]++;
+        }
+       if ((next[j]<a.Row_start[j+1])&&
+           (unsigned(a.Column_index[next[j]])==i))
+        {
+         bool strong=is_strong[k]||is_strong[next[j]];
+         is_strong[k]=strong;
+         is_strong[next[j]]=strong;
+        }
+      }
+    }
+  }
+
+ /// \short Smoothed prolongation P = (I - omega D_F^{-1} A_F) P_tent,
+ /// where P_tent is the piecewise constant interpolation from the
+ /// aggregates and A_F the matrix with the weak connections lumped onto
+ /// the diagonal; omega = 4/(3 rho(D_F^{-1} A_F)).
+ void build_prolongation(const Multilevel_Helpers::CSRMatrix<T>& a,
+                         const std::vector<bool>& is_strong,
+                         const std::vector<int>& aggregate,
+                         const unsigned& naggregate,
+                         Multilevel_Helpers::CSRMatrix<T>& p) const
+  {
+   unsigned n=a.nrow();
+
+   // Filtered matrix
+   Multilevel_Helpers::CSRMatrix<T> a_filtered;
+   a_filtered.resize(n,n);
+   std::vector<T> diag_filtered(n);
+   for (unsigned i=0;i<n;i++)
+    {
+     T lumped=0;
+     for (int k=a.Row_start[i];k<a.Row_start[i+1];k++)
+      {
+       unsigned j=a.Column_index[k];
+       if ((j==i)||is_strong[k])
+        {
+         a_filtered.Column_index.push_back(j);
+         a_filtered.Value.push_back(a.Value[k]);
+        }
+       else
+        {
+         lumped+=a.Value[k];
+        }
+      }
+     a_filtered.Row_start[i+1]=a_filtered.Column_index.size();
+
+     // Add the lumped weak connections to the diagonal
+     for (int k=a_filtered.Row_start[i];k<a_filtered.Row_start[i+1];k++)
+      {
+       if (unsigned(a_filtered.Column_index[k])==i)
+        {
+         a_filtered.Value[k]+=lumped;
+         diag_filtered[i]=a_filtered.Value[k];
+        }
+      }
+     if (diag_filtered[i]==T(0)) diag_filtered[i]=T(1);
+    }
+
+   // Damping factor
+   double rho=Multilevel_Helpers::spectral_radius_of_jacobi_matrix(
+    a_filtered,diag_filtered);
+   double omega=(rho>0.0 ? 4.0/(3.0*rho) : 0.0);
+
+   // Tentative prolongation
+   Multilevel_Helpers::CSRMatrix<T> p_tent;
+   p_tent.resize(n,naggregate);
+   p_tent.Column_index.resize(n);
+   p_tent.Value.assign(n,T(1));
+   for (unsigned i=0;i<n;i++)
+    {
+     p_tent.Row_start[i+1]=i+1;
+     p_tent.Column_index[i]=aggregate[i];
+    }
+
+   // Smooth it: P = P_tent - omega D_F^{-1} A_F P_tent
+   for (unsigned i=0;i<n;i++)
+    {
+     T scale=T(-omega)/diag_filtered[i];
+     for (int k=a_filtered.Row_start[i];k<a_filtered.Row_start[i+1];k++)
+      {
+       a_filtered.Value[k]*=scale;
+      }
+    }
+   Multilevel_Helpers::CSRMatrix<T> correction;
+   Multilevel_Helpers::multiply(a_filtered,p_tent,correction);
+   p.resize(n,naggregate);
+   for (unsigned i=0;i<n;i++)
+    {
+     for (int k=correction.Row_start[i];k<correction.Row_start[i+1];k++)
+      {
+       p.Column_index.push_back(correction.Column_index[k]);
+       T value=correction.Value[k];
+       if (correction.Column_index[k]==aggregate[i]) value+=T(1);
+       p.Value.push_back(value);
+      }
+     p.Row_start[i+1]=p.Column_index.size();
+    }
+  }
+
+ /// \short Set up the block Gauss-Seidel smoother: the blocks are the
+ /// aggregates (split into chunks of at most Max_block_size dofs);
+ /// their diagonal blocks are LU-factorised
+ void setup_block_smoother(AMGLevel& level,
+                           const std::vector<int>& aggregate,
+                           const unsigned& naggregate) const
+  {
+   const Multilevel_Helpers::CSRMatrix<T>& a=level.A;
+   unsigned n=a.nrow();
+
+   // Sort dofs by aggregate
+   std::vector<int> count(naggregate+1,0);
+   for (unsigned i=0;i<n;i++)
+    {
+     count[aggregate[i]+1]++;
+    }
+   for (unsigned b=0;b<naggregate;b++)
+    {
+     count[b+1]+=count[b];
+    }
+   level.Block_dof.resize(n);
+   std::vector<int> next(count.begin(),count.end()-1);
+   for (unsigned i=0;i<n;i++)
+    {
+     level.Block_dof[next[aggregate[i]]++]=i;
+    }
+
+   // Blocks: aggregates, split if they're too large
+   level.Block_start.clear();
+   for (unsigned b=0;b<naggregate;b++)
+    {
+     for (int start=count[b];start<count[b+1];start+=Max_block_size)
+      {
+       level.Block_start.push_back(start);
+      }
+    }
+   level.Block_start.push_back(n);
+
+   // Factorise the diagonal blocks
+   unsigned nblock=level.Block_start.size()-1;
+   level.Block_lu_start.assign(nblock+1,0);
+   for (unsigned b=0;b<nblock;b++)
+    {
+     int size=level.Block_start[b+1]-level.Block_start[b];
+     level.Block_lu_start[b+1]=level.Block_lu_start[b]+size*size;
+    }
+   level.Block_lu.assign(level.Block_lu_start[nblock],T(0));
+   level.Block_pivot.assign(n,0);
+   std::vector<int> local(n,-1);
+   for (unsigned b=0;b<nblock;b++)
+    {
+     int start=level.Block_start[b];
+     int size=level.Block_start[b+1]-start;
+     for (int l=0;l<size;l++)
+      {
+       local[level.Block_dof[start+l]]=l;
+      }
+     T* lu_pt=&level.Block_lu[level.Block_lu_start[b]];
+     for (int l=0;l<size;l++)
+      {
+       int i=level.Block_dof[start+l];
+       for (int k=a.Row_start[i];k<a.Row_start[i+1];k++)
+        {
+         int m=local[a.Column_index[k]];
+         if (m>=0) lu_pt[l*size+m]+=a.Value[k];
+        }
+      }
+     Multilevel_Helpers::DenseLU<T>::factorise_in_place(
+      size,lu_pt,&level.Block_pivot[start]);
+     for (int l=0;l<size;l++)
+      {
+       local[level.Block_dof[start+l]]=-1;
+      }
+    }
+  }
+
+ /// \short One block Gauss-Seidel sweep over the blocks (forward or
+ /// backward): x_b += A_bb^{-1} (b - A x)_b
+ void block_gauss_seidel(AMGLevel& level, const bool& forward) const
+  {
+   const Multilevel_Helpers::CSRMatrix<T>& a=level.A;
+   unsigned nblock=level.Block_start.size()-1;
+   double* x=&level.X[0];
+   const double* rhs=&level.B[0];
+   double* local_residual=&level.Residual[0];
+   for (unsigned bb=0;bb<nblock;bb++)
+    {
+     unsigned b=(forward ? bb : nblock-1-bb);
+     int start=level.Block_start[b];
+     int size=level.Block_start[b+1]-start;
+     for (int l=0;l<size;l++)
+      {
+       int i=level.Block_dof[start+l];
+       double sum=rhs[i];
+       for (int k=a.Row_start[i];k<a.Row_start[i+1];k++)
+        {
+         sum-=double(a.Value[k])*x[a.Column_index[k]];
+        }
+       local_residual[l]=sum;
+      }
+     Multilevel_Helpers::DenseLU<T>::solve_in_place(
+      size,&level.Block_lu[level.Block_lu_start[b]],
+      &level.Block_pivot[start],local_residual);
+     for (int l=0;l<size;l++)
+      {
+       x[level.Block_dof[start+l]]+=local_residual[l];
+      }
+    }
+  }
+
+ /// V-cycle on level l for the rhs in Level[l].B
+ void vcycle(const unsigned& l)
+  {
+   AMGLevel& level=Level[l];
+   std::fill(level.X.begin(),level.X.end(),0.0);
+
+   // Coarsest level
+   if (l==Level.size()-1)
+    {
+     if (Coarsest_lu.n()==level.A.nrow())
+      {
+       level.X=level.B;
+       Coarsest_lu.solve(&level.X[0]);
+      }
+     else
+      {
+       for (unsigned i=0;i<10*Nsmooth;i++)
+        {
+         block_gauss_seidel(level,true);
+         block_gauss_seidel(level,false);
+        }
+      }
+     return;
+    }
+
+   // Pre-smooth
+   for (unsigned i=0;i<Nsmooth;i++)
+    {
+     block_gauss_seidel(level,true);
+    }
+
+   // Coarse-grid correction
+   level.A.residual(&level.B[0],&level.X[0],&level.Residual[0]);
+   level.R.multiply(&level.Residual[0],&Level[l+1].B[0]);
+   vcycle(l+1);
+   level.P.multiply(&Level[l+1].X[0],&level.Residual[0]);
+   for (unsigned i=0;i<level.X.size();i++)
+    {
+     level.X[i]+=level.Residual[i];
+    }
+
+   // Post-smooth (backward, so the V-cycle is symmetric)
+   for (unsigned i=0;i<Nsmooth;i++)
+    {
+     block_gauss_seidel(level,false);
+    }
+  }
+
+ /// Threshold for strength of connection
+ double Strength_threshold;
+
+ /// Threshold for affinity of strongly connected dofs
+ double Affinity_threshold;
+
+ /// Number of test vectors for strength of connection
+ unsigned Ntest_vector;
+
+ /// Number of symmetric Gauss-Seidel sweeps on test vectors
+ unsigned Ntest_sweep;
+
+ /// Max. number of levels
+ unsigned Max_nlevel;
+
+ /// Max. number of rows on coarsest level
+ unsigned Max_coarsest_nrow;
+
+ /// Max. number of dofs in smoother block
+ unsigned Max_block_size;
+
+ /// Number of pre- and post-smoothing sweeps
+ unsigned Nsmooth;
+
+ /// Doc the hierarchy when it's built?
+ bool Doc_hierarchy;
+
+ /// The levels
+ std::vector<AMGLevel> Level;
+
+ /// LU factors of the matrix on the coarsest level
+ Multilevel_Helpers::DenseLU<T> Coarsest_lu;
+
+};
+
+
+
+
+//////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////
+
+
+
+
+//======================================================================
+/// \short Preconditioner that applies one V-cycle of smoothed aggregation
+/// AMG with aggregate-block Gauss-Seidel smoothing. Meant for the
+/// (pressure Poisson-like) Schur complement block of the Navier-Stokes
+/// preconditioner on meshes with strongly stretched elements. The
+/// hierarchy is stored in the scalar type T (float halves its memory
+/// and the memory traffic of the V-cycle; the vectors remain in double
+/// precision). Serial matrices only.
+//======================================================================
+template<class T>
+class AnisotropicAMGPreconditioner : public Preconditioner
+{
+
+public:
+
+ /// Constructor
+ AnisotropicAMGPreconditioner() {}
+
+ /// Destructor
+ ~AnisotropicAMGPreconditioner()
+  {
+   clean_up_memory();
+  }
+
+ /// Broken copy constructor
+ AnisotropicAMGPreconditioner(const AnisotropicAMGPreconditioner&)
+  {
+   BrokenCopy::broken_copy("AnisotropicAMGPreconditioner");
+  }
+
+ /// Broken assignment operator
+ void operator=(const AnisotropicAMGPreconditioner&)
+  {
+   BrokenCopy::broken_assign("AnisotropicAMGPreconditioner");
+  }
+
+ /// Access to the AMG hierarchy (e.g. to set its parameters)
+ SmoothedAggregationAMG<T>& amg() {return AMG;}
+
+ /// Build the AMG hierarchy for the matrix
+ void setup()
+  {
+   double t_start=TimingHelpers::timer();
+   CRDoubleMatrix* cr_matrix_pt=dynamic_cast<CRDoubleMatrix*>(matrix_pt());
+   if (cr_matrix_pt==0)
+    {
+     throw OomphLibError("AnisotropicAMGPreconditioner needs CRDoubleMatrix",
+                         OOMPH_CURRENT_FUNCTION,
+                         OOMPH_EXCEPTION_LOCATION);
+    }
+#ifdef PARANOID
+   if (cr_matrix_pt->distributed())
+    {
+     throw OomphLibError(
+      "AnisotropicAMGPreconditioner only works for serial matrices",
+      OOMPH_CURRENT_FUNCTION,
+      OOMPH_EXCEPTION_LOCATION);
+    }
+#endif
+   Multilevel_Helpers::CSRMatrix<double> matrix;
+   copy_cr_matrix(cr_matrix_pt,matrix);
+   AMG.setup(matrix);
+
+   oomph_info << "Time for setup of AMG preconditioner: "
+              << TimingHelpers::timer()-t_start << " sec" << std::endl;
+  }
+
+ /// Apply one V-cycle
+ void preconditioner_solve(const DoubleVector& r, DoubleVector& z)
+  {
+   z.build(r.distribution_pt(),0.0);
+   AMG.solve(r.values_pt(),z.values_pt());
+  }
+
+ /// Clean up memory
+ void clean_up_memory()
+  {
+   AMG.clean_up_memory();
+  }
+
+ /// \short Copy oomph-lib's CRDoubleMatrix into a CSRMatrix
+ /// (with the scalar type of the latter)
+ template<class S>
+ static void copy_cr_matrix(CRDoubleMatrix* cr_matrix_pt,
+                            Multilevel_Helpers::CSRMatrix<S>& matrix)
+  {
+   unsigned nrow=cr_matrix_pt->nrow();
+   unsigned nnz=cr_matrix_pt->nnz();
+   const int* row_start=cr_matrix_pt->row_start();
+   const int* column_index=cr_matrix_pt->column_index();
+   const double* value=cr_matrix_pt->value();
+   matrix.resize(nrow,cr_matrix_pt->ncol());
+   matrix.Row_start.assign(row_start,row_start+nrow+1);
+   matrix.Column_index.assign(column_index,column_index+nnz);
+   matrix.Value.resize(nnz);
+   for (unsigned k=0;k<nnz;k++)
+    {
+     matrix.Value[k]=S(value[k]);
+    }
+  }
+
+private:
+
+ /// The AMG hierarchy
+ SmoothedAggregationAMG<T> AMG;
+
+};
+
+} // end of namespace oomph
+
+#endif
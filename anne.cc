@@ -33,10 +33,54 @@
 #include "generic.h"
 #include "navier_stokes.h"
 
+// POSIX headers for (memory-mapped) checkpoint i/o
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// POSIX headers for the worker processes of ensemble runs
+#include <sys/types.h>
+#include <sys/wait.h>
+
 // The mesh
 #include "meshes/rectangular_quadmesh.h"
 #include "vorticity_smoother.h"
 
+// Compressed snapshots and snapshot archive
+#include "snapshot_compression.h"
+#include "snapshot_archive.h"
+
+// AMG for the pressure Schur complement block
+#include "anisotropic_amg_preconditioner.h"
+
+// Geometric multigrid for the momentum block
+#include "structured_gmg_preconditioner.h"
+
+// Multithreaded assembly
+#include "threaded_assembly.h"
+
+// Renumbering of nodes and elements
+#include "mesh_renumbering.h"
+
+// Per-timestep log of solver statistics and timings
+#include "solver_telemetry.h"
+
+// Jacobian-free GMRES
+#include "matrix_free_jacobian.h"
+
+// Algebraic pressure-correction solver
+#include "pressure_correction_solver.h"
+
+// Parallel-in-time integration
+#include "parareal.h"
+
+// Static condensation of the element-interior unknowns
+#include "static_condensation.h"
+
+// Krylov solver with subspace recycling
+#include "gcrodr.h"
+
 using namespace std;
 using namespace oomph;
 
@@ -56,6 +100,131 @@ namespace Mumps_Subsidiary_Preconditioner_Helper
 #endif
 
 
+//=============================================================================
+/// \short Helper for the block diagonal F block preconditioner to allow
+/// geometric multigrid to be used as subsidiary block preconditioner.
+/// The block diagonal preconditioner creates the subsidiary
+/// preconditioners for the velocity components in order, so we cycle
+/// through the components.
+//=============================================================================
+namespace Structured_GMG_Subsidiary_Preconditioner_Helper
+{
+ /// The (structured) Navier-Stokes mesh
+ Mesh* Mesh_pt=0;
+
+ /// Number of velocity components
+ unsigned Nvelocity_component=2;
+
+ /// Velocity component for the next subsidiary preconditioner
+ unsigned Next_velocity_component=0;
+
+ /// Store the multigrid hierarchies in single precision?
+ bool Single_precision=false;
+
+ /// Create the GMG preconditioner for the next velocity component
+ Preconditioner* set_structured_gmg_preconditioner()
+ {
+  unsigned i=Next_velocity_component;
+  Next_velocity_component=(Next_velocity_component+1)%Nvelocity_component;
+  if (Single_precision)
+   {
+    return new StructuredGMGPreconditioner<float>(Mesh_pt,i);
+   }
+  return new StructuredGMGPreconditioner<double>(Mesh_pt,i);
+ }
+}
+
+
+//=============================================================================
+/// \short Helper for the block diagonal F block preconditioner to allow
+/// the direct solves for the velocity components to be done with static
+/// condensation of the unknowns at the element-interior nodes. As for
+/// GMG, the subsidiary preconditioners are created for the velocity
+/// components in order.
+//=============================================================================
+namespace Static_Condensation_Subsidiary_Preconditioner_Helper
+{
+ /// The Navier-Stokes mesh
+ Mesh* Mesh_pt=0;
+
+ /// Number of velocity components
+ unsigned Nvelocity_component=2;
+
+ /// Velocity component for the next subsidiary preconditioner
+ unsigned Next_velocity_component=0;
+
+ /// \short Create the preconditioner for the next velocity component
+ /// (MUMPS, if available, or SuperLU for the reduced block)
+ Preconditioner* set_static_condensation_preconditioner()
+ {
+  unsigned i=Next_velocity_component;
+  Next_velocity_component=(Next_velocity_component+1)%Nvelocity_component;
+#ifdef OOMPH_HAS_MUMPS
+  return new StaticCondensationPreconditioner(Mesh_pt,i,
+                                              new NewMumpsPreconditioner);
+#else
+  return new StaticCondensationPreconditioner(Mesh_pt,i,
+                                              new SuperLUPreconditioner);
+#endif
+ }
+}
+
+
+//=============================================================================
+/// Helper functions for the initial guess for the Newton iteration in
+/// a timestep
+//=============================================================================
+namespace Initial_Guess_Helper
+{
+ /// \short Replace the current unpinned values of the Data by their
+ /// (second-order) linear extrapolation from the previous two timesteps,
+ /// u_0 = u_1 + dt_0/dt_1 (u_1 - u_2), where dt_0 is the current
+ /// timestep and dt_1 the previous one. Needs (at least) two history 
+ /// values, e.g. from BDF<2>.
+ void extrapolate_from_history(Data* data_pt, const double& dt0, 
+                               const double& dt1)
+ {
+  double ratio=dt0/dt1;
+  unsigned nvalue=data_pt->nvalue();
+  for (unsigned i=0;i<nvalue;i++)
+   {
+    if (!data_pt->is_pinned(i))
+     {
+      double u1=data_pt->value(1,i);
+      double u2=data_pt->value(2,i);
+      data_pt->set_value(0,i,u1+ratio*(u1-u2));
+     }
+   }
+ }
+
+ /// \short Extrapolate the unpinned nodal and internal values in the 
+ /// mesh from the previous two timesteps. Call this after the time values
+ /// have been shifted and the time has been advanced, e.g. in 
+ /// Problem::actions_before_implicit_timestep().
+ void extrapolate_from_history(Mesh* mesh_pt, Time* time_pt)
+ {
+  double dt0=time_pt->dt(0);
+  double dt1=time_pt->dt(1);
+  unsigned nnod=mesh_pt->nnode();
+  for (unsigned j=0;j<nnod;j++)
+   {
+    extrapolate_from_history(mesh_pt->node_pt(j),dt0,dt1);
+   }
+  unsigned nel=mesh_pt->nelement();
+  for (unsigned e=0;e<nel;e++)
+   {
+    GeneralisedElement* el_pt=mesh_pt->element_pt(e);
+    unsigned nint=el_pt->ninternal_data();
+    for (unsigned i=0;i<nint;i++)
+     {
+      extrapolate_from_history(el_pt->internal_data_pt(i),dt0,dt1);
+     }
+   }
+ }
+}
+
+
+
 //===start_of_namespace=================================================
 /// Namespace for global parameters
 //======================================================================
@@ -116,6 +285,171 @@ namespace Global_Parameters
  /// Uniform background flow
  double K=0.02812;
 
+
+ // Checkpointing
+ //--------------
+
+ /// \short Number of timesteps between checkpoints (0: don't write 
+ /// any checkpoints)
+ unsigned Checkpoint_interval=0;
+
+ /// Name of checkpoint file to restart from (empty: start from scratch)
+ std::string Restart_file="";
+
+
+ // Compressed output
+ //------------------
+
+ /// Error bound for horizontal velocity in compressed output
+ double Error_bound_u=1.0e-6;
+
+ /// Error bound for vertical velocity in compressed output
+ double Error_bound_v=1.0e-6;
+
+ /// Error bound for pressure in compressed output
+ double Error_bound_p=1.0e-6;
+
+ /// Error bound for (smoothed) vorticity in compressed output
+ double Error_bound_omega=1.0e-5;
+
+ /// Max. number of timesteps in snapshot archive
+ unsigned Archive_max_nstep=2000;
+
+
+ // Resampling onto uniform grid
+ //-----------------------------
+
+ /// \short Number of points in x direction of uniform grid onto which
+ /// the solution is resampled (0: no resampling)
+ unsigned Uniform_grid_nx=0;
+
+ /// Number of points in y direction of uniform grid
+ unsigned Uniform_grid_ny=0;
+
+
+ // Adaptive timestepping
+ //----------------------
+
+ /// Target for global temporal error norm in adaptive timestepping
+ double Temporal_error_tolerance=1.0e-4;
+
+ /// \short Interval between outputs in adaptive timestepping (the 
+ /// solution is interpolated to these times)
+ double Dt_output=0.1;
+
+
+ // Preconditioner reuse
+ //---------------------
+
+ /// \short Max. number of timesteps for which the preconditioner is
+ /// re-used (if --reuse_preconditioner is specified)
+ unsigned Preconditioner_reuse_nstep=10;
+
+ /// \short Preconditioner is set up again if the number of GMRES 
+ /// iterations exceeds this factor times the number of iterations
+ /// in the first solve after the last setup
+ double Preconditioner_reuse_iteration_factor=2.0;
+
+
+ // Adaptive GMRES tolerance (Eisenstat-Walker)
+ //--------------------------------------------
+
+ /// \short Relative GMRES tolerance (forcing term) for the first Newton
+ /// step in a timestep (if --eisenstat_walker is specified)
+ double Eisenstat_walker_eta_initial=0.5;
+
+ /// Max. forcing term
+ double Eisenstat_walker_eta_max=0.9;
+
+ /// \short Parameters in the forcing term 
+ /// eta_k = gamma (|F_k|/|F_{k-1}|)^alpha
+ double Eisenstat_walker_gamma=0.9;
+ double Eisenstat_walker_alpha=2.0;
+
+
+ // Krylov subspace recycling (GCRO-DR)
+ //------------------------------------
+
+ /// \short Max. dimension of the search space in a cycle (recycled and
+ /// Krylov vectors)
+ unsigned Gcrodr_krylov_dimension=40;
+
+ /// Number of recycled vectors
+ unsigned Gcrodr_nrecycle=10;
+
+
+ // AMG for pressure Schur complement block
+ //----------------------------------------
+
+ /// \short Threshold for strength of connection in AMG: i and j can
+ /// only be strongly connected if |a_ij| >= theta sqrt(|a_ii a_jj|)
+ double Amg_strength_threshold=0.08;
+
+ /// \short Threshold for the affinity of strongly connected dofs in AMG
+ /// (between 0 and 1; larger values give more line-like aggregates)
+ double Amg_affinity_threshold=0.85;
+
+
+ // Assembly
+ //---------
+
+ /// \short Number of threads for the assembly of residuals and Jacobian
+ /// (if --nthread is specified)
+ unsigned Nthread=1;
+
+ /// \short Renumbering of nodes and elements (and hence equations) after
+ /// the mesh has been built: "rcm" or "hilbert" (if --renumber is 
+ /// specified)
+ std::string Renumbering_method="rcm";
+
+
+ // Parareal
+ //---------
+
+ /// Number of time slices for the no-slip phase (if --parareal)
+ unsigned Parareal_nslice=8;
+
+ /// Max. number of processes for the fine propagations
+ unsigned Parareal_nproc=8;
+
+ /// Max. number of Parareal iterations
+ unsigned Parareal_max_iter=5;
+
+ /// \short Tolerance for the max. relative change of the slice end
+ /// states in a Parareal iteration
+ double Parareal_tolerance=1.0e-6;
+
+ /// \short Timestep of the coarse propagator relative to the (fine)
+ /// timestep
+ double Parareal_coarse_dt_factor=10.0;
+
+
+ // Coarse startup
+ //---------------
+
+ /// \short Mesh scaling factor for the startup phase on a coarser mesh
+ /// (if --coarse_startup_mesh_scaling_factor is specified)
+ double Coarse_startup_mesh_scaling_factor=0.25;
+
+ /// \short Number of timesteps on the coarser mesh (at most up to the
+ /// switch-over to no slip)
+ unsigned Coarse_startup_nstep=10;
+
+
+ // Ensemble runs
+ //--------------
+
+ /// \short Comma-separated list of Reynolds numbers for an ensemble run
+ /// (if --ensemble_re is specified)
+ std::string Ensemble_re="";
+
+ /// \short Comma-separated list of mesh scaling factors for an ensemble
+ /// run (if --ensemble_mesh_scaling_factor is specified)
+ std::string Ensemble_mesh_scaling_factor="";
+
+ /// Max. number of ensemble members that run at the same time
+ unsigned Ensemble_nproc=4;
+
  /// Initial condition for velocity
  void initial_condition(const Vector<double>& x, Vector<double>& u)
  {
@@ -247,6 +581,221 @@ namespace Global_Parameters
 } // end of namespace
 
 
+
+//=============================================================================
+/// \short Create the AMG preconditioner for the pressure Schur complement,
+/// storing its multigrid hierarchy in precision T (float or double)
+//=============================================================================
+template<class T>
+Preconditioner* make_amg_p_preconditioner()
+{
+ AnisotropicAMGPreconditioner<T>* amg_pt=new AnisotropicAMGPreconditioner<T>;
+ amg_pt->amg().strength_threshold()=
+  Global_Parameters::Amg_strength_threshold;
+ amg_pt->amg().affinity_threshold()=
+  Global_Parameters::Amg_affinity_threshold;
+ return amg_pt;
+}
+
+
+
+//=============================================================================
+/// \short Helper functions for ensemble runs: all combinations of the
+/// Reynolds numbers and mesh scaling factors specified with --ensemble_re
+/// and --ensemble_mesh_scaling_factor are run in separate worker 
+/// processes. The problem is built once for each mesh scaling factor,
+/// together with the structures that only depend on the mesh (sparsity
+/// pattern of the Jacobian, vorticity recovery patches), and the members
+/// with that factor are forked from it. They therefore don't rebuild
+/// these and share their memory pages (copy-on-write) for as long as 
+/// they're only read. Each member writes to its own subdirectory of the
+/// output directory. Since the members are forked, ensemble runs aren't
+/// available in MPI builds.
+//=============================================================================
+namespace Ensemble_Helper
+{
+ /// Wall clock time at the start of the ensemble run
+ double Start_time=0.0;
+
+ /// \short Parse comma-separated list of doubles (the default value if
+ /// the list is empty)
+ void parse_list(const std::string& list, const double& default_value,
+                 std::vector<double>& value)
+ {
+  value.clear();
+  std::istringstream list_stream(list);
+  std::string entry;
+  while (std::getline(list_stream,entry,','))
+   {
+    if (entry!="") value.push_back(atof(entry.c_str()));
+   }
+  if (value.empty()) value.push_back(default_value);
+ }
+
+ /// Is this an ensemble run?
+ bool is_ensemble_run()
+ {
+  return CommandLineArgs::command_line_flag_has_been_set("--ensemble_re")||
+   CommandLineArgs::command_line_flag_has_been_set(
+    "--ensemble_mesh_scaling_factor");
+ }
+
+ /// \short Wait for one of the worker processes; returns its pid (and
+ /// its exit status in status) or -1 if there are none
+ pid_t wait_for_worker(int& status)
+ {
+  status=0;
+  pid_t pid=wait(&status);
+  if ((pid>0)&&WIFEXITED(status))
+   {
+    status=WEXITSTATUS(status);
+   }
+  else if (pid>0)
+   {
+    status=-1;
+   }
+  return pid;
+ }
+
+ /// \short Run a process for each mesh scaling factor, one after the
+ /// other. Only returns in these processes (with 
+ /// Global_Parameters::Mesh_scaling_factor set); the parent process 
+ /// waits for them, reports the throughput and exits.
+ void fork_mesh_groups(const std::string& directory)
+ {
+#ifdef OOMPH_HAS_MPI
+  // MPI doesn't survive fork()
+  throw OomphLibError(
+   "Ensemble runs fork processes, so they aren't available in MPI builds",
+   OOMPH_CURRENT_FUNCTION,
+   OOMPH_EXCEPTION_LOCATION);
+#endif
+
+  std::vector<double> mesh_scaling_factor;
+  parse_list(Global_Parameters::Ensemble_mesh_scaling_factor,
+             Global_Parameters::Mesh_scaling_factor,mesh_scaling_factor);
+  std::vector<double> re;
+  parse_list(Global_Parameters::Ensemble_re,Global_Parameters::Re,re);
+
+  // Log of the members (written by the group processes)
+  std::string log_filename=directory+"/ensemble.dat";
+  {
+   std::ofstream log_file(log_filename.c_str());
+   log_file << "# Re, mesh scaling factor, exit status, wall clock time [s]"
+            << std::endl;
+  }
+
+  Start_time=TimingHelpers::timer();
+  unsigned ngroup=mesh_scaling_factor.size();
+  unsigned nfailed=0;
+  for (unsigned g=0;g<ngroup;g++)
+   {
+    pid_t pid=fork();
+    if (pid==0)
+     {
+      Global_Parameters::Mesh_scaling_factor=mesh_scaling_factor[g];
+      return;
+     }
+    if (pid<0)
+     {
+      throw OomphLibError("Ensemble: fork() failed",
+                          OOMPH_CURRENT_FUNCTION,
+                          OOMPH_EXCEPTION_LOCATION);
+     }
+    int status=0;
+    pid_t finished=0;
+    do
+     {
+      finished=wait_for_worker(status);
+     }
+    while ((finished!=pid)&&(finished>0));
+    if (status!=0) nfailed++;
+   }
+
+  double wall_time=TimingHelpers::timer()-Start_time;
+  unsigned nmember=ngroup*re.size();
+  oomph_info << "Ensemble of " << nmember << " members finished in "
+             << wall_time << " sec";
+  if (nfailed>0)
+   {
+    oomph_info << " (" << nfailed << " mesh group(s) had failures; see "
+               << log_filename << ")";
+   }
+  oomph_info << "\nThroughput: " << double(nmember)/wall_time*3600.0 
+             << " members per hour" << std::endl;
+  exit(nfailed==0 ? 0 : 1);
+ }
+
+ /// \short Run a process for each Reynolds number (at most
+ /// Global_Parameters::Ensemble_nproc at a time), forked from the
+ /// problem that has just been built (and whose mesh-dependent
+ /// structures have been set up). Only returns in these processes
+ /// (with Global_Parameters::Re set and the output directory set to the
+ /// member's subdirectory); the group process waits for them, logs their
+ /// exit status and wall clock time, and exits.
+ void fork_members(DocInfo& doc_info)
+ {
+  std::vector<double> re;
+  parse_list(Global_Parameters::Ensemble_re,Global_Parameters::Re,re);
+  unsigned nmember=re.size();
+  std::string log_filename=doc_info.directory()+"/ensemble.dat";
+
+  std::map<pid_t,unsigned> member_of_pid;
+  std::vector<double> member_start_time(nmember,0.0);
+  unsigned next=0;
+  unsigned nfailed=0;
+  while ((next<nmember)||(!member_of_pid.empty()))
+   {
+    if ((next<nmember)&&
+        (member_of_pid.size()<std::max(1u,Global_Parameters::Ensemble_nproc)))
+     {
+      // Output directory of the member
+      std::ostringstream member_directory;
+      member_directory << doc_info.directory() << "/re" << re[next] 
+                       << "_msf" << Global_Parameters::Mesh_scaling_factor;
+      member_start_time[next]=TimingHelpers::timer();
+      pid_t pid=fork();
+      if (pid==0)
+       {
+        Global_Parameters::Re=re[next];
+        mkdir(member_directory.str().c_str(),0755);
+        doc_info.set_directory(member_directory.str());
+
+        // Screen output of the member goes to a file in its directory
+        std::string output_filename=member_directory.str()+"/output.txt";
+        oomph_info.stream_pt()=new std::ofstream(output_filename.c_str());
+        return;
+       }
+      if (pid<0)
+       {
+        throw OomphLibError("Ensemble: fork() failed",
+                            OOMPH_CURRENT_FUNCTION,
+                            OOMPH_EXCEPTION_LOCATION);
+       }
+      member_of_pid[pid]=next;
+      next++;
+     }
+    else
+     {
+      int status=0;
+      pid_t pid=wait_for_worker(status);
+      if (pid<0) break;
+      if (member_of_pid.count(pid)==0) continue;
+      unsigned m=member_of_pid[pid];
+      member_of_pid.erase(pid);
+      if (status!=0) nfailed++;
+      std::ofstream log_file(log_filename.c_str(),std::ios::app);
+      log_file << re[m] << " " << Global_Parameters::Mesh_scaling_factor
+               << " " << status << " " 
+               << TimingHelpers::timer()-member_start_time[m] << std::endl;
+     }
+   }
+  exit(nfailed==0 ? 0 : 1);
+ }
+}
+
+
+
 //===start_of_problem_class=============================================
 /// Problem class for Anne's MSc problem
 //======================================================================
@@ -258,11 +807,112 @@ public:
  /// Constructor:
  AnneProblem();
 
+ /// Destructor: Close snapshot archive (if any)
+ ~AnneProblem()
+  {
+   delete Archive_writer_pt;
+   delete Threaded_assembler_pt;
+  }
+
+ /// \short Get the residuals (multithreaded if --nthread is specified)
+ void get_residuals(DoubleVector& residuals)
+  {
+   double t_start=TimingHelpers::timer();
+   if (Threaded_assembler_pt!=0)
+    {
+     Threaded_assembler_pt->get_residuals(residuals);
+    }
+   else
+    {
+     Problem::get_residuals(residuals);
+    }
+   Telemetry.add_residual_time(TimingHelpers::timer()-t_start);
+   Max_residual=max_abs_value(residuals);
+   Residual_norm=residuals.norm();
+   Telemetry.add_max_residual(Max_residual);
+  }
+
+ /// \short Get the residuals and the Jacobian (multithreaded if 
+ /// --nthread is specified)
+ void get_jacobian(DoubleVector& residuals, CRDoubleMatrix& jacobian)
+  {
+   double t_start=TimingHelpers::timer();
+   if (Threaded_assembler_pt!=0)
+    {
+     Threaded_assembler_pt->get_jacobian(residuals,jacobian);
+    }
+   else
+    {
+     Problem::get_jacobian(residuals,jacobian);
+    }
+   Telemetry.add_jacobian_time(TimingHelpers::timer()-t_start);
+  }
+
+ /// Other versions of get_jacobian(...) are the Problem's
+ using Problem::get_jacobian;
+
  //Update before solve is empty
  void actions_before_newton_solve() {}
 
  /// \short Update after solve is empty
  void actions_after_newton_solve() {}
+
+ /// \short Before timestep: Age the preconditioner (if it's re-used) 
+ /// and extrapolate the initial guess for the Newton iteration from the
+ /// history values (if --extrapolate_initial_guess or 
+ /// --linearised_timestepping is specified; otherwise we start from the
+ /// previous solution)
+ void actions_before_implicit_timestep()
+  {
+   Telemetry.add_attempt();
+   Nstep_since_preconditioner_setup++;
+   Nnewton_iter_in_timestep=0;
+   Ngmres_iter_in_timestep=0;
+   Ngmres_iter_with_fixed_tolerance_in_timestep=0.0;
+
+   // Residuals from the previous timestep are no use for the GMRES
+   // forcing term (see set_gmres_forcing_term())
+   Residual_norm=0.0;
+   Previous_residual_norm=0.0;
+
+   if (CommandLineArgs::command_line_flag_has_been_set(
+        "--extrapolate_initial_guess")||
+       CommandLineArgs::command_line_flag_has_been_set(
+        "--linearised_timestepping"))
+    {
+     Initial_Guess_Helper::extrapolate_from_history(mesh_pt(),time_pt());
+    }
+  }
+
+ /// After timestep: Doc the number of Newton iterations
+ void actions_after_implicit_timestep()
+  {
+   Nnewton_iter_total+=Nnewton_iter_in_timestep;
+   Ntimestep_total++;
+   oomph_info << "Newton iterations in this timestep: " 
+              << Nnewton_iter_in_timestep << "; average over " 
+              << Ntimestep_total << " timesteps: " 
+              << double(Nnewton_iter_total)/double(Ntimestep_total) 
+              << std::endl;
+   if (Eisenstat_walker)
+    {
+     oomph_info << "GMRES iterations in this timestep: " 
+                << Ngmres_iter_in_timestep << " (approx. " 
+                << unsigned(Ngmres_iter_with_fixed_tolerance_in_timestep+0.5)
+                << " with fixed tolerance " << Fixed_gmres_tolerance 
+                << ")" << std::endl;
+    }
+  }
+
+ /// \short Before Newton step: Set the GMRES tolerance (if 
+ /// --eisenstat_walker is specified) and decide if the preconditioner is
+ /// to be set up again or re-used (if --reuse_preconditioner is
+ /// specified)
+ void actions_before_newton_step();
+
+ /// \short After Newton step: Monitor the GMRES iterations with the
+ /// re-used preconditioner
+ void actions_after_newton_step();
  
  /// Actions before adapt: empty
  void actions_before_adapt(){} 
@@ -271,13 +921,58 @@ public:
  void actions_after_adapt()
   {
    complete_problem_setup();
+
+   // Points of the uniform grid have to be re-located
+   Uniform_grid_element_pt.clear();
+
+   // Nodes and elements have changed
+   Snapshot_mesh_is_up_to_date=false;
+   Vorticity_recoverer_pt->invalidate_patches();
+
+   // Equation numbers have changed
+   if (Threaded_assembler_pt!=0)
+    {
+     Threaded_assembler_pt->invalidate_sparsity_pattern();
+    }
   }
    
+ /// \short Build the structures that only depend on the mesh and the
+ /// equation numbering (the stored sparsity pattern of the Jacobian, if
+ /// it's re-used, and the patches for the vorticity recovery) now rather
+ /// than when they're first needed, e.g. so that the processes forked 
+ /// from this one share them.
+ void setup_mesh_dependent_structures()
+  {
+   if (Threaded_assembler_pt!=0)
+    {
+     // (In a single thread: OpenMP's threads don't survive a fork())
+     unsigned nthread=Threaded_assembler_pt->nthread();
+     Threaded_assembler_pt->nthread()=1;
+     Threaded_assembler_pt->setup_sparsity_pattern();
+     Threaded_assembler_pt->nthread()=nthread;
+    }
+   Vorticity_recoverer_pt->setup_patches(mesh_pt());
+  }
+
  /// Doc the solution
  void doc_solution(DocInfo& doc_info);
 
- /// Impose no slip and re-assign eqn numbers
- void impose_no_slip_on_bottom_boundary();
+ /// \short Impose no slip and re-assign eqn numbers. If impulsive is
+ /// true, the history values of the horizontal velocity on the 
+ /// bottom boundary are reset too, so the switch acts like an impulsive 
+ /// start of the boundary condition (and doesn't pollute the temporal 
+ /// error estimate in adaptive timestepping).
+ void impose_no_slip_on_bottom_boundary(const bool& impulsive=false);
+
+ /// \short Global temporal error norm for adaptive timestepping: RMS
+ /// of the estimated temporal errors in the velocities at the nodes
+ double global_temporal_error_norm();
+
+ /// \short Doc the solution at time t_output (between the current
+ /// time and the previous one), obtained by quadratic interpolation 
+ /// of the current and two previous timesteps; the current values are
+ /// restored afterwards.
+ void doc_solution_at_time(DocInfo& doc_info, const double& t_output);
 
 /// Assign synthetic flow field
  void assign_synthetic_veloc_field();
@@ -285,11 +980,160 @@ public:
  /// Check vorticity smoothing
  void check_smoothed_vorticity(DocInfo& doc_info);
 
+ /// \short Per-timestep log of solver statistics and timings
+ SolverTelemetry& telemetry() {return Telemetry;}
+
+ /// Has no slip been imposed on the bottom boundary?
+ bool no_slip_on_bottom_boundary() const 
+  {
+   return No_slip_on_bottom_boundary;
+  }
+
+ /// \short Write binary checkpoint (all nodal values and their history,
+ /// time, dts, no-slip state, timestep and doc counter) to specified 
+ /// file. The data is written to a temporary file which is then renamed,
+ /// so an existing checkpoint is never left half-written.
+ void write_checkpoint(const std::string& filename,
+                       const unsigned& timestep,
+                       const unsigned& doc_number);
+
+ /// \short Restart from binary checkpoint in specified file (which is 
+ /// memory-mapped); returns the number of the timestep that was
+ /// completed when the checkpoint was written and the doc counter.
+ void read_checkpoint(const std::string& filename,
+                      unsigned& timestep,
+                      unsigned& doc_number);
+
+ /// \short Take over the solution (and its history), time and 
+ /// timesteps from a problem on a different (e.g. coarser) mesh, by
+ /// projection
+ void project_from(AnneProblem<ELEMENT>* other_problem_pt);
+
+ /// \short Cheaper alternative to project_from(...) if the result is 
+ /// only to be documented: Interpolate the velocities and pressure (at
+ /// all time levels) from a problem on a different mesh to the nodes,
+ /// and take over its time and timesteps
+ void interpolate_from(AnneProblem<ELEMENT>* other_problem_pt);
+
+ /// \short Solve for the next nstep timesteps (of size dt) with 
+ /// Parareal and doc the solution at the ends of the time slices
+ void parareal_solve(DocInfo& doc_info, const unsigned& nstep,
+                     const double& dt);
+
+ /// \short State of the problem (e.g. for Parareal or to replay the 
+ /// coarse startup): all nodal values at all time levels, the history
+ /// values interpolated to the times t-dt_history, t-2 dt_history, ...
+ void get_state_with_history(std::vector<double>& state,
+                             const double& dt_history);
+
+ /// \short Set the state (see get_state_with_history(...)) at the given
+ /// time
+ void set_state_with_history(const std::vector<double>& state,
+                             const double& time, const double& dt_history);
+
+ /// \short Take nstep timesteps of size dt (for Parareal); if 
+ /// impulsive_start is true, the history values are reset to the 
+ /// present ones first
+ void parareal_propagate(const unsigned& nstep, const double& dt,
+                         const bool& impulsive_start);
+
+ /// \short Get the mesh (nodal positions and connectivity) for 
+ /// compressed snapshots; nodes are numbered as in the mesh. The
+ /// mesh is cached and only rebuilt after adaptation.
+ const Snapshot_Compression::SnapshotMesh& get_snapshot_mesh();
+
+ /// \short Get the current nodal values of u, v, p and the smoothed
+ /// vorticity (assumed to have been recovered already). The pressure
+ /// is interpolated to all nodes.
+ void get_snapshot(Snapshot_Compression::Snapshot& snapshot);
+
 private:
 
+ /// \short Write compressed snapshot (and, at the first call, the mesh
+ /// for all snapshots) to the directory specified by doc_info
+ void doc_compressed_solution(DocInfo& doc_info);
+
+ /// \short Append snapshot to the archive soln_archive.bin in the 
+ /// directory specified by doc_info (as step doc_info.number()); 
+ /// fields are compressed if --compressed_output is specified.
+ void doc_solution_in_archive(DocInfo& doc_info);
+
+ /// \short Absolute error bounds for the fields in the snapshot
+ /// (all zero, i.e. lossless, unless --compressed_output is specified)
+ void get_absolute_error_bounds(
+  const Snapshot_Compression::Snapshot& snapshot,
+  std::vector<double>& abs_error_bound);
+
+ /// \short Locate the points of the uniform grid in the mesh and
+ /// tabulate the shape functions there; also writes the description of
+ /// the grid and the binary layout to uniform_grid_info.dat
+ void setup_uniform_grid(DocInfo& doc_info);
+
+ /// \short Resample the (smoothed) vorticity (and, with 
+ /// --uniform_grid_all_fields, the velocities and the recovered 
+ /// derivatives) onto the uniform grid and write them as a raw binary
+ /// array of doubles to uniform_grid[doc_info.number()].bin
+ void doc_uniform_grid_solution(DocInfo& doc_info);
+
  /// Complete problem setup
  void complete_problem_setup();
 
+ /// Max. absolute value of the entries in the (serial) vector
+ static double max_abs_value(const DoubleVector& vector)
+  {
+   double max_abs=0.0;
+   unsigned n=vector.nrow();
+   const double* value_pt=vector.values_pt();
+   for (unsigned i=0;i<n;i++)
+    {
+     max_abs=std::max(max_abs,std::fabs(value_pt[i]));
+    }
+   return max_abs;
+  }
+
+ /// \short Renumber nodes and elements (and doc the bandwidth and
+ /// profile of the Jacobian before and after if --doc_renumbering is
+ /// specified)
+ void renumber_mesh();
+
+ /// \short Set the GMRES tolerance for the next Newton step from the
+ /// reduction of the residuals (Eisenstat-Walker forcing term)
+ void set_gmres_forcing_term();
+
+ /// \short Number of applications of the (preconditioned) Jacobian in
+ /// the last linear solve that were not iterations: With GCRO-DR, those
+ /// that adapt the recycled space to the new Jacobian; zero otherwise.
+ unsigned nlinear_solver_overhead_application() const
+  {
+   GCRODR* gcrodr_pt=dynamic_cast<GCRODR*>(Solver_pt);
+   if (gcrodr_pt==0) return 0;
+   return gcrodr_pt->nrecycle_application();
+  }
+
+ /// \short Number of applications of the (preconditioned) Jacobian in
+ /// the last linear solve (the iterations plus, with GCRO-DR, the
+ /// applications for the recycled space)
+ unsigned nlinear_solver_operator_application() const
+  {
+   return Solver_pt->iterations()+nlinear_solver_overhead_application();
+  }
+
+ /// \short Estimate of the number of applications of the Jacobian that 
+ /// would have been needed with the fixed GMRES tolerance (assuming the
+ /// same convergence rate as in the last solve; the applications for
+ /// GCRO-DR's recycled space don't depend on the tolerance)
+ double ngmres_iter_with_fixed_tolerance() const
+  {
+   double niter=double(Solver_pt->iterations());
+   double noverhead=double(nlinear_solver_overhead_application());
+   if ((!Eisenstat_walker)||(Gmres_forcing_term<=Fixed_gmres_tolerance))
+    {
+     return niter+noverhead;
+    }
+   return niter*std::log(Fixed_gmres_tolerance)/std::log(Gmres_forcing_term)
+    +noverhead;
+  }
+
  /// oomph-lib iterative linear solver
  IterativeLinearSolver* Solver_pt;
  
@@ -302,9 +1146,103 @@ private:
  /// Inexact solver for F block
  Preconditioner* F_matrix_preconditioner_pt;
 
+ /// Number of timesteps since the preconditioner was last set up
+ unsigned Nstep_since_preconditioner_setup;
+
+ /// Number of GMRES iterations in the first solve after the last setup
+ unsigned Niter_after_preconditioner_setup;
+
+ /// Number of dofs when the preconditioner was last set up
+ unsigned long Ndof_at_preconditioner_setup;
+
+ /// \short Is the preconditioner to be set up for the current Newton 
+ /// step? (empty string if not; otherwise the reason)
+ std::string Preconditioner_setup_reason;
+
+ /// Has the preconditioner been set up for the current Newton step?
+ bool Preconditioner_has_just_been_set_up;
+
+ /// Number of setups of the preconditioner
+ unsigned Npreconditioner_setup;
+
+ /// Number of Newton iterations in current timestep
+ unsigned Nnewton_iter_in_timestep;
+
+ /// Total number of Newton iterations in all timesteps
+ unsigned Nnewton_iter_total;
+
+ /// Total number of timesteps
+ unsigned Ntimestep_total;
+
+ /// \short Adapt the GMRES tolerance to the reduction of the residuals
+ /// (--eisenstat_walker)?
+ bool Eisenstat_walker;
+
+ /// \short Fixed GMRES tolerance (also the lower bound for the adaptive
+ /// one)
+ double Fixed_gmres_tolerance;
+
+ /// Current GMRES tolerance (forcing term)
+ double Gmres_forcing_term;
+
+ /// Max. absolute value of the residuals in their last evaluation
+ double Max_residual;
+
+ /// 2-norm of the residuals in their last evaluation
+ double Residual_norm;
+
+ /// 2-norm of the residuals before the previous Newton step
+ double Previous_residual_norm;
+
+ /// Number of GMRES iterations in current timestep
+ unsigned Ngmres_iter_in_timestep;
+
+ /// \short Estimated number of GMRES iterations in current timestep with
+ /// the fixed tolerance
+ double Ngmres_iter_with_fixed_tolerance_in_timestep;
+
  /// Vorticity recoverer
  VorticitySmoother<ELEMENT>*  Vorticity_recoverer_pt;
 
+ /// Has no slip been imposed on the bottom boundary?
+ bool No_slip_on_bottom_boundary;
+
+ /// Has the mesh for the compressed snapshots been written?
+ bool Snapshot_mesh_has_been_written;
+
+ /// Cached mesh for the compressed snapshots
+ Snapshot_Compression::SnapshotMesh Snapshot_mesh;
+
+ /// Is the cached snapshot mesh up to date? (Reset after adaptation)
+ bool Snapshot_mesh_is_up_to_date;
+
+ /// Writer for snapshot archive (null if it hasn't been opened yet)
+ Snapshot_Compression::SnapshotArchiveWriter* Archive_writer_pt;
+
+ /// \short Multithreaded assembler (null if the Problem's serial 
+ /// assembly is used)
+ ThreadedAssembler* Threaded_assembler_pt;
+
+ /// \short Pressure-correction solver (null if the monolithic system is
+ /// solved)
+ PressureCorrectionSolver* Pressure_correction_solver_pt;
+
+ /// Per-timestep log of solver statistics and timings
+ SolverTelemetry Telemetry;
+
+ /// \short Element that contains each point of the uniform grid
+ /// (empty if the points haven't been located yet; null for 
+ /// points that couldn't be located)
+ Vector<ELEMENT*> Uniform_grid_element_pt;
+
+ /// \short Shape functions of the elements in Uniform_grid_element_pt
+ /// at the grid points (nnode values per point)
+ Vector<double> Uniform_grid_psi;
+
+ /// \short Indices of the nodal values that are resampled onto the
+ /// uniform grid
+ Vector<unsigned> Uniform_grid_value_index;
+
 }; // end of problem_class
 
 
@@ -312,7 +1250,11 @@ private:
 /// Problem constructor
 //====================================================================
 template<class ELEMENT>
-AnneProblem<ELEMENT>::AnneProblem()
+AnneProblem<ELEMENT>::AnneProblem() : No_slip_on_bottom_boundary(false),
+                                       Snapshot_mesh_has_been_written(false),
+                                       Snapshot_mesh_is_up_to_date(false),
+                                       Archive_writer_pt(0),
+                                       Threaded_assembler_pt(0)
 {
 
  // Make an instance of the vorticity recoverer
@@ -320,8 +1262,10 @@ AnneProblem<ELEMENT>::AnneProblem()
  Vorticity_recoverer_pt=new VorticitySmoother<ELEMENT>(nrecovery_order);
 
 
- //Allocate the timestepper
- add_time_stepper_pt(new BDF<2>); 
+ //Allocate the timestepper (with temporal error estimation if required)
+ bool adaptive_timestepping=
+  CommandLineArgs::command_line_flag_has_been_set("--adaptive_timestepping");
+ add_time_stepper_pt(new BDF<2>(adaptive_timestepping)); 
 
  // Number of elements in x direction.
  // purely nominal initial value
@@ -497,6 +1441,12 @@ AnneProblem<ELEMENT>::AnneProblem()
  //Complete the problem setup to make the elements fully functional
  complete_problem_setup();
 
+ // Renumber nodes and elements (and hence equations)
+ if (CommandLineArgs::command_line_flag_has_been_set("--renumber"))
+  {
+   renumber_mesh();
+  }
+
  //Assign equation numbers
  assign_eqn_numbers();
 
@@ -522,25 +1472,181 @@ AnneProblem<ELEMENT>::AnneProblem()
   }
 
 
- // Linear solver
- //--------------
- if (CommandLineArgs::command_line_flag_has_been_set("--use_oomph_gmres"))
+ // Multithreaded assembly and/or re-use of the sparsity pattern?
+ //-------------------------------------------------------------
+ // (The assembler is also used for the element-by-element products 
+ // with the Jacobian)
+ bool reuse_sparsity_pattern=
+  CommandLineArgs::command_line_flag_has_been_set("--reuse_sparsity_pattern");
+ bool matrix_free_jacobian=
+  CommandLineArgs::command_line_flag_has_been_set("--matrix_free_jacobian");
+ if (CommandLineArgs::command_line_flag_has_been_set("--nthread")||
+     reuse_sparsity_pattern||matrix_free_jacobian)
   {
-   // Use GMRES
-   Solver_pt=new GMRES<CRDoubleMatrix>;   
-   linear_solver_pt()=Solver_pt;
-   
-   // Set preconditioner
-   Prec_pt=new NavierStokesSchurComplementPreconditioner(this);
-   Prec_pt->set_navier_stokes_mesh(this->mesh_pt());  
-   Solver_pt->preconditioner_pt()=Prec_pt;
-
+   Threaded_assembler_pt=new ThreadedAssembler(this);
+   Threaded_assembler_pt->nthread()=Global_Parameters::Nthread;
+#ifndef _OPENMP
+   if (Global_Parameters::Nthread>1)
+    {
+     oomph_info << "Warning: Code was compiled without OpenMP; "
+                << "assembly runs in a single thread." << std::endl;
+    }
+#endif
+   if (reuse_sparsity_pattern)
+    {
+     Threaded_assembler_pt->enable_sparsity_pattern_reuse();
+    }
+  }
+
+
+ // Linearised timestepping?
+ //-------------------------
+ // Exactly one Newton step per timestep, from the extrapolated solution
+ // (see actions_before_implicit_timestep()), whatever the residuals
+ if (CommandLineArgs::command_line_flag_has_been_set(
+      "--linearised_timestepping"))
+  {
+   Always_take_one_newton_step=true;
+   newton_solver_tolerance()=std::numeric_limits<double>::max();
+  }
+
+
+ // Linear solver
+ //--------------
+ Solver_pt=0;
+ Nstep_since_preconditioner_setup=0;
+ Niter_after_preconditioner_setup=0;
+ Ndof_at_preconditioner_setup=0;
+ Preconditioner_has_just_been_set_up=false;
+ Npreconditioner_setup=0;
+ Nnewton_iter_in_timestep=0;
+ Nnewton_iter_total=0;
+ Ntimestep_total=0;
+ Eisenstat_walker=false;
+ Fixed_gmres_tolerance=0.0;
+ Gmres_forcing_term=0.0;
+ Max_residual=0.0;
+ Residual_norm=0.0;
+ Previous_residual_norm=0.0;
+ Ngmres_iter_in_timestep=0;
+ Ngmres_iter_with_fixed_tolerance_in_timestep=0.0;
+ Pressure_correction_solver_pt=0;
+ if (CommandLineArgs::command_line_flag_has_been_set(
+      "--use_pressure_correction"))
+  {
+   // Momentum predictor, pressure Poisson solve, velocity correction
+   // (pressure is value DIM at the vertex nodes)
+   Pressure_correction_solver_pt=new PressureCorrectionSolver(
+    mesh_pt(),2,time_pt());
+   linear_solver_pt()=Pressure_correction_solver_pt;
+   if (CommandLineArgs::command_line_flag_has_been_set(
+        "--static_condensation"))
+    {
+     oomph_info << "Warning: --static_condensation is ignored with the "
+                << "pressure-correction solver." << std::endl;
+    }
+  }
+ else if (CommandLineArgs::command_line_flag_has_been_set("--use_oomph_gmres"))
+  {
+   // Use GCRO-DR, recycling a deflation space between the solves?
+   if (CommandLineArgs::command_line_flag_has_been_set("--gcrodr"))
+    {
+     GCRODR* gcrodr_pt=new GCRODR;
+     gcrodr_pt->krylov_dimension()=Global_Parameters::Gcrodr_krylov_dimension;
+     gcrodr_pt->nrecycle()=Global_Parameters::Gcrodr_nrecycle;
+     Solver_pt=gcrodr_pt;
+     if (matrix_free_jacobian)
+      {
+       oomph_info << "Warning: --matrix_free_jacobian is ignored with "
+                  << "--gcrodr." << std::endl;
+      }
+    }
+
+   // Use GMRES with element-by-element products with the Jacobian
+   // (which is then only assembled for the setup of the preconditioner)
+   else if (matrix_free_jacobian)
+    {
+     Solver_pt=new MatrixFreeGMRES(this,Threaded_assembler_pt);
+     if (!CommandLineArgs::command_line_flag_has_been_set(
+          "--reuse_preconditioner"))
+      {
+       oomph_info << "Warning: Without --reuse_preconditioner, the "
+                  << "Jacobian is still assembled in every Newton step\n"
+                  << "(for the setup of the preconditioner) with "
+                  << "--matrix_free_jacobian." << std::endl;
+      }
+    }
+   else
+    {
+     Solver_pt=new GMRES<CRDoubleMatrix>;   
+    }
+   linear_solver_pt()=Solver_pt;
+
+   // Adapt the tolerance to the Newton iteration? (Not for linearised
+   // timestepping where there's only a single Newton step)
+   Fixed_gmres_tolerance=Solver_pt->tolerance();
+   if (CommandLineArgs::command_line_flag_has_been_set("--eisenstat_walker"))
+    {
+     if (CommandLineArgs::command_line_flag_has_been_set(
+          "--linearised_timestepping"))
+      {
+       oomph_info << "Warning: --eisenstat_walker is ignored with "
+                  << "--linearised_timestepping." << std::endl;
+      }
+     else
+      {
+       Eisenstat_walker=true;
+      }
+    }
+   
+   // Set preconditioner
+   Prec_pt=new NavierStokesSchurComplementPreconditioner(this);
+   Prec_pt->set_navier_stokes_mesh(this->mesh_pt());  
+   Solver_pt->preconditioner_pt()=Prec_pt;
+
+
+   // Use AMG for the Schur complement block? (Always if we don't have 
+   // MUMPS, otherwise we'd use the default direct solver)
+   bool use_amg_for_p_block=
+    CommandLineArgs::command_line_flag_has_been_set("--use_amg_for_p_block");
+#ifndef OOMPH_HAS_MUMPS
+   use_amg_for_p_block=true;
+#endif
+   // Store the multigrid hierarchies of the subsidiary preconditioners
+   // in single precision? (GMRES itself remains in double precision)
+   bool single_precision=CommandLineArgs::command_line_flag_has_been_set(
+    "--single_precision_preconditioners");
+   if (single_precision&&
+       ((!use_amg_for_p_block)||
+        (!CommandLineArgs::command_line_flag_has_been_set(
+          "--use_gmg_for_f_block"))))
+    {
+     oomph_info << "Warning: --single_precision_preconditioners only "
+                << "affects the AMG (P block) and GMG (F block)\n"
+                << "preconditioners; MUMPS factorisations remain in "
+                << "double precision." << std::endl;
+    }
+   if (use_amg_for_p_block)
+    {
+     if (single_precision)
+      {
+       P_matrix_preconditioner_pt=make_amg_p_preconditioner<float>();
+      }
+     else
+      {
+       P_matrix_preconditioner_pt=make_amg_p_preconditioner<double>();
+      }
+     Prec_pt->set_p_preconditioner(P_matrix_preconditioner_pt);
+    }
 
 #ifdef OOMPH_HAS_MUMPS
 
    // Schur complement preconditioner
-   P_matrix_preconditioner_pt = new NewMumpsPreconditioner;
-   Prec_pt->set_p_preconditioner(P_matrix_preconditioner_pt);
+   else
+    {
+     P_matrix_preconditioner_pt = new NewMumpsPreconditioner;
+     Prec_pt->set_p_preconditioner(P_matrix_preconditioner_pt);
+    }
 
 #endif
 
@@ -579,12 +1685,51 @@ AnneProblem<ELEMENT>::AnneProblem()
      F_matrix_preconditioner_pt = 
       new BlockDiagonalPreconditioner<CRDoubleMatrix>;
 
+     // Use geometric multigrid for block solves?
+     if (CommandLineArgs::command_line_flag_has_been_set(
+          "--use_gmg_for_f_block"))
+      {
+       Structured_GMG_Subsidiary_Preconditioner_Helper::Mesh_pt=mesh_pt();
+       Structured_GMG_Subsidiary_Preconditioner_Helper::
+        Next_velocity_component=0;
+       Structured_GMG_Subsidiary_Preconditioner_Helper::Single_precision=
+        single_precision;
+       dynamic_cast<BlockDiagonalPreconditioner<CRDoubleMatrix>* >
+        (F_matrix_preconditioner_pt)->set_subsidiary_preconditioner_function
+        (Structured_GMG_Subsidiary_Preconditioner_Helper::
+         set_structured_gmg_preconditioner);
+       if (CommandLineArgs::command_line_flag_has_been_set(
+            "--static_condensation"))
+        {
+         oomph_info << "Warning: --static_condensation is ignored with GMG "
+                    << "for the F block." << std::endl;
+        }
+      }
+
+     // Eliminate the unknowns at the element-interior nodes before
+     // the direct solves for the velocity components
+     else if (CommandLineArgs::command_line_flag_has_been_set(
+               "--static_condensation"))
+      {
+       Static_Condensation_Subsidiary_Preconditioner_Helper::Mesh_pt=
+        mesh_pt();
+       Static_Condensation_Subsidiary_Preconditioner_Helper::
+        Next_velocity_component=0;
+       dynamic_cast<BlockDiagonalPreconditioner<CRDoubleMatrix>* >
+        (F_matrix_preconditioner_pt)->set_subsidiary_preconditioner_function
+        (Static_Condensation_Subsidiary_Preconditioner_Helper::
+         set_static_condensation_preconditioner);
+      }
+
 #ifdef OOMPH_HAS_MUMPS
 
      // Use mumps for block solves
-     dynamic_cast<BlockDiagonalPreconditioner<CRDoubleMatrix>* >
-      (F_matrix_preconditioner_pt)->set_subsidiary_preconditioner_function
-      (Mumps_Subsidiary_Preconditioner_Helper::set_mumps_preconditioner);
+     else
+      {
+       dynamic_cast<BlockDiagonalPreconditioner<CRDoubleMatrix>* >
+        (F_matrix_preconditioner_pt)->set_subsidiary_preconditioner_function
+        (Mumps_Subsidiary_Preconditioner_Helper::set_mumps_preconditioner);
+      }
 
 #endif
 
@@ -602,7 +1747,27 @@ AnneProblem<ELEMENT>::AnneProblem()
     }
 
   }
- 
+
+ // Direct solve with static condensation of the unknowns at the
+ // element-interior nodes
+ else if (CommandLineArgs::command_line_flag_has_been_set(
+           "--static_condensation"))
+  {
+   linear_solver_pt()=new StaticCondensationSolver(mesh_pt());
+  }
+ if ((Solver_pt==0)&&
+     CommandLineArgs::command_line_flag_has_been_set("--eisenstat_walker"))
+  {
+   oomph_info << "Warning: --eisenstat_walker only has an effect with "
+              << "--use_oomph_gmres." << std::endl;
+  }
+ if ((Solver_pt==0)&&
+     CommandLineArgs::command_line_flag_has_been_set("--gcrodr"))
+  {
+   oomph_info << "Warning: --gcrodr only has an effect with "
+              << "--use_oomph_gmres." << std::endl;
+  }
+
  
 } // end of constructor
 
@@ -617,7 +1782,10 @@ void AnneProblem<ELEMENT>::doc_solution(DocInfo& doc_info)
 { 
 
  // Reconstruct smooth vorticity
+ double t_start=TimingHelpers::timer();
  Vorticity_recoverer_pt->recover_vorticity(mesh_pt());
+ double t_recovery=TimingHelpers::timer()-t_start;
+ Telemetry.add_recovery_time(t_recovery);
  
  ofstream some_file;
  char filename[100];
@@ -625,12 +1793,30 @@ void AnneProblem<ELEMENT>::doc_solution(DocInfo& doc_info)
  // Number of plot points
  unsigned npts=5; 
 
- // Output solution 
- sprintf(filename,"%s/soln%i.dat",doc_info.directory().c_str(),
-         doc_info.number());
- some_file.open(filename);
- mesh_pt()->output(some_file,npts);
- some_file.close();
+ // Output solution (into archive and/or compressed, if requested)
+ if (CommandLineArgs::command_line_flag_has_been_set("--snapshot_archive"))
+  {
+   doc_solution_in_archive(doc_info);
+  }
+ else if 
+  (CommandLineArgs::command_line_flag_has_been_set("--compressed_output"))
+  {
+   doc_compressed_solution(doc_info);
+  }
+ else
+  {
+   sprintf(filename,"%s/soln%i.dat",doc_info.directory().c_str(),
+           doc_info.number());
+   some_file.open(filename);
+   mesh_pt()->output(some_file,npts);
+   some_file.close();
+  }
+
+ // Resample onto uniform grid
+ if (Global_Parameters::Uniform_grid_nx>0)
+  {
+   doc_uniform_grid_solution(doc_info);
+  }
 
  // Output analytical vorticity and derivs -- uses fake (zero) data for
  // veloc and pressure
@@ -644,79 +1830,1458 @@ void AnneProblem<ELEMENT>::doc_solution(DocInfo& doc_info)
    unsigned nel=mesh_pt()->nelement();
    for (unsigned e=0;e<nel;e++)
     {
-     ELEMENT* el_pt=dynamic_cast<ELEMENT*>(mesh_pt()->element_pt(e));
-     el_pt->output_analytical_veloc_and_vorticity(some_file,npts);
+     ELEMENT* el_pt=dynamic_cast<ELEMENT*>(mesh_pt()->element_pt(e));
+     el_pt->output_analytical_veloc_and_vorticity(some_file,npts);
+    }
+   some_file.close();
+  }
+
+ Telemetry.add_output_time(TimingHelpers::timer()-t_start-t_recovery);
+
+} // end_of_doc_solution   
+
+
+
+//==start_of_get_snapshot_mesh===========================================
+/// Get the mesh for compressed snapshots (rebuilt only if the mesh
+/// has been adapted since the last call)
+//========================================================================
+template<class ELEMENT>
+const Snapshot_Compression::SnapshotMesh& 
+AnneProblem<ELEMENT>::get_snapshot_mesh()
+{
+ if (Snapshot_mesh_is_up_to_date) return Snapshot_mesh;
+ Snapshot_Compression::SnapshotMesh& snapshot_mesh=Snapshot_mesh;
+
+ // Nodal positions and node numbers
+ unsigned nnod=mesh_pt()->nnode();
+ snapshot_mesh.X.resize(nnod);
+ snapshot_mesh.Y.resize(nnod);
+ std::map<Node*,unsigned> node_number;
+ for (unsigned j=0;j<nnod;j++)
+  {
+   Node* nod_pt=mesh_pt()->node_pt(j);
+   snapshot_mesh.X[j]=nod_pt->x(0);
+   snapshot_mesh.Y[j]=nod_pt->x(1);
+   node_number[nod_pt]=j;
+  }
+
+ // Connectivity
+ unsigned nel=mesh_pt()->nelement();
+ unsigned nnod_el=mesh_pt()->finite_element_pt(0)->nnode();
+ snapshot_mesh.Nnode_per_element=nnod_el;
+ snapshot_mesh.Connectivity.resize(nel*nnod_el);
+ for (unsigned e=0;e<nel;e++)
+  {
+   FiniteElement* el_pt=mesh_pt()->finite_element_pt(e);
+   for (unsigned l=0;l<nnod_el;l++)
+    {
+     snapshot_mesh.Connectivity[e*nnod_el+l]=node_number[el_pt->node_pt(l)];
+    }
+  }
+
+ // Are the nodes numbered lexicographically, row by row, starting
+ // with the nodes on the bottom boundary? Then the compression can use
+ // the Lorenzo predictor.
+ unsigned row_length=mesh_pt()->nboundary_node(0);
+ bool lexicographic=(row_length>1)&&(row_length<nnod);
+ double y_bottom=mesh_pt()->node_pt(0)->x(1);
+ for (unsigned j=0;(j<row_length)&&lexicographic;j++)
+  {
+   lexicographic=(mesh_pt()->node_pt(j)->x(1)==y_bottom);
+  }
+ if (lexicographic)
+  {
+   lexicographic=(mesh_pt()->node_pt(row_length)->x(1)>y_bottom);
+  }
+ snapshot_mesh.Row_length=(lexicographic ? row_length : 0);
+
+ Snapshot_mesh_is_up_to_date=true;
+ return Snapshot_mesh;
+}
+
+
+
+//==start_of_get_snapshot=================================================
+/// Get current nodal values of u, v, p and smoothed vorticity
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::get_snapshot(
+ Snapshot_Compression::Snapshot& snapshot)
+{
+ snapshot.Time=time_pt()->time();
+ snapshot.Field_name.resize(4);
+ snapshot.Field_name[0]="u";
+ snapshot.Field_name[1]="v";
+ snapshot.Field_name[2]="p";
+ snapshot.Field_name[3]="omega";
+ unsigned nnod=mesh_pt()->nnode();
+ snapshot.Field_value.resize(4);
+ for (unsigned i=0;i<4;i++)
+  {
+   snapshot.Field_value[i].resize(nnod);
+  }
+
+ // Velocities and smoothed vorticity are stored at all nodes
+ ELEMENT* first_el_pt=dynamic_cast<ELEMENT*>(mesh_pt()->element_pt(0));
+ unsigned vort_index=first_el_pt->smoothed_vorticity_index();
+ std::map<Node*,unsigned> node_number;
+ for (unsigned j=0;j<nnod;j++)
+  {
+   Node* nod_pt=mesh_pt()->node_pt(j);
+   snapshot.Field_value[0][j]=nod_pt->value(0);
+   snapshot.Field_value[1][j]=nod_pt->value(1);
+   snapshot.Field_value[3][j]=nod_pt->value(vort_index);
+   node_number[nod_pt]=j;
+  }
+
+ // Pressure is only stored at the vertices: interpolate
+ Vector<double> s(2);
+ unsigned nel=mesh_pt()->nelement();
+ for (unsigned e=0;e<nel;e++)
+  {
+   ELEMENT* el_pt=dynamic_cast<ELEMENT*>(mesh_pt()->element_pt(e));
+   unsigned nnod_el=el_pt->nnode();
+   for (unsigned l=0;l<nnod_el;l++)
+    {
+     el_pt->local_coordinate_of_node(l,s);
+     snapshot.Field_value[2][node_number[el_pt->node_pt(l)]]=
+      el_pt->interpolated_p_nst(s);
+    }
+  }
+}
+
+
+
+//==start_of_doc_compressed_solution======================================
+/// Write compressed snapshot (and mesh, at the first call)
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::doc_compressed_solution(DocInfo& doc_info)
+{
+ char filename[100];
+
+ // Mesh is shared by all snapshots
+ const Snapshot_Compression::SnapshotMesh& snapshot_mesh=get_snapshot_mesh();
+ if (!Snapshot_mesh_has_been_written)
+  {
+   std::vector<unsigned char> mesh_buffer;
+   snapshot_mesh.write(mesh_buffer);
+   sprintf(filename,"%s/snapshot_mesh.bin",doc_info.directory().c_str());
+   Snapshot_Compression::write_buffer(filename,mesh_buffer);
+   Snapshot_mesh_has_been_written=true;
+  }
+ 
+ // Compress and write
+ Snapshot_Compression::Snapshot snapshot;
+ get_snapshot(snapshot);
+ std::vector<double> error_bound;
+ get_absolute_error_bounds(snapshot,error_bound);
+ bool relative=false;
+ std::vector<unsigned char> buffer;
+ Snapshot_Compression::compress_snapshot(snapshot,error_bound,relative,
+                                         snapshot_mesh.Row_length,buffer);
+ sprintf(filename,"%s/soln%i.snp",doc_info.directory().c_str(),
+         doc_info.number());
+ Snapshot_Compression::write_buffer(filename,buffer);
+
+ oomph_info << "Compressed snapshot " << filename << " to "
+            << buffer.size() << " bytes (compression ratio: " 
+            << double(4*8*mesh_pt()->nnode())/double(buffer.size()) 
+            << ")" << std::endl;
+}
+
+
+
+//==start_of_get_absolute_error_bounds====================================
+/// Absolute error bounds for the fields in the snapshot
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::get_absolute_error_bounds(
+ const Snapshot_Compression::Snapshot& snapshot,
+ std::vector<double>& abs_error_bound)
+{
+ unsigned nfield=snapshot.Field_value.size();
+ abs_error_bound.assign(nfield,0.0);
+ if (!CommandLineArgs::command_line_flag_has_been_set("--compressed_output"))
+  {
+   return;
+  }
+
+ // User-specified bounds for u, v, p, omega
+ abs_error_bound[0]=Global_Parameters::Error_bound_u;
+ abs_error_bound[1]=Global_Parameters::Error_bound_v;
+ abs_error_bound[2]=Global_Parameters::Error_bound_p;
+ abs_error_bound[3]=Global_Parameters::Error_bound_omega;
+
+ // Relative to range of values?
+ bool relative=
+  CommandLineArgs::command_line_flag_has_been_set("--relative_error_bounds");
+ for (unsigned i=0;i<nfield;i++)
+  {
+   unsigned nvalue=snapshot.Field_value[i].size();
+   if (nvalue>0)
+    {
+     abs_error_bound[i]=Snapshot_Compression::absolute_error_bound(
+      &snapshot.Field_value[i][0],nvalue,abs_error_bound[i],relative);
+    }
+  }
+}
+
+
+
+//==start_of_doc_solution_in_archive======================================
+/// Append snapshot to archive
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::doc_solution_in_archive(DocInfo& doc_info)
+{
+ double t_start=TimingHelpers::timer();
+
+ char filename[100];
+ sprintf(filename,"%s/soln_archive.bin",doc_info.directory().c_str());
+
+ // Mesh (also needed for row length of predictor)
+ const Snapshot_Compression::SnapshotMesh& snapshot_mesh=get_snapshot_mesh();
+
+ // Get the snapshot
+ Snapshot_Compression::Snapshot snapshot;
+ get_snapshot(snapshot);
+
+ // Open the archive at the first call: Append to existing one
+ // if we're restarting, otherwise make a new one.
+ if (Archive_writer_pt==0)
+  {
+   if (CommandLineArgs::command_line_flag_has_been_set("--restart"))
+    {
+     Archive_writer_pt=new Snapshot_Compression::SnapshotArchiveWriter(
+      filename,doc_info.number());
+     if ((Archive_writer_pt->nnode()!=mesh_pt()->nnode())||
+         (Archive_writer_pt->nstep()!=doc_info.number()))
+      {
+       std::ostringstream error_stream;
+       error_stream 
+        << "Snapshot archive " << filename << " doesn't match: It has "
+        << Archive_writer_pt->nnode() << " nodes and " 
+        << Archive_writer_pt->nstep() << " steps; we need " 
+        << mesh_pt()->nnode() << " nodes and " << doc_info.number() 
+        << " steps" << std::endl;
+       throw OomphLibError(error_stream.str(),
+                           OOMPH_CURRENT_FUNCTION,
+                           OOMPH_EXCEPTION_LOCATION);
+      }
+    }
+   else
+    {
+     Archive_writer_pt=new Snapshot_Compression::SnapshotArchiveWriter(
+      filename,snapshot_mesh,snapshot.Field_name,
+      Global_Parameters::Archive_max_nstep);
+    }
+  }
+
+ // Append
+ std::vector<double> abs_error_bound;
+ get_absolute_error_bounds(snapshot,abs_error_bound);
+ Archive_writer_pt->append(snapshot,abs_error_bound,
+                           snapshot_mesh.Row_length);
+
+ oomph_info << "Appended step " << Archive_writer_pt->nstep()-1 
+            << " to snapshot archive " << filename << " in "
+            << TimingHelpers::timer()-t_start << " sec" << std::endl;
+}
+
+
+
+//==start_of_setup_uniform_grid==========================================
+/// Locate points of uniform grid and tabulate shape functions there
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::setup_uniform_grid(DocInfo& doc_info)
+{
+ double t_start=TimingHelpers::timer();
+
+ unsigned nx=Global_Parameters::Uniform_grid_nx;
+ unsigned ny=Global_Parameters::Uniform_grid_ny;
+ if ((nx<2)||(ny<2))
+  {
+   std::ostringstream error_stream;
+   error_stream << "Uniform grid needs at least two points in each "
+                << "direction; we have nx, ny = " << nx << " " << ny 
+                << std::endl;
+   throw OomphLibError(error_stream.str(),
+                       OOMPH_CURRENT_FUNCTION,
+                       OOMPH_EXCEPTION_LOCATION);
+  }
+
+ // Which values do we resample? The smoothed vorticity is always 
+ // included; the velocities and the recovered derivatives of the 
+ // vorticity and the velocities only if requested.
+ ELEMENT* first_el_pt=dynamic_cast<ELEMENT*>(mesh_pt()->element_pt(0));
+ unsigned vort_index=first_el_pt->smoothed_vorticity_index();
+ Vector<std::string> field_name;
+ Uniform_grid_value_index.clear();
+ if (CommandLineArgs::command_line_flag_has_been_set(
+      "--uniform_grid_all_fields"))
+  {
+   const char* all_field_name[16]=
+    {"u","v","omega","domega_dx","domega_dy",
+     "d2omega_dx2","d2omega_dxdy","d2omega_dy2",
+     "d3omega_dx3","d3omega_dx2dy","d3omega_dxdy2","d3omega_dy3",
+     "du_dx","du_dy","dv_dx","dv_dy"};
+   for (unsigned i=0;i<16;i++)
+    {
+     field_name.push_back(all_field_name[i]);
+     Uniform_grid_value_index.push_back(i<2 ? first_el_pt->u_index_nst(i) :
+                                        vort_index+i-2);
+    }
+  }
+ else
+  {
+   field_name.push_back("omega");
+   Uniform_grid_value_index.push_back(vort_index);
+  }
+
+ // Locate the grid points (once and for all since the mesh doesn't 
+ // change) and tabulate the shape functions there
+ double x_left=Global_Parameters::X_left;
+ double x_right=Global_Parameters::X_right;
+ double height=Global_Parameters::Height;
+ unsigned nnod_el=first_el_pt->nnode();
+ Uniform_grid_element_pt.resize(nx*ny);
+ Uniform_grid_psi.resize(nx*ny*nnod_el);
+ MeshAsGeomObject mesh_geom_obj(mesh_pt());
+ Vector<double> x(2);
+ Vector<double> s(2);
+ Shape psi(nnod_el);
+ unsigned nnot_found=0;
+ for (unsigned j=0;j<ny;j++)
+  {
+   x[1]=height*double(j)/double(ny-1);
+   for (unsigned i=0;i<nx;i++)
+    {
+     x[0]=x_left+(x_right-x_left)*double(i)/double(nx-1);
+     unsigned k=i+nx*j;
+     GeomObject* geom_obj_pt=0;
+     mesh_geom_obj.locate_zeta(x,geom_obj_pt,s);
+     ELEMENT* el_pt=dynamic_cast<ELEMENT*>(geom_obj_pt);
+     Uniform_grid_element_pt[k]=el_pt;
+     if (el_pt==0)
+      {
+       nnot_found++;
+       continue;
+      }
+     el_pt->shape(s,psi);
+     for (unsigned l=0;l<nnod_el;l++)
+      {
+       Uniform_grid_psi[k*nnod_el+l]=psi[l];
+      }
+    }
+  }
+ if (nnot_found>0)
+  {
+   std::ostringstream warning_stream;
+   warning_stream << nnot_found << " points of the uniform grid couldn't "
+                  << "be located in the mesh;\n"
+                  << "their values are set to NaN." << std::endl;
+   OomphLibWarning(warning_stream.str(),
+                   OOMPH_CURRENT_FUNCTION,
+                   OOMPH_EXCEPTION_LOCATION);
+  }
+
+ // Describe grid and binary layout
+ ofstream some_file;
+ char filename[100];
+ sprintf(filename,"%s/uniform_grid_info.dat",doc_info.directory().c_str());
+ some_file.open(filename);
+ some_file << "# Fields resampled onto uniform grid, written to\n"
+           << "# uniform_grid[i].bin as raw arrays of native-endian\n"
+           << "# float64[nfield][ny][nx]; grid point (i,j) is at\n"
+           << "# x = x_left + i*(x_right-x_left)/(nx-1),\n"
+           << "# y = y_bottom + j*(y_top-y_bottom)/(ny-1).\n"
+           << "# Times of the snapshots are in uniform_grid_times.dat\n"
+           << "nx " << nx << "\n"
+           << "ny " << ny << "\n"
+           << "x_left " << x_left << "\n"
+           << "x_right " << x_right << "\n"
+           << "y_bottom " << 0.0 << "\n"
+           << "y_top " << height << "\n"
+           << "nfield " << field_name.size() << "\n"
+           << "fields";
+ for (unsigned i=0;i<field_name.size();i++)
+  {
+   some_file << " " << field_name[i];
+  }
+ some_file << std::endl;
+ some_file.close();
+
+ oomph_info << "Located " << nx*ny-nnot_found << " points of uniform grid in "
+            << TimingHelpers::timer()-t_start << " sec" << std::endl;
+}
+
+
+
+//==start_of_doc_uniform_grid_solution====================================
+/// Resample solution onto uniform grid and write as raw binary array
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::doc_uniform_grid_solution(DocInfo& doc_info)
+{
+ // Locate grid points at the first call (or after adaptation)
+ if (Uniform_grid_element_pt.size()==0)
+  {
+   setup_uniform_grid(doc_info);
+  }
+
+ // Interpolate
+ unsigned npt=Uniform_grid_element_pt.size();
+ unsigned nfield=Uniform_grid_value_index.size();
+ unsigned nnod_el=mesh_pt()->finite_element_pt(0)->nnode();
+ Vector<double> resampled(nfield*npt,
+                          std::numeric_limits<double>::quiet_NaN());
+ for (unsigned k=0;k<npt;k++)
+  {
+   ELEMENT* el_pt=Uniform_grid_element_pt[k];
+   if (el_pt==0)
+    {
+     continue;
+    }
+   const double* psi_pt=&Uniform_grid_psi[k*nnod_el];
+   for (unsigned f=0;f<nfield;f++)
+    {
+     unsigned i_value=Uniform_grid_value_index[f];
+     double value=0.0;
+     for (unsigned l=0;l<nnod_el;l++)
+      {
+       value+=el_pt->nodal_value(l,i_value)*psi_pt[l];
+      }
+     resampled[f*npt+k]=value;
+    }
+  }
+
+ // Write raw array
+ char filename[100];
+ sprintf(filename,"%s/uniform_grid%i.bin",doc_info.directory().c_str(),
+         doc_info.number());
+ FILE* file_pt=fopen(filename,"wb");
+ if ((file_pt==0)||
+     (fwrite(&resampled[0],sizeof(double),nfield*npt,file_pt)!=nfield*npt)||
+     (fclose(file_pt)!=0))
+  {
+   std::ostringstream error_stream;
+   error_stream << "Failed to write " << filename << std::endl;
+   throw OomphLibError(error_stream.str(),
+                       OOMPH_CURRENT_FUNCTION,
+                       OOMPH_EXCEPTION_LOCATION);
+  }
+
+ // Record the time (start a new file for the initial condition)
+ ofstream some_file;
+ sprintf(filename,"%s/uniform_grid_times.dat",doc_info.directory().c_str());
+ if (doc_info.number()==0)
+  {
+   some_file.open(filename);
+  }
+ else
+  {
+   some_file.open(filename,std::ios_base::app);
+  }
+ some_file << doc_info.number() << " " << time_pt()->time() << std::endl;
+ some_file.close();
+}
+
+
+
+//==start_of_actions_before_newton_step===================================
+/// \short Decide if the preconditioner (and hence the factorisations of
+/// its blocks) is to be set up again or re-used. It's set up again if
+/// the number of dofs has changed, if it's been used for more than
+/// Global_Parameters::Preconditioner_reuse_nstep timesteps, or if the
+/// number of GMRES iterations has grown by more than 
+/// Global_Parameters::Preconditioner_reuse_iteration_factor. The
+/// Jacobian is still assembled for every Newton step since GMRES needs it
+/// for its matrix-vector products, unless --matrix_free_jacobian is
+/// specified (then it's only assembled for the setup of the
+/// preconditioner, and the products are computed element by element).
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::actions_before_newton_step()
+{
+ if (Eisenstat_walker)
+  {
+   set_gmres_forcing_term();
+  }
+
+ if ((Solver_pt==0)||
+     (!CommandLineArgs::command_line_flag_has_been_set(
+       "--reuse_preconditioner")))
+  {
+   return;
+  }
+
+ // Do we have to set it up again?
+ if (Ndof_at_preconditioner_setup!=ndof())
+  {
+   if (Npreconditioner_setup==0)
+    {
+     Preconditioner_setup_reason="first solve";
+    }
+   else
+    {
+     Preconditioner_setup_reason="number of dofs has changed";
+    }
+  }
+ else if (Nstep_since_preconditioner_setup>=
+          Global_Parameters::Preconditioner_reuse_nstep)
+  {
+   Preconditioner_setup_reason="max. number of timesteps reached";
+  }
+
+ // Set it up or re-use it
+ if (Preconditioner_setup_reason!="")
+  {
+   Npreconditioner_setup++;
+   oomph_info << "Setting up preconditioner (setup no. " 
+              << Npreconditioner_setup << "); reason: " 
+              << Preconditioner_setup_reason << std::endl;
+   Solver_pt->enable_setup_preconditioner_before_solve();
+   Nstep_since_preconditioner_setup=0;
+   Ndof_at_preconditioner_setup=ndof();
+   Preconditioner_setup_reason="";
+   Preconditioner_has_just_been_set_up=true;
+  }
+ else
+  {
+   Solver_pt->disable_setup_preconditioner_before_solve();
+  }
+}
+
+
+
+//==start_of_set_gmres_forcing_term=======================================
+/// \short Set the (relative) GMRES tolerance for the next Newton step
+/// from the reduction of the residuals in the previous one (choice 2 of
+/// Eisenstat & Walker, 1996):
+///
+///   eta_k = gamma (|F_k|/|F_{k-1}|)^alpha,
+///
+/// safeguarded against a too rapid decrease by 
+/// eta_k >= gamma eta_{k-1}^alpha (if the latter is > 0.1), and 
+/// bounded by the max. forcing term and the fixed tolerance. To avoid
+/// over-solving in the final step, the tolerance isn't reduced further 
+/// than required to get the residuals below (half) the Newton
+/// tolerance: GMRES reduces the 2-norm of the residuals by eta, and
+/// the max. residual (checked by the Newton solver) is bounded by the
+/// 2-norm, so eta >= 0.5 tol/|F_k|_2 is enough. The residuals are those at the current Newton iterate:
+/// After the first step, they're the ones from the Newton solver's 
+/// convergence check; before the first step (when the ones from the 
+/// previous timestep have been reset in 
+/// actions_before_implicit_timestep()), they're evaluated here.
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::set_gmres_forcing_term()
+{
+ if (Residual_norm==0.0)
+  {
+   // Not via get_residuals() which would log them in the telemetry
+   DoubleVector residuals;
+   if (Threaded_assembler_pt!=0)
+    {
+     Threaded_assembler_pt->get_residuals(residuals);
+    }
+   else
+    {
+     Problem::get_residuals(residuals);
+    }
+   Residual_norm=residuals.norm();
+  }
+
+ double eta=Global_Parameters::Eisenstat_walker_eta_initial;
+ if ((Nnewton_iter_in_timestep>0)&&(Previous_residual_norm>0.0))
+  {
+   double gamma=Global_Parameters::Eisenstat_walker_gamma;
+   double alpha=Global_Parameters::Eisenstat_walker_alpha;
+   eta=gamma*std::pow(Residual_norm/Previous_residual_norm,alpha);
+   double eta_safeguard=gamma*std::pow(Gmres_forcing_term,alpha);
+   if (eta_safeguard>0.1)
+    {
+     eta=std::max(eta,eta_safeguard);
+    }
+  }
+ if (Residual_norm>0.0)
+  {
+   eta=std::max(eta,0.5*newton_solver_tolerance()/Residual_norm);
+  }
+ eta=std::min(eta,Global_Parameters::Eisenstat_walker_eta_max);
+ eta=std::max(eta,Fixed_gmres_tolerance);
+
+ Gmres_forcing_term=eta;
+ Previous_residual_norm=Residual_norm;
+ Solver_pt->tolerance()=eta;
+ oomph_info << "GMRES tolerance for Newton step " 
+            << Nnewton_iter_in_timestep+1 << ": " << eta 
+            << " (residual norm: " << Residual_norm << ")" << std::endl;
+}
+
+
+
+//==start_of_actions_after_newton_step====================================
+/// \short Monitor the GMRES iterations: Request a new setup of the 
+/// preconditioner if they've degraded by more than the specified factor.
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::actions_after_newton_step()
+{
+ // Count Newton iterations
+ Nnewton_iter_in_timestep++;
+
+ // Log linear solver statistics (the preconditioner is set up in every
+ // solve unless it's re-used)
+ bool reuse_preconditioner=
+  CommandLineArgs::command_line_flag_has_been_set("--reuse_preconditioner");
+ Telemetry.add_newton_step();
+ Telemetry.add_linear_solve_time(
+  linear_solver_pt()->linear_solver_solution_time());
+ if (Solver_pt!=0)
+  {
+   // (Count all applications of the Jacobian, including those for
+   // GCRO-DR's recycled space)
+   unsigned noperator_application=nlinear_solver_operator_application();
+   Telemetry.add_gmres_iterations(noperator_application);
+   Ngmres_iter_in_timestep+=noperator_application;
+   Ngmres_iter_with_fixed_tolerance_in_timestep+=
+    ngmres_iter_with_fixed_tolerance();
+   if ((!reuse_preconditioner)||Preconditioner_has_just_been_set_up)
+    {
+     Telemetry.add_preconditioner_setup_time(
+      Solver_pt->preconditioner_setup_time());
+    }
+  }
+
+ if ((Solver_pt==0)||(!reuse_preconditioner))
+  {
+   return;
+  }
+
+ // (With the adaptive tolerance, compare the iterations that would have
+ // been needed with the fixed one)
+ unsigned niter=unsigned(ngmres_iter_with_fixed_tolerance()+0.5);
+ if (Preconditioner_has_just_been_set_up)
+  {
+   Niter_after_preconditioner_setup=std::max(niter,unsigned(1));
+   Preconditioner_has_just_been_set_up=false;
+  }
+ else if (double(niter)>Global_Parameters::
+          Preconditioner_reuse_iteration_factor*
+          double(Niter_after_preconditioner_setup))
+  {
+   std::ostringstream reason;
+   reason << "GMRES iterations have grown from " 
+          << Niter_after_preconditioner_setup << " to " << niter;
+   Preconditioner_setup_reason=reason.str();
+  }
+}
+
+
+
+//========================================================================
+/// \short Renumber nodes and elements (and doc the bandwidth and
+/// profile of the Jacobian before and after if --doc_renumbering is
+/// specified)
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::renumber_mesh()
+{
+ bool doc_renumbering=
+  CommandLineArgs::command_line_flag_has_been_set("--doc_renumbering");
+ Mesh_Renumbering::SparsityStatistics before;
+ if (doc_renumbering)
+  {
+   assign_eqn_numbers();
+   Mesh_Renumbering::get_sparsity_statistics(mesh_pt(),ndof(),before);
+  }
+
+ double t_start=TimingHelpers::timer();
+ Mesh_Renumbering::renumber(mesh_pt(),Global_Parameters::Renumbering_method);
+ oomph_info << "Time for " << Global_Parameters::Renumbering_method 
+            << " renumbering: " << TimingHelpers::timer()-t_start 
+            << " sec" << std::endl;
+
+ if (doc_renumbering)
+  {
+   assign_eqn_numbers();
+   Mesh_Renumbering::SparsityStatistics after;
+   Mesh_Renumbering::get_sparsity_statistics(mesh_pt(),ndof(),after);
+   oomph_info << "Renumbering: before / after\n"
+              << "Bandwidth of Jacobian:  " << before.Bandwidth << " / "
+              << after.Bandwidth << "\n"
+              << "Profile of Jacobian:    " << before.Profile << " / "
+              << after.Profile << "\n"
+              << "Mean node index spread: " << before.Mean_node_index_spread
+              << " / " << after.Mean_node_index_spread << std::endl;
+  }
+}
+
+
+
+//========================================================================
+/// Complete problem setup
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::complete_problem_setup()
+{
+
+ // Unpin all pressure dofs
+ RefineableNavierStokesEquations<2>::
+  unpin_all_pressure_dofs(mesh_pt()->element_pt());
+ 
+ //Loop over the elements
+ unsigned n_el = mesh_pt()->nelement();
+ unsigned naffine=0;
+ for(unsigned e=0;e<n_el;e++)
+  {
+   //Cast to a fluid element
+   ELEMENT *el_pt = dynamic_cast<ELEMENT*>(mesh_pt()->element_pt(e));
+
+   //Set the Reynolds number
+   el_pt->re_pt() = &Global_Parameters::Re;   
+   el_pt->re_st_pt() = &Global_Parameters::Re;
+
+   // Set exact solution for vorticity and derivs (for validation)
+   el_pt->exact_vorticity_fct_pt()=&Global_Parameters::synthetic_vorticity;
+
+   // Pin smoothed vorticity
+   el_pt->pin_smoothed_vorticity();
+
+   // Use the fast path for the mapping if the element is an affine 
+   // rectangle (the mesh squashing only remaps x and y separately)
+   if (!CommandLineArgs::command_line_flag_has_been_set(
+         "--disable_affine_rectangle_elements"))
+    {
+     el_pt->setup_affine_rectangle();
+     if (el_pt->is_affine_rectangle()) naffine++;
+    }
+  }
+ oomph_info << "Number of elements with affine (rectangle) mapping: " 
+            << naffine << " of " << n_el << std::endl;
+
+  // Pin redudant pressure dofs
+  RefineableNavierStokesEquations<2>::
+   pin_redundant_nodal_pressures(mesh_pt()->element_pt());
+  
+}
+
+
+
+
+//========================================================================
+/// Impose no slip and re-assign eqn numbers
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::impose_no_slip_on_bottom_boundary(
+ const bool& impulsive)
+{
+
+
+ // Pin horizontal velocity at bottom boundary and apply correction
+ unsigned ibound=0;
+ unsigned num_nod=mesh_pt()->nboundary_node(ibound);
+ unsigned ntstorage=time_stepper_pt()->ntstorage();
+ for (unsigned inod=0;inod<num_nod;inod++)
+  {
+   mesh_pt()->boundary_node_pt(ibound,inod)->pin(0);
+   mesh_pt()->boundary_node_pt(ibound,inod)->set_value(0,Global_Parameters::K);
+   if (impulsive)
+    {
+     for (unsigned t=1;t<ntstorage;t++)
+      {
+       mesh_pt()->boundary_node_pt(ibound,inod)->
+        set_value(t,0,Global_Parameters::K);
+      }
+    }
+  }
+
+ // Re-assign equation numbers (and factorise the pressure operator of
+ // the pressure-correction solver again)
+ if (Pressure_correction_solver_pt!=0)
+  {
+   Pressure_correction_solver_pt->reset_pressure_operator();
+  }
+ oomph_info << std::endl 
+            << "ndofs before applying no slip at bottom boundary: "
+            << ndof() << std::endl;
+ assign_eqn_numbers();
+ oomph_info << "ndofs after applying no slip at bottom boundary : "
+            << ndof() << std::endl << std::endl;
+ if (Threaded_assembler_pt!=0)
+  {
+   Threaded_assembler_pt->invalidate_sparsity_pattern();
+  }
+ 
+ // Record the switch (needed for checkpointing)
+ No_slip_on_bottom_boundary=true;
+}
+
+
+
+//==start_of_project_from================================================
+/// \short Take over the solution (and its history), time and timesteps
+/// from a problem on a different mesh (e.g. after a startup phase on a
+/// coarser mesh) by projection. The boundary conditions (pinned values)
+/// are retained.
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::project_from(AnneProblem<ELEMENT>* other_problem_pt)
+{
+ double t_start=TimingHelpers::timer();
+
+ // Back up the pinned values (and which ones are pinned)
+ unsigned nnod=mesh_pt()->nnode();
+ Vector<Vector<bool> > was_pinned(nnod);
+ Vector<Vector<double> > pinned_value(nnod);
+ for (unsigned j=0;j<nnod;j++)
+  {
+   Node* nod_pt=mesh_pt()->node_pt(j);
+   unsigned nvalue=nod_pt->nvalue();
+   was_pinned[j].resize(nvalue);
+   pinned_value[j].resize(nvalue);
+   for (unsigned i=0;i<nvalue;i++)
+    {
+     was_pinned[j][i]=nod_pt->is_pinned(i);
+     pinned_value[j][i]=nod_pt->value(i);
+    }
+  }
+
+ // Project all fields at all time levels (the meshes don't move)
+ ProjectionProblem<ELEMENT>* projection_problem_pt=
+  new ProjectionProblem<ELEMENT>;
+ projection_problem_pt->mesh_pt()=mesh_pt();
+ bool dont_project_positions=true;
+ projection_problem_pt->project(other_problem_pt->mesh_pt(),
+                                dont_project_positions);
+ delete projection_problem_pt;
+
+ // Reinstate the boundary conditions
+ unsigned ntstorage=time_stepper_pt()->ntstorage();
+ for (unsigned j=0;j<nnod;j++)
+  {
+   Node* nod_pt=mesh_pt()->node_pt(j);
+   unsigned nvalue=nod_pt->nvalue();
+   for (unsigned i=0;i<nvalue;i++)
+    {
+     if (was_pinned[j][i])
+      {
+       nod_pt->pin(i);
+       for (unsigned t=0;t<ntstorage;t++)
+        {
+         nod_pt->set_value(t,i,pinned_value[j][i]);
+        }
+      }
+     else
+      {
+       nod_pt->unpin(i);
+      }
+    }
+  }
+
+ // Time and timesteps
+ time_pt()->time()=other_problem_pt->time_pt()->time();
+ unsigned ndt=time_pt()->ndt();
+ for (unsigned t=0;t<ndt;t++)
+  {
+   time_pt()->dt(t)=other_problem_pt->time_pt()->dt(t);
+  }
+ time_stepper_pt()->set_weights();
+
+ // The projection has used its own equation numbers
+ assign_eqn_numbers();
+ if (Threaded_assembler_pt!=0)
+  {
+   Threaded_assembler_pt->invalidate_sparsity_pattern();
+  }
+
+ oomph_info << "Time for projection from other mesh: " 
+            << TimingHelpers::timer()-t_start << " sec" << std::endl;
+}
+
+
+
+//==start_of_interpolate_from============================================
+/// \short Interpolate the velocities and pressure at all time levels 
+/// from a problem on a different mesh (nodal values at the nodes of 
+/// this one), and take over its time and timesteps. Unlike 
+/// project_from(...), no linear systems are solved. Pinned values
+/// are retained.
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::interpolate_from(
+ AnneProblem<ELEMENT>* other_problem_pt)
+{
+ double t_start=TimingHelpers::timer();
+
+ ELEMENT* first_el_pt=dynamic_cast<ELEMENT*>(mesh_pt()->element_pt(0));
+ unsigned u_index[2];
+ u_index[0]=first_el_pt->u_index_nst(0);
+ u_index[1]=first_el_pt->u_index_nst(1);
+ unsigned p_index=first_el_pt->p_nodal_index_nst();
+
+ unsigned ntstorage=time_stepper_pt()->ntstorage();
+ MeshAsGeomObject mesh_geom_obj(other_problem_pt->mesh_pt());
+ Vector<double> x(2);
+ Vector<double> s(2);
+ Vector<double> values;
+ unsigned nnot_found=0;
+ unsigned nnod=mesh_pt()->nnode();
+ for (unsigned j=0;j<nnod;j++)
+  {
+   Node* nod_pt=mesh_pt()->node_pt(j);
+   x[0]=nod_pt->x(0);
+   x[1]=nod_pt->x(1);
+   GeomObject* geom_obj_pt=0;
+   mesh_geom_obj.locate_zeta(x,geom_obj_pt,s);
+   ELEMENT* el_pt=dynamic_cast<ELEMENT*>(geom_obj_pt);
+   if (el_pt==0)
+    {
+     nnot_found++;
+     continue;
+    }
+   for (unsigned t=0;t<ntstorage;t++)
+    {
+     // Values are u, v, p (the pressure without history)
+     el_pt->get_interpolated_values(t,s,values);
+     for (unsigned i=0;i<2;i++)
+      {
+       if (!nod_pt->is_pinned(u_index[i]))
+        {
+         nod_pt->set_value(t,u_index[i],values[i]);
+        }
+      }
+     if ((nod_pt->nvalue()>p_index)&&(!nod_pt->is_pinned(p_index)))
+      {
+       nod_pt->set_value(t,p_index,values[2]);
+      }
+    }
+  }
+ if (nnot_found>0)
+  {
+   std::ostringstream warning_stream;
+   warning_stream << nnot_found << " nodes couldn't be located in the "
+                  << "other mesh;\ntheir values are unchanged." 
+                  << std::endl;
+   OomphLibWarning(warning_stream.str(),
+                   OOMPH_CURRENT_FUNCTION,
+                   OOMPH_EXCEPTION_LOCATION);
+  }
+
+ // Time and timesteps
+ time_pt()->time()=other_problem_pt->time_pt()->time();
+ unsigned ndt=time_pt()->ndt();
+ for (unsigned t=0;t<ndt;t++)
+  {
+   time_pt()->dt(t)=other_problem_pt->time_pt()->dt(t);
+  }
+ time_stepper_pt()->set_weights();
+
+ oomph_info << "Time for interpolation from other mesh: " 
+            << TimingHelpers::timer()-t_start << " sec" << std::endl;
+}
+
+
+
+//==start_of_parareal_solve==============================================
+/// \short Solve for the next nstep timesteps with Parareal: The coarse
+/// propagator uses Global_Parameters::Parareal_coarse_dt_factor times
+/// larger timesteps (starting impulsively in each slice), the fine one
+/// is the normal timestepping on the (forked) worker processes. The
+/// solution is documented at the ends of the time slices only.
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::parareal_solve(DocInfo& doc_info,
+                                          const unsigned& nstep,
+                                          const double& dt)
+{
+ PararealDriver<AnneProblem<ELEMENT> > parareal(this);
+ parareal.nproc()=Global_Parameters::Parareal_nproc;
+ if ((parareal.nproc()>1)&&(Threaded_assembler_pt!=0)&&
+     (Threaded_assembler_pt->nthread()>1))
+  {
+   // The worker processes are forked, and OpenMP's threads don't
+   // survive that
+   oomph_info << "Warning: Parareal's fine propagations are done serially "
+              << "with multithreaded assembly." << std::endl;
+   parareal.nproc()=1;
+  }
+ parareal.max_iter()=Global_Parameters::Parareal_max_iter;
+ parareal.tolerance()=Global_Parameters::Parareal_tolerance;
+ parareal.compute_reference()=
+  CommandLineArgs::command_line_flag_has_been_set("--parareal_reference");
+ parareal.work_directory()=doc_info.directory();
+ parareal.convergence_file()=doc_info.directory()+"/parareal.dat";
+
+ oomph_info << "Parareal for " << nstep << " timesteps in " 
+            << Global_Parameters::Parareal_nslice << " slices on up to "
+            << Global_Parameters::Parareal_nproc << " processes"
+            << std::endl;
+ double t_start=TimingHelpers::timer();
+ unsigned niter=parareal.solve(
+  nstep,Global_Parameters::Parareal_nslice,dt,
+  Global_Parameters::Parareal_coarse_dt_factor*dt);
+ oomph_info << "Parareal finished after " << niter << " iterations in "
+            << TimingHelpers::timer()-t_start << " sec" << std::endl;
+
+ // Doc the solution at the ends of the slices
+ unsigned nslice=parareal.nslice();
+ for (unsigned n=0;n<nslice;n++)
+  {
+   set_state_with_history(parareal.slice_end_state(n),
+                      parareal.slice_end_time(n),dt);
+   doc_solution(doc_info);
+   doc_info.number()++;
+  }
+}
+
+
+
+//==start_of_get_state_with_history======================================
+/// \short State of the problem: all nodal values at all time levels
+/// (node by node). The history values are (Lagrange-)interpolated to 
+/// the times t-dt_history, t-2 dt_history, ... if the previous 
+/// timesteps were different; any additional storage of the timestepper
+/// is copied as it is.
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::get_state_with_history(
+ std::vector<double>& state, const double& dt_history)
+{
+ unsigned ntstorage=time_stepper_pt()->ntstorage();
+ unsigned nprev=time_stepper_pt()->nprev_values();
+
+ // Times of the history values (relative to the present time)
+ std::vector<double> t_history(nprev+1,0.0);
+ bool rescale=false;
+ for (unsigned k=1;k<=nprev;k++)
+  {
+   t_history[k]=t_history[k-1]-time_pt()->dt(k-1);
+   if (time_pt()->dt(k-1)!=dt_history) rescale=true;
+  }
+
+ // weight[k][l] is the weight of time level l in the value at
+ // time t-k*dt_history
+ std::vector<std::vector<double> > weight(nprev+1,
+                                          std::vector<double>(nprev+1,0.0));
+ for (unsigned k=0;k<=nprev;k++)
+  {
+   if (!rescale)
+    {
+     weight[k][k]=1.0;
+     continue;
+    }
+   double t_target=-double(k)*dt_history;
+   for (unsigned l=0;l<=nprev;l++)
+    {
+     weight[k][l]=1.0;
+     for (unsigned m=0;m<=nprev;m++)
+      {
+       if (m!=l)
+        {
+         weight[k][l]*=(t_target-t_history[m])/(t_history[l]-t_history[m]);
+        }
+      }
+    }
+  }
+
+ unsigned nnod=mesh_pt()->nnode();
+ state.clear();
+ for (unsigned j=0;j<nnod;j++)
+  {
+   Node* nod_pt=mesh_pt()->node_pt(j);
+   unsigned nvalue=nod_pt->nvalue();
+   for (unsigned i=0;i<nvalue;i++)
+    {
+     for (unsigned k=0;k<=nprev;k++)
+      {
+       double value=0.0;
+       for (unsigned l=0;l<=nprev;l++)
+        {
+         value+=weight[k][l]*nod_pt->value(l,i);
+        }
+       state.push_back(value);
+      }
+     for (unsigned t=nprev+1;t<ntstorage;t++)
+      {
+       state.push_back(nod_pt->value(t,i));
+      }
+    }
+  }
+}
+
+
+
+//==start_of_set_state_with_history======================================
+/// \short Set the state at the given time (all previous 
+/// timesteps are set to dt_history)
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::set_state_with_history(
+ const std::vector<double>& state, const double& time, 
+ const double& dt_history)
+{
+ unsigned ntstorage=time_stepper_pt()->ntstorage();
+ unsigned nnod=mesh_pt()->nnode();
+ unsigned count=0;
+ for (unsigned j=0;j<nnod;j++)
+  {
+   Node* nod_pt=mesh_pt()->node_pt(j);
+   unsigned nvalue=nod_pt->nvalue();
+   for (unsigned i=0;i<nvalue;i++)
+    {
+     for (unsigned t=0;t<ntstorage;t++)
+      {
+       nod_pt->set_value(t,i,state[count]);
+       count++;
+      }
+    }
+  }
+#ifdef PARANOID
+ if (count!=state.size())
+  {
+   std::ostringstream error_stream;
+   error_stream << "Parareal state has " << state.size() 
+                << " entries rather than " << count << std::endl;
+   throw OomphLibError(error_stream.str(),
+                       OOMPH_CURRENT_FUNCTION,
+                       OOMPH_EXCEPTION_LOCATION);
+  }
+#endif
+ time_pt()->time()=time;
+ initialise_dt(dt_history);
+}
+
+
+
+//==start_of_parareal_propagate==========================================
+/// Take nstep timesteps of size dt (for Parareal)
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::parareal_propagate(const unsigned& nstep,
+                                              const double& dt,
+                                              const bool& impulsive_start)
+{
+ if (impulsive_start)
+  {
+   assign_initial_values_impulsive(dt);
+  }
+ for (unsigned t=0;t<nstep;t++)
+  {
+   unsteady_newton_solve(dt);
+  }
+}
+
+
+
+//==start_of_global_temporal_error_norm==================================
+/// Global temporal error norm: RMS of estimated temporal errors in the
+/// velocities
+//========================================================================
+template<class ELEMENT>
+double AnneProblem<ELEMENT>::global_temporal_error_norm()
+{
+ double global_error=0.0;
+ unsigned nnod=mesh_pt()->nnode();
+ for (unsigned j=0;j<nnod;j++)
+  {
+   Node* nod_pt=mesh_pt()->node_pt(j);
+   for (unsigned i=0;i<2;i++)
+    {
+     double error=time_stepper_pt()->temporal_error_in_value(nod_pt,i);
+     global_error+=error*error;
+    }
+  }
+ return sqrt(global_error/double(2*nnod));
+}
+
+
+
+//==start_of_doc_solution_at_time=========================================
+/// Doc solution interpolated (quadratically, from the current and two
+/// previous timesteps) to time t_output
+//========================================================================
+template<class ELEMENT>
+void AnneProblem<ELEMENT>::doc_solution_at_time(DocInfo& doc_info,
+                                                const double& t_output)
+{
+ // Times of the current and the two previous timesteps
+ double t0=time_pt()->time();
+ double t1=t0-time_pt()->dt(0);
+ double t2=t1-time_pt()->dt(1);
+
+ // Lagrange weights
+ double w0=(t_output-t1)*(t_output-t2)/((t0-t1)*(t0-t2));
+ double w1=(t_output-t0)*(t_output-t2)/((t1-t0)*(t1-t2));
+ double w2=(t_output-t0)*(t_output-t1)/((t2-t0)*(t2-t1));
+
+ // Backup current values of velocities and pressure and replace them
+ // by the interpolated ones (the smoothed vorticity gets recomputed
+ // anyway)
+ unsigned nnod=mesh_pt()->nnode();
+ Vector<double> backup(3*nnod);
+ for (unsigned j=0;j<nnod;j++)
+  {
+   Node* nod_pt=mesh_pt()->node_pt(j);
+   for (unsigned i=0;i<3;i++)
+    {
+     backup[3*j+i]=nod_pt->value(0,i);
+     nod_pt->set_value(0,i,w0*nod_pt->value(0,i)+
+                       w1*nod_pt->value(1,i)+
+                       w2*nod_pt->value(2,i));
+    }
+  }
+
+ // Doc
+ time_pt()->time()=t_output;
+ doc_solution(doc_info);
+
+ // Restore
+ time_pt()->time()=t0;
+ for (unsigned j=0;j<nnod;j++)
+  {
+   Node* nod_pt=mesh_pt()->node_pt(j);
+   for (unsigned i=0;i<3;i++)
+    {
+     nod_pt->set_value(0,i,backup[3*j+i]);
     }
-   some_file.close();
   }
-
-} // end_of_doc_solution   
+}
 
 
 
 //========================================================================
-/// Complete problem setup
+/// Magic string that identifies binary checkpoint files (and their
+/// version)
+//========================================================================
+namespace Checkpoint_Helper
+{
+ /// Magic string at the start of checkpoint file
+ const char Magic[8]={'A','N','N','E','C','K','P','1'};
+}
+
+
+//==start_of_write_checkpoint=============================================
+/// \short Write binary checkpoint. Layout: Magic string; unsigneds
+/// nnode, nvalue, ntstorage, ndt, timestep, doc_number, no_slip flag; 
+/// double time; ndt doubles dt; then nvalue*ntstorage doubles for each
+/// node (values for all time levels, value by value).
 //========================================================================
 template<class ELEMENT>
-void AnneProblem<ELEMENT>::complete_problem_setup()
+void AnneProblem<ELEMENT>::write_checkpoint(const std::string& filename,
+                                            const unsigned& timestep,
+                                            const unsigned& doc_number)
 {
+ double t_start=TimingHelpers::timer();
 
- // Unpin all pressure dofs
- RefineableNavierStokesEquations<2>::
-  unpin_all_pressure_dofs(mesh_pt()->element_pt());
+ // Sizes
+ unsigned nnod=mesh_pt()->nnode();
+ unsigned nvalue=mesh_pt()->node_pt(0)->nvalue();
+ unsigned ntstorage=time_stepper_pt()->ntstorage();
+ unsigned ndt=time_pt()->ndt();
  
- //Loop over the elements
- unsigned n_el = mesh_pt()->nelement();
- for(unsigned e=0;e<n_el;e++)
+ // Header
+ Vector<unsigned> header(7);
+ header[0]=nnod;
+ header[1]=nvalue;
+ header[2]=ntstorage;
+ header[3]=ndt;
+ header[4]=timestep;
+ header[5]=doc_number;
+ header[6]=unsigned(No_slip_on_bottom_boundary);
+
+ // Time and dts
+ Vector<double> time_and_dt(ndt+1);
+ time_and_dt[0]=time_pt()->time();
+ for (unsigned t=0;t<ndt;t++)
   {
-   //Cast to a fluid element
-   ELEMENT *el_pt = dynamic_cast<ELEMENT*>(mesh_pt()->element_pt(e));
-
-   //Set the Reynolds number
-   el_pt->re_pt() = &Global_Parameters::Re;   
-   el_pt->re_st_pt() = &Global_Parameters::Re;
+   time_and_dt[1+t]=time_pt()->dt(t);
+  }
 
-   // Set exact solution for vorticity and derivs (for validation)
-   el_pt->exact_vorticity_fct_pt()=&Global_Parameters::synthetic_vorticity;
+ // Pack the nodal values into a single buffer
+ Vector<double> nodal_values(nnod*nvalue*ntstorage);
+ unsigned count=0;
+ for (unsigned j=0;j<nnod;j++)
+  {
+   Node* nod_pt=mesh_pt()->node_pt(j);
+#ifdef PARANOID
+   if (nod_pt->nvalue()!=nvalue)
+    {
+     std::ostringstream error_stream;
+     error_stream << "Node " << j << " stores " << nod_pt->nvalue() 
+                  << " values rather than " << nvalue << std::endl;
+     throw OomphLibError(error_stream.str(),
+                         OOMPH_CURRENT_FUNCTION,
+                         OOMPH_EXCEPTION_LOCATION);
+    }
+#endif
+   for (unsigned i=0;i<nvalue;i++)
+    {
+     for (unsigned t=0;t<ntstorage;t++)
+      {
+       nodal_values[count]=nod_pt->value(t,i);
+       count++;
+      }
+    }
+  }
 
-   // Pin smoothed vorticity
-   el_pt->pin_smoothed_vorticity();
+ // Write to temporary file first
+ std::string tmp_filename=filename+".tmp";
+ FILE* file_pt=fopen(tmp_filename.c_str(),"wb");
+ if (file_pt==0)
+  {
+   std::ostringstream error_stream;
+   error_stream << "Couldn't open checkpoint file " << tmp_filename 
+                << " for writing" << std::endl;
+   throw OomphLibError(error_stream.str(),
+                       OOMPH_CURRENT_FUNCTION,
+                       OOMPH_EXCEPTION_LOCATION);
+  }
+ bool ok=
+  (fwrite(Checkpoint_Helper::Magic,sizeof(char),8,file_pt)==8)&&
+  (fwrite(&header[0],sizeof(unsigned),7,file_pt)==7)&&
+  (fwrite(&time_and_dt[0],sizeof(double),ndt+1,file_pt)==ndt+1)&&
+  (fwrite(&nodal_values[0],sizeof(double),count,file_pt)==count);
+ ok=ok&&(fflush(file_pt)==0)&&(fsync(fileno(file_pt))==0);
+ ok=(fclose(file_pt)==0)&&ok;
+
+ // ...and only then replace the old one
+ if ((!ok)||(rename(tmp_filename.c_str(),filename.c_str())!=0))
+  {
+   std::ostringstream error_stream;
+   error_stream << "Failed to write checkpoint file " << filename 
+                << std::endl;
+   throw OomphLibError(error_stream.str(),
+                       OOMPH_CURRENT_FUNCTION,
+                       OOMPH_EXCEPTION_LOCATION);
   }
 
-  // Pin redudant pressure dofs
-  RefineableNavierStokesEquations<2>::
-   pin_redundant_nodal_pressures(mesh_pt()->element_pt());
-  
+ Telemetry.add_output_time(TimingHelpers::timer()-t_start);
+ oomph_info << "Wrote checkpoint " << filename << " after timestep " 
+            << timestep << " in " << TimingHelpers::timer()-t_start 
+            << " sec " << std::endl;
 }
 
 
 
-
-//========================================================================
-/// Impose no slip and re-assign eqn numbers
+//==start_of_read_checkpoint==============================================
+/// \short Restart from binary checkpoint (memory-mapped). See 
+/// write_checkpoint(...) for the layout.
 //========================================================================
 template<class ELEMENT>
-void AnneProblem<ELEMENT>::impose_no_slip_on_bottom_boundary()
+void AnneProblem<ELEMENT>::read_checkpoint(const std::string& filename,
+                                           unsigned& timestep,
+                                           unsigned& doc_number)
 {
+ std::ostringstream error_stream;
 
+ // Map the file
+ int fd=open(filename.c_str(),O_RDONLY);
+ struct stat file_stat;
+ if ((fd<0)||(fstat(fd,&file_stat)!=0))
+  {
+   error_stream << "Couldn't open checkpoint file " << filename 
+                << std::endl;
+   throw OomphLibError(error_stream.str(),
+                       OOMPH_CURRENT_FUNCTION,
+                       OOMPH_EXCEPTION_LOCATION);
+  }
+ size_t file_size=file_stat.st_size;
+ void* map_pt=mmap(0,file_size,PROT_READ,MAP_PRIVATE,fd,0);
+ close(fd);
+ if (map_pt==MAP_FAILED)
+  {
+   error_stream << "Couldn't memory-map checkpoint file " << filename 
+                << std::endl;
+   throw OomphLibError(error_stream.str(),
+                       OOMPH_CURRENT_FUNCTION,
+                       OOMPH_EXCEPTION_LOCATION);
+  }
+ const char* data_pt=static_cast<const char*>(map_pt);
 
- // Pin horizontal velocity at bottom boundary and apply correction
- unsigned ibound=0;
- unsigned num_nod=mesh_pt()->nboundary_node(ibound);
- for (unsigned inod=0;inod<num_nod;inod++)
+ // Check magic string and header
+ unsigned header[7];
+ size_t header_size=8+7*sizeof(unsigned);
+ if ((file_size<header_size)||
+     (memcmp(data_pt,Checkpoint_Helper::Magic,8)!=0))
   {
-   mesh_pt()->boundary_node_pt(ibound,inod)->pin(0);
-   mesh_pt()->boundary_node_pt(ibound,inod)->set_value(0,Global_Parameters::K);
+   munmap(map_pt,file_size);
+   error_stream << filename << " is not a checkpoint file" << std::endl;
+   throw OomphLibError(error_stream.str(),
+                       OOMPH_CURRENT_FUNCTION,
+                       OOMPH_EXCEPTION_LOCATION);
+  }
+ memcpy(header,data_pt+8,7*sizeof(unsigned));
+ unsigned nnod=header[0];
+ unsigned nvalue=header[1];
+ unsigned ntstorage=header[2];
+ unsigned ndt=header[3];
+ if ((nnod!=mesh_pt()->nnode())||
+     (nvalue!=mesh_pt()->node_pt(0)->nvalue())||
+     (ntstorage!=time_stepper_pt()->ntstorage())||
+     (ndt!=time_pt()->ndt())||
+     (file_size!=header_size+sizeof(double)*(ndt+1+nnod*nvalue*ntstorage)))
+  {
+   munmap(map_pt,file_size);
+   error_stream 
+    << "Checkpoint file " << filename << " doesn't match the problem:\n"
+    << "nnode, nvalue, ntstorage, ndt in file   : " 
+    << nnod << " " << nvalue << " " << ntstorage << " " << ndt << "\n"
+    << "nnode, nvalue, ntstorage, ndt in problem: " 
+    << mesh_pt()->nnode() << " " << mesh_pt()->node_pt(0)->nvalue() << " "
+    << time_stepper_pt()->ntstorage() << " " << time_pt()->ndt() 
+    << std::endl;
+   throw OomphLibError(error_stream.str(),
+                       OOMPH_CURRENT_FUNCTION,
+                       OOMPH_EXCEPTION_LOCATION);
   }
+ timestep=header[4];
+ doc_number=header[5];
 
- // Re-assign equation numbers
- oomph_info << std::endl 
-            << "ndofs before applying no slip at bottom boundary: "
-            << ndof() << std::endl;
- assign_eqn_numbers();
- oomph_info << "ndofs after applying no slip at bottom boundary : "
-            << ndof() << std::endl << std::endl;
- 
+ // Impose no slip first (this changes the equation numbering and
+ // overwrites the current horizontal velocity at the bottom boundary 
+ // which we're about to read anyway)
+ if ((header[6]!=0)&&(!No_slip_on_bottom_boundary))
+  {
+   impose_no_slip_on_bottom_boundary();
+  }
+
+ // Time and dts
+ Vector<double> time_and_dt(ndt+1);
+ memcpy(&time_and_dt[0],data_pt+header_size,(ndt+1)*sizeof(double));
+ time_pt()->time()=time_and_dt[0];
+ for (unsigned t=0;t<ndt;t++)
+  {
+   time_pt()->dt(t)=time_and_dt[1+t];
+  }
+ time_stepper_pt()->set_weights();
+
+ // Nodal values
+ const char* value_pt=data_pt+header_size+(ndt+1)*sizeof(double);
+ double value=0.0;
+ for (unsigned j=0;j<nnod;j++)
+  {
+   Node* nod_pt=mesh_pt()->node_pt(j);
+   for (unsigned i=0;i<nvalue;i++)
+    {
+     for (unsigned t=0;t<ntstorage;t++)
+      {
+       memcpy(&value,value_pt,sizeof(double));
+       nod_pt->set_value(t,i,value);
+       value_pt+=sizeof(double);
+      }
+    }
+  }
+
+ munmap(map_pt,file_size);
+
+ oomph_info << "Restarted from checkpoint " << filename 
+            << " written after timestep " << timestep 
+            << "; time is now " << time_pt()->time() << std::endl;
 }
 
 
@@ -853,6 +3418,231 @@ int main(int argc, char* argv[])
  // Use gmres?
  CommandLineArgs::specify_command_line_flag("--use_oomph_gmres");
 
+ // Restart from checkpoint file
+ CommandLineArgs::specify_command_line_flag(
+  "--restart",
+  &Global_Parameters::Restart_file);
+
+ // Number of timesteps between checkpoints (default 0: none)
+ CommandLineArgs::specify_command_line_flag(
+  "--checkpoint_interval",
+  &Global_Parameters::Checkpoint_interval);
+
+ // Write compressed snapshots (decompress with snapshot_convert)
+ // rather than tecplot files
+ CommandLineArgs::specify_command_line_flag("--compressed_output");
+
+ // Error bounds for the fields in the compressed snapshots
+ CommandLineArgs::specify_command_line_flag(
+  "--error_bound_u",
+  &Global_Parameters::Error_bound_u);
+ CommandLineArgs::specify_command_line_flag(
+  "--error_bound_v",
+  &Global_Parameters::Error_bound_v);
+ CommandLineArgs::specify_command_line_flag(
+  "--error_bound_p",
+  &Global_Parameters::Error_bound_p);
+ CommandLineArgs::specify_command_line_flag(
+  "--error_bound_omega",
+  &Global_Parameters::Error_bound_omega);
+
+ // Are error bounds relative to the range of the field values?
+ CommandLineArgs::specify_command_line_flag("--relative_error_bounds");
+
+ // Append snapshots to single archive file soln_archive.bin rather 
+ // than writing separate files
+ CommandLineArgs::specify_command_line_flag("--snapshot_archive");
+
+ // Max. number of timesteps in archive
+ CommandLineArgs::specify_command_line_flag(
+  "--archive_max_nstep",
+  &Global_Parameters::Archive_max_nstep);
+
+ // Resample vorticity onto uniform nx x ny grid covering the domain
+ CommandLineArgs::specify_command_line_flag(
+  "--uniform_grid_nx",
+  &Global_Parameters::Uniform_grid_nx);
+ CommandLineArgs::specify_command_line_flag(
+  "--uniform_grid_ny",
+  &Global_Parameters::Uniform_grid_ny);
+
+ // Also resample velocities and the recovered derivatives
+ CommandLineArgs::specify_command_line_flag("--uniform_grid_all_fields");
+
+ // Adaptive (rather than fixed) timestepping
+ CommandLineArgs::specify_command_line_flag("--adaptive_timestepping");
+
+ // Target for temporal error norm in adaptive timestepping
+ CommandLineArgs::specify_command_line_flag(
+  "--temporal_error_tolerance",
+  &Global_Parameters::Temporal_error_tolerance);
+
+ // Interval between outputs in adaptive timestepping
+ CommandLineArgs::specify_command_line_flag(
+  "--dt_output",
+  &Global_Parameters::Dt_output);
+
+ // Use AMG (rather than MUMPS) for the pressure Schur complement block
+ CommandLineArgs::specify_command_line_flag("--use_amg_for_p_block");
+
+ // Thresholds for strength of connection and affinity in AMG
+ CommandLineArgs::specify_command_line_flag(
+  "--amg_strength_threshold",
+  &Global_Parameters::Amg_strength_threshold);
+ CommandLineArgs::specify_command_line_flag(
+  "--amg_affinity_threshold",
+  &Global_Parameters::Amg_affinity_threshold);
+
+ // Use the algebraic pressure-correction (fractional-step) solver
+ // rather than the monolithic solve (GMRES or direct); combine with
+ // --linearised_timestepping for one projection step per timestep
+ CommandLineArgs::specify_command_line_flag("--use_pressure_correction");
+
+ // Use geometric multigrid (rather than MUMPS) for the momentum block
+ CommandLineArgs::specify_command_line_flag("--use_gmg_for_f_block");
+
+ // Use GCRO-DR (GMRES with a deflation space of harmonic Ritz vectors
+ // that's recycled between the solves) rather than GMRES with
+ // --use_oomph_gmres
+ CommandLineArgs::specify_command_line_flag("--gcrodr");
+ CommandLineArgs::specify_command_line_flag(
+  "--gcrodr_krylov_dimension",
+  &Global_Parameters::Gcrodr_krylov_dimension);
+ CommandLineArgs::specify_command_line_flag(
+  "--gcrodr_nrecycle",
+  &Global_Parameters::Gcrodr_nrecycle);
+
+ // Adapt the (relative) GMRES tolerance to the reduction of the 
+ // residuals in the Newton iteration (Eisenstat-Walker)
+ CommandLineArgs::specify_command_line_flag("--eisenstat_walker");
+ CommandLineArgs::specify_command_line_flag(
+  "--eisenstat_walker_eta_initial",
+  &Global_Parameters::Eisenstat_walker_eta_initial);
+ CommandLineArgs::specify_command_line_flag(
+  "--eisenstat_walker_eta_max",
+  &Global_Parameters::Eisenstat_walker_eta_max);
+
+ // Always use the general (isoparametric) mapping in the elements, 
+ // even if they're affine rectangles
+ CommandLineArgs::specify_command_line_flag(
+  "--disable_affine_rectangle_elements");
+
+ // Eliminate the unknowns at the element-interior (centre) nodes before
+ // the direct solves: in the monolithic direct solve or, with 
+ // --use_oomph_gmres, in the solves for the diagonal blocks of the
+ // momentum block
+ CommandLineArgs::specify_command_line_flag("--static_condensation");
+
+ // Store the AMG/GMG hierarchies for the P and F blocks in single
+ // precision (MUMPS factorisations remain in double precision)
+ CommandLineArgs::specify_command_line_flag(
+  "--single_precision_preconditioners");
+
+ // Number of threads for (multithreaded) assembly
+ CommandLineArgs::specify_command_line_flag(
+  "--nthread",
+  &Global_Parameters::Nthread);
+
+ // Compute the sparsity pattern of the Jacobian once per equation
+ // numbering and add the element Jacobians straight into it
+ CommandLineArgs::specify_command_line_flag("--reuse_sparsity_pattern");
+
+ // Renumber nodes and elements after the mesh has been built ("rcm" or
+ // "hilbert"; the same has to be used when restarting from a checkpoint)
+ CommandLineArgs::specify_command_line_flag(
+  "--renumber",
+  &Global_Parameters::Renumbering_method);
+
+ // Doc bandwidth and profile of the Jacobian before and after renumbering
+ CommandLineArgs::specify_command_line_flag("--doc_renumbering");
+
+ // Extrapolate initial guess for Newton iteration from history values
+ // rather than starting from the previous solution
+ CommandLineArgs::specify_command_line_flag("--extrapolate_initial_guess");
+
+ // Linearised (semi-implicit) timestepping: a single Newton step per
+ // timestep, linearised about the solution extrapolated from the
+ // previous two timesteps (BDF2 stays second-order accurate); without
+ // it, Newton's method is iterated to convergence in every timestep
+ CommandLineArgs::specify_command_line_flag("--linearised_timestepping");
+
+ // Re-use preconditioner for the GMRES solver across Newton steps and 
+ // timesteps?
+ CommandLineArgs::specify_command_line_flag("--reuse_preconditioner");
+
+ // Compute the products with the Jacobian in GMRES element by element
+ // (rather than with the assembled Jacobian, which is then only 
+ // assembled for the setup of the preconditioner)
+ CommandLineArgs::specify_command_line_flag("--matrix_free_jacobian");
+
+ // Max. number of timesteps for which the preconditioner is re-used
+ CommandLineArgs::specify_command_line_flag(
+  "--preconditioner_reuse_nstep",
+  &Global_Parameters::Preconditioner_reuse_nstep);
+
+ // Set up preconditioner again if GMRES iterations grow by this factor
+ CommandLineArgs::specify_command_line_flag(
+  "--preconditioner_reuse_iteration_factor",
+  &Global_Parameters::Preconditioner_reuse_iteration_factor);
+
+ // Solve the no-slip phase with Parareal (fixed timesteps only)
+ CommandLineArgs::specify_command_line_flag("--parareal");
+
+ // Number of time slices for Parareal
+ CommandLineArgs::specify_command_line_flag(
+  "--parareal_nslice",
+  &Global_Parameters::Parareal_nslice);
+
+ // Max. number of processes for the fine propagations in Parareal
+ CommandLineArgs::specify_command_line_flag(
+  "--parareal_nproc",
+  &Global_Parameters::Parareal_nproc);
+
+ // Max. number of Parareal iterations
+ CommandLineArgs::specify_command_line_flag(
+  "--parareal_max_iter",
+  &Global_Parameters::Parareal_max_iter);
+
+ // Tolerance for the max. relative change in a Parareal iteration
+ CommandLineArgs::specify_command_line_flag(
+  "--parareal_tolerance",
+  &Global_Parameters::Parareal_tolerance);
+
+ // Timestep of coarse propagator relative to the timestep
+ CommandLineArgs::specify_command_line_flag(
+  "--parareal_coarse_dt_factor",
+  &Global_Parameters::Parareal_coarse_dt_factor);
+
+ // Compute the serial solution first and doc the error of the Parareal
+ // iterates relative to it
+ CommandLineArgs::specify_command_line_flag("--parareal_reference");
+
+ // Take the timesteps before the switch-over to no slip on a coarser mesh
+ // (with this mesh scaling factor), then project onto the actual mesh
+ CommandLineArgs::specify_command_line_flag(
+  "--coarse_startup_mesh_scaling_factor",
+  &Global_Parameters::Coarse_startup_mesh_scaling_factor);
+
+ // Number of timesteps on the coarser mesh
+ CommandLineArgs::specify_command_line_flag(
+  "--coarse_startup_nstep",
+  &Global_Parameters::Coarse_startup_nstep);
+
+ // Ensemble run: comma-separated lists of Reynolds numbers and mesh
+ // scaling factors (all combinations are run, each in its own process
+ // and output directory RESLT/re<Re>_msf<factor>)
+ CommandLineArgs::specify_command_line_flag(
+  "--ensemble_re",
+  &Global_Parameters::Ensemble_re);
+ CommandLineArgs::specify_command_line_flag(
+  "--ensemble_mesh_scaling_factor",
+  &Global_Parameters::Ensemble_mesh_scaling_factor);
+
+ // Max. number of ensemble members that run at the same time
+ CommandLineArgs::specify_command_line_flag(
+  "--ensemble_nproc",
+  &Global_Parameters::Ensemble_nproc);
+
  // Parse command line
  CommandLineArgs::parse_and_assign(); 
  
@@ -863,9 +3653,90 @@ int main(int argc, char* argv[])
  DocInfo doc_info;
  doc_info.set_directory("RESLT");
 
+ // Ensemble run? Then we only carry on in the process for a mesh scaling
+ // factor...
+ bool ensemble_run=Ensemble_Helper::is_ensemble_run();
+ if (ensemble_run)
+  {
+   Ensemble_Helper::fork_mesh_groups(doc_info.directory());
+  }
+
+ // Start of the setup (for the time to the first production timestep)
+ double t_start_setup=TimingHelpers::timer();
+
+ // Timestep
+ double dt=0.1; 
+
+ // Number of timesteps until switch-over to no slip
+ unsigned nstep_impulsive=10;
+
+ // Total number of timesteps
+ unsigned nstep=nstep_impulsive+1300;
+
+ // First timestep to be taken
+ unsigned first_step=1;
+
+ // Coarse-mesh startup? Take the first timesteps (up to the switch-over
+ // to no slip) on a coarser mesh. (This has to be done before the 
+ // production problem is built since the problems share the global
+ // helpers for the subsidiary preconditioners.)
+ typedef VorticitySmootherElement<ProjectableTaylorHoodElement<
+  RefineableQTaylorHoodElement<2> > > ELEMENT;
+ AnneProblem<ELEMENT>* coarse_problem_pt=0;
+ std::vector<std::vector<double> > coarse_state;
+ std::vector<double> coarse_time;
+ if (CommandLineArgs::command_line_flag_has_been_set(
+      "--coarse_startup_mesh_scaling_factor")&&
+     (!CommandLineArgs::command_line_flag_has_been_set("--restart"))&&
+     ensemble_run)
+  {
+   oomph_info << "Warning: --coarse_startup_mesh_scaling_factor is "
+              << "ignored in ensemble runs." << std::endl;
+  }
+ else if (CommandLineArgs::command_line_flag_has_been_set(
+           "--coarse_startup_mesh_scaling_factor")&&
+          (!CommandLineArgs::command_line_flag_has_been_set("--restart")))
+  {
+   double t_start=TimingHelpers::timer();
+   double mesh_scaling_factor=Global_Parameters::Mesh_scaling_factor;
+   Global_Parameters::Mesh_scaling_factor=
+    Global_Parameters::Coarse_startup_mesh_scaling_factor;
+   coarse_problem_pt=new AnneProblem<ELEMENT>;
+   Global_Parameters::Mesh_scaling_factor=mesh_scaling_factor;
+
+   // Keep the states after all timesteps (incl. the initial one) so
+   // they can be projected onto the fine mesh and documented there
+   coarse_problem_pt->initialise_dt(dt);
+   coarse_problem_pt->assign_initial_values_impulsive();
+   unsigned ncoarse_step=std::min(Global_Parameters::Coarse_startup_nstep,
+                                  nstep_impulsive);
+   coarse_state.resize(ncoarse_step+1);
+   coarse_time.resize(ncoarse_step+1);
+   coarse_problem_pt->get_state_with_history(coarse_state[0],dt);
+   coarse_time[0]=coarse_problem_pt->time_pt()->time();
+   for (unsigned t=1;t<=ncoarse_step;t++)
+    {
+     oomph_info << "COARSE STARTUP TIMESTEP " << t << std::endl;
+     coarse_problem_pt->unsteady_newton_solve(dt);
+     coarse_problem_pt->get_state_with_history(coarse_state[t],dt);
+     coarse_time[t]=coarse_problem_pt->time_pt()->time();
+    }
+   first_step=ncoarse_step+1;
+   oomph_info << "Time for coarse startup: " 
+              << TimingHelpers::timer()-t_start << " sec" << std::endl;
+  }
+
  //Set up problem
- AnneProblem<VorticitySmootherElement<ProjectableTaylorHoodElement<RefineableQTaylorHoodElement<2> > > > 
-  problem;
+ AnneProblem<ELEMENT> problem;
+
+ // ...and in the processes for the Reynolds numbers, forked from the
+ // problem that's just been built (after the structures that don't 
+ // depend on the Reynolds number have been set up, so they're shared)
+ if (ensemble_run)
+  {
+   problem.setup_mesh_dependent_structures();
+   Ensemble_Helper::fork_members(doc_info);
+  }
   
  // Check vorticity smoothing then stop
  if (CommandLineArgs::command_line_flag_has_been_set("--validate_projection"))
@@ -873,46 +3744,204 @@ int main(int argc, char* argv[])
    problem.check_smoothed_vorticity(doc_info);
   }
  
-// Initialise all history values for an impulsive start
- double dt=0.1; 
- problem.initialise_dt(dt);
- problem.assign_initial_values_impulsive();
+ // Per-timestep log of solver statistics and timings (continued after
+ // restart)
+ problem.telemetry().open(
+  doc_info.directory()+"/telemetry.csv",
+  CommandLineArgs::command_line_flag_has_been_set("--restart"));
+
+ // Restart?
+ if (CommandLineArgs::command_line_flag_has_been_set("--restart"))
+  {
+   unsigned last_step=0;
+   problem.read_checkpoint(Global_Parameters::Restart_file,
+                           last_step,doc_info.number());
+   first_step=last_step+1;
+  }
+ else if (coarse_problem_pt!=0)
+  {
+   // Transfer the solutions (and their history) from the coarse mesh
+   // and doc them as we would have done on the fine mesh: after every
+   // timestep, or (with adaptive timestepping) at the output times. The
+   // last one is the initial condition for the fine timestepping, so
+   // it's projected; the others are only documented, so it's good
+   // enough to interpolate them.
+   bool adaptive_timestepping=CommandLineArgs::command_line_flag_has_been_set(
+    "--adaptive_timestepping");
+   double dt_output=Global_Parameters::Dt_output;
+   double t_tol=1.0e-10*double(nstep)*dt;
+   unsigned ncoarse_state=coarse_state.size();
+   for (unsigned t=0;t<ncoarse_state;t++)
+    {
+     coarse_problem_pt->set_state_with_history(coarse_state[t],
+                                               coarse_time[t],dt);
+     if (t+1==ncoarse_state)
+      {
+       problem.project_from(coarse_problem_pt);
+      }
+     else
+      {
+       problem.interpolate_from(coarse_problem_pt);
+      }
+     if (!adaptive_timestepping)
+      {
+       problem.doc_solution(doc_info);
+       doc_info.number()++;
+       continue;
+      }
+     double t_next_output=double(doc_info.number())*dt_output;
+     while (t_next_output<=problem.time_pt()->time()+t_tol)
+      {
+       if (std::fabs(t_next_output-problem.time_pt()->time())<=t_tol)
+        {
+         problem.doc_solution(doc_info);
+        }
+       else
+        {
+         problem.doc_solution_at_time(doc_info,t_next_output);
+        }
+       doc_info.number()++;
+       t_next_output=double(doc_info.number())*dt_output;
+      }
+    }
+   delete coarse_problem_pt;
+   coarse_problem_pt=0;
+  }
+ else
+  {
+   // Initialise all history values for an impulsive start
+   problem.initialise_dt(dt);
+   problem.assign_initial_values_impulsive();
+   
+   // Doc initial condition
+   problem.doc_solution(doc_info);
+   
+   // increment counter
+   doc_info.number()++;
+  }
+ oomph_info << "Time to first production timestep (step " << first_step 
+            << ", t = " << problem.time_pt()->time() << "): " 
+            << TimingHelpers::timer()-t_start_setup << " sec" << std::endl;
 
- // Number of timesteps until switch-over to no slip
- unsigned ntsteps=10;
+ // Adaptive timestepping
+ //----------------------
+ if (CommandLineArgs::command_line_flag_has_been_set("--adaptive_timestepping"))
+  {
+   if (CommandLineArgs::command_line_flag_has_been_set("--parareal"))
+    {
+     oomph_info << "Warning: --parareal is ignored with adaptive "
+                << "timestepping." << std::endl;
+    }
 
- // Doc initial condition
- problem.doc_solution(doc_info);
- 
- // increment counter
- doc_info.number()++;
+   // Time of switch-over to no slip and end time (as for fixed timestep)
+   double t_no_slip=double(nstep_impulsive)*dt;
+   double t_end=double(nstep)*dt;
 
- //Loop over the timesteps
- for(unsigned t=1;t<=ntsteps;t++)
-  {
-   oomph_info << "TIMESTEP " << t << std::endl;
-   
-   //Take one fixed timestep
-   problem.unsteady_newton_solve(dt);
+   // Tolerance for comparison of times
+   double t_tol=1.0e-10*t_end;
 
-   //Output the time
-   oomph_info << "Time is now " << problem.time_pt()->time() << std::endl;
+   // Outputs are at uniform intervals, starting at t=0
+   double dt_output=Global_Parameters::Dt_output;
+   double t_next_output=double(doc_info.number())*dt_output;
 
-   // Doc solution
-   problem.doc_solution(doc_info);
+   // Suggested timestep (carry on with the last one after restart)
+   double dt_next=dt;
+   if (CommandLineArgs::command_line_flag_has_been_set("--restart"))
+    {
+     dt_next=problem.time_pt()->dt(0);
+    }
 
-   // increment counter
-   doc_info.number()++;
+   unsigned t=first_step;
+   while (problem.time_pt()->time()<t_end-t_tol)
+    {
+     // Now do no slip (impulsively so the temporal error estimate
+     // isn't polluted by the jump in the boundary condition)
+     if ((problem.time_pt()->time()>=t_no_slip-t_tol)&&
+         (!problem.no_slip_on_bottom_boundary()))
+      {
+       bool impulsive=true;
+       problem.impose_no_slip_on_bottom_boundary(impulsive);
+      }
+
+     // Don't step across the switch-over to no slip or the end time
+     double t_stop=t_end;
+     if (!problem.no_slip_on_bottom_boundary())
+      {
+       t_stop=t_no_slip;
+      }
+     double dt_trial=std::min(dt_next,t_stop-problem.time_pt()->time());
+
+     oomph_info << "TIMESTEP " << t << " with dt = " << dt_trial 
+                << std::endl;
+     problem.telemetry().start_timestep(TimingHelpers::timer());
+
+     // Take adaptive timestep
+     dt_next=problem.adaptive_unsteady_newton_solve(
+      dt_trial,Global_Parameters::Temporal_error_tolerance);
+
+     oomph_info << "Time is now " << problem.time_pt()->time() 
+                << "; suggested next dt = " << dt_next << std::endl;
+
+     // Doc solution at all output times we've stepped across
+     while (t_next_output<=problem.time_pt()->time()+t_tol)
+      {
+       if (std::fabs(t_next_output-problem.time_pt()->time())<=t_tol)
+        {
+         problem.doc_solution(doc_info);
+        }
+       else
+        {
+         problem.doc_solution_at_time(doc_info,t_next_output);
+        }
+       doc_info.number()++;
+       t_next_output=double(doc_info.number())*dt_output;
+      }
+
+     // Checkpoint
+     if ((Global_Parameters::Checkpoint_interval!=0)&&
+         (t%Global_Parameters::Checkpoint_interval==0))
+      {
+       char filename[100];
+       sprintf(filename,"%s/checkpoint%i.bin",
+               doc_info.directory().c_str(),t);
+       problem.write_checkpoint(filename,t,doc_info.number());
+      }
+     problem.telemetry().write_timestep(t,problem.time_pt()->time(),
+                                        problem.time_pt()->dt(0),
+                                        TimingHelpers::timer());
+     t++;
+    }
+
+   oomph_info << "Reached t = " << problem.time_pt()->time() << " in " 
+              << t-first_step << " adaptive timesteps" << std::endl;
+
+#ifdef OOMPH_HAS_MPI
+   MPI_Helpers::finalize();
+#endif
+   
+   return 0;
   }
 
- // Now do no slip
- problem.impose_no_slip_on_bottom_boundary();
 
- //Loop over the remaining timesteps
- ntsteps=1300;
- for(unsigned t=1;t<=ntsteps;t++)
+ //Loop over the timesteps
+ for(unsigned t=first_step;t<=nstep;t++)
   {
+   // Now do no slip
+   if ((t>nstep_impulsive)&&(!problem.no_slip_on_bottom_boundary()))
+    {
+     problem.impose_no_slip_on_bottom_boundary();
+    }
+
+   // Parallel-in-time solution of the remaining timesteps?
+   if ((t>nstep_impulsive)&&
+       CommandLineArgs::command_line_flag_has_been_set("--parareal"))
+    {
+     problem.parareal_solve(doc_info,nstep-t+1,dt);
+     break;
+    }
+
    oomph_info << "TIMESTEP " << t << std::endl;
+   problem.telemetry().start_timestep(TimingHelpers::timer());
    
    //Take one fixed timestep
    problem.unsteady_newton_solve(dt);
@@ -925,6 +3954,19 @@ int main(int argc, char* argv[])
 
    // increment counter
    doc_info.number()++;
+
+   // Checkpoint
+   if ((Global_Parameters::Checkpoint_interval!=0)&&
+       (t%Global_Parameters::Checkpoint_interval==0))
+    {
+     char filename[100];
+     sprintf(filename,"%s/checkpoint%i.bin",doc_info.directory().c_str(),t);
+     problem.write_checkpoint(filename,t,doc_info.number());
+    }
+
+   // Log solver statistics and timings
+   problem.telemetry().write_timestep(t,problem.time_pt()->time(),dt,
+                                      TimingHelpers::timer());
   }
 
 
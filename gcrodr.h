@@ -0,0 +1,636 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// GCRO-DR (Parks, de Sturler, Mackey, Johnson & Maiti, 2006): restarted
+// GMRES with deflated restarting and recycling of a subspace between
+// the linear solves of a sequence (the Newton steps and timesteps).
+// With right preconditioning, the preconditioned operator is 
+// A' = A M^{-1}. The recycled space is spanned by the columns of U, with
+// A' U = C and C orthonormal. Each solve starts by projecting the
+// residual onto the complement of span(C), and the Arnoldi process runs
+// for (I - C C^T) A'. At the end of each cycle, U is replaced by the
+// harmonic Ritz vectors of the cycle for the harmonic Ritz values of
+// smallest magnitude, i.e. approximations to the eigenvectors that slow
+// GMRES down. When the operator changes between solves (new Jacobian or
+// preconditioner), C is recomputed from U, which costs one application
+// of A' per recycled vector. Serial matrices only.
+
+#ifndef GCRODR_HEADER
+#define GCRODR_HEADER
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "multilevel_helpers.h"
+
+namespace oomph
+{
+
+//======================================================================
+/// \short GCRO-DR: Right-preconditioned GMRES with deflated restarting
+/// that keeps the deflation space of (approximate) harmonic Ritz
+/// vectors between solves. The Krylov dimension is the total dimension
+/// of the search space in a cycle (including the recycled vectors).
+//======================================================================
+class GCRODR : public IterativeLinearSolver
+{
+
+public:
+
+ /// Constructor: Default Krylov dimension and number of recycled vectors
+ GCRODR() : Krylov_dimension(40), Nrecycle(10), Iterations(0), 
+            Nrecycle_application(0), Nrow(0), Matrix_pt(0)
+  {}
+
+ /// Destructor
+ ~GCRODR()
+  {
+   clean_up_memory();
+  }
+
+ /// Broken copy constructor
+ GCRODR(const GCRODR&)
+  {
+   BrokenCopy::broken_copy("GCRODR");
+  }
+
+ /// Broken assignment operator
+ void operator=(const GCRODR&)
+  {
+   BrokenCopy::broken_assign("GCRODR");
+  }
+
+ /// \short Max. dimension of the search space in a cycle (recycled
+ /// vectors and Krylov vectors)
+ unsigned& krylov_dimension() {return Krylov_dimension;}
+
+ /// Max. number of recycled vectors
+ unsigned& nrecycle() {return Nrecycle;}
+
+ /// Current number of recycled vectors
+ unsigned nrecycle_vector() const {return U.size();}
+
+ /// Number of iterations in the last solve
+ unsigned iterations() const {return Iterations;}
+
+ /// \short Number of applications of the preconditioned operator in
+ /// the last solve to adapt the recycled space to a new operator (not
+ /// included in iterations())
+ unsigned nrecycle_application() const {return Nrecycle_application;}
+
+ /// Forget the recycled space
+ void reset_recycle_space()
+  {
+   U.clear();
+   C.clear();
+  }
+
+ /// Clean up memory (including the recycled space)
+ void clean_up_memory()
+  {
+   reset_recycle_space();
+  }
+
+ /// Solve the linear system in the Newton iteration of the problem
+ void solve(Problem* const& problem_pt, DoubleVector& result)
+  {
+   double t_start=TimingHelpers::timer();
+   DoubleVector residuals;
+   problem_pt->get_jacobian(residuals,Jacobian);
+   Jacobian_setup_time=TimingHelpers::timer()-t_start;
+   solve(&Jacobian,residuals,result);
+  }
+
+ /// \short Solve the linear system (with the recycled space from the
+ /// previous solves, if the number of rows hasn't changed)
+ void solve(DoubleMatrixBase* const& matrix_pt, const DoubleVector& rhs,
+            DoubleVector& result)
+  {
+   double t_start=TimingHelpers::timer();
+   Matrix_pt=matrix_pt;
+   unsigned n=matrix_pt->nrow();
+   if (n!=Nrow)
+    {
+     reset_recycle_space();
+     Nrow=n;
+    }
+   Iterations=0;
+   Nrecycle_application=0;
+
+   // Set up the preconditioner
+   if (Setup_preconditioner_before_solve)
+    {
+     double t_prec=TimingHelpers::timer();
+     preconditioner_pt()->setup(matrix_pt);
+     Preconditioner_setup_time=TimingHelpers::timer()-t_prec;
+    }
+   Work_in.build(rhs.distribution_pt(),0.0);
+   Work_out.build(rhs.distribution_pt(),0.0);
+   Work_product.build(rhs.distribution_pt(),0.0);
+
+   // Solve A' y = b, starting from y=0; then x = M^{-1} y
+   std::vector<double> r(rhs.values_pt(),rhs.values_pt()+n);
+   std::vector<double> y(n,0.0);
+   double norm_r=norm(r);
+   double tol=Tolerance*norm_r;
+   if (norm_r>0.0)
+    {
+     // Adapt the recycled space to the current operator and project
+     // the residual onto its complement
+     if (U.size()>0)
+      {
+       update_recycle_space();
+      }
+     unsigned k=U.size();
+     for (unsigned i=0;i<k;i++)
+      {
+       double alpha=dot(C[i],r);
+       axpy(alpha,U[i],y);
+       axpy(-alpha,C[i],r);
+      }
+     norm_r=norm(r);
+
+     // Cycles
+     while ((norm_r>tol)&&(Iterations<Max_iter))
+      {
+       norm_r=cycle(tol,r,y);
+      }
+    }
+   std::copy(y.begin(),y.end(),Work_in.values_pt());
+   preconditioner_pt()->preconditioner_solve(Work_in,Work_out);
+   result.build(rhs.distribution_pt(),0.0);
+   std::copy(Work_out.values_pt(),Work_out.values_pt()+n,result.values_pt());
+
+   Solution_time=TimingHelpers::timer()-t_start;
+   if (norm_r>tol)
+    {
+     oomph_info << "Warning: GCRO-DR hasn't converged in " << Iterations
+                << " iterations (relative residual " 
+                << norm_r/(tol/Tolerance) << ")" << std::endl;
+    }
+   if (Doc_time)
+    {
+     oomph_info << "GCRO-DR iterations: " << Iterations 
+                << " (plus " << Nrecycle_application 
+                << " operator applications for " << U.size()
+                << " recycled vectors); time for solve: " 
+                << Solution_time << " sec" << std::endl;
+    }
+  }
+
+private:
+
+ /// Dot product
+ static double dot(const std::vector<double>& a, 
+                   const std::vector<double>& b)
+  {
+   double sum=0.0;
+   unsigned n=a.size();
+   for (unsigned i=0;i<n;i++)
+    {
+     sum+=a[i]*b[i];
+    }
+   return sum;
+  }
+
+ /// 2-norm
+ static double norm(const std::vector<double>& a)
+  {
+   return std::sqrt(dot(a,a));
+  }
+
+ /// y += alpha x
+ static void axpy(const double& alpha, const std::vector<double>& x,
+                  std::vector<double>& y)
+  {
+   unsigned n=x.size();
+   for (unsigned i=0;i<n;i++)
+    {
+     y[i]+=alpha*x[i];
+    }
+  }
+
+ /// Apply the preconditioned operator: w = A M^{-1} v
+ void apply_operator(const std::vector<double>& v, std::vector<double>& w)
+  {
+   std::copy(v.begin(),v.end(),Work_in.values_pt());
+   preconditioner_pt()->preconditioner_solve(Work_in,Work_out);
+   Matrix_pt->multiply(Work_out,Work_product);
+   w.assign(Work_product.values_pt(),Work_product.values_pt()+v.size());
+  }
+
+ /// \short Orthonormalise the columns of c (modified Gram-Schmidt),
+ /// c = Q R, and apply the same transformation to the columns of u,
+ /// u := u R^{-1}. Columns that are (numerically) linearly dependent
+ /// on the previous ones are dropped. Works for n-vectors and for
+ /// small dense matrices (stored by columns).
+ static void orthonormalise(std::vector<std::vector<double> >& c,
+                            std::vector<std::vector<double> >& u)
+  {
+   unsigned k=c.size();
+   double max_norm=0.0;
+   for (unsigned l=0;l<k;l++)
+    {
+     max_norm=std::max(max_norm,norm(c[l]));
+    }
+   unsigned nkeep=0;
+   for (unsigned l=0;l<k;l++)
+    {
+     for (unsigned i=0;i<nkeep;i++)
+      {
+       double r_il=dot(c[i],c[l]);
+       axpy(-r_il,c[i],c[l]);
+       axpy(-r_il,u[i],u[l]);
+      }
+     double r_ll=norm(c[l]);
+     if (r_ll>1.0e-10*max_norm)
+      {
+       for (unsigned i=0;i<c[l].size();i++) c[l][i]/=r_ll;
+       for (unsigned i=0;i<u[l].size();i++) u[l][i]/=r_ll;
+       c[nkeep].swap(c[l]);
+       u[nkeep].swap(u[l]);
+       nkeep++;
+      }
+    }
+   c.resize(nkeep);
+   u.resize(nkeep);
+  }
+
+ /// \short Recompute C = A' U for the current operator (and make C
+ /// orthonormal again)
+ void update_recycle_space()
+  {
+   unsigned k=U.size();
+   C.resize(k);
+   for (unsigned i=0;i<k;i++)
+    {
+     apply_operator(U[i],C[i]);
+    }
+   Nrecycle_application+=k;
+   orthonormalise(C,U);
+  }
+
+ /// \short Solve the dense least-squares problem min |rhs - g z| for
+ /// the nrow x ncol matrix g (by Householder QR); returns the norm of
+ /// the residual
+ static double least_squares(const std::vector<std::vector<double> >& g,
+                             const unsigned& nrow, const unsigned& ncol,
+                             std::vector<double> rhs, std::vector<double>& z)
+  {
+   std::vector<std::vector<double> > a(ncol,std::vector<double>(nrow));
+   for (unsigned j=0;j<ncol;j++)
+    {
+     for (unsigned i=0;i<nrow;i++)
+      {
+       a[j][i]=g[i][j];
+      }
+    }
+   for (unsigned j=0;j<ncol;j++)
+    {
+     // Householder reflection for column j
+     double alpha=0.0;
+     for (unsigned i=j;i<nrow;i++) alpha+=a[j][i]*a[j][i];
+     alpha=std::sqrt(alpha);
+     if (alpha==0.0) continue;
+     if (a[j][j]>0.0) alpha=-alpha;
+     a[j][j]-=alpha;
+     double vtv=0.0;
+     for (unsigned i=j;i<nrow;i++) vtv+=a[j][i]*a[j][i];
+     for (unsigned l=j+1;l<ncol;l++)
+      {
+       double s=0.0;
+       for (unsigned i=j;i<nrow;i++) s+=a[j][i]*a[l][i];
+       s*=2.0/vtv;
+       for (unsigned i=j;i<nrow;i++) a[l][i]-=s*a[j][i];
+      }
+     double s=0.0;
+     for (unsigned i=j;i<nrow;i++) s+=a[j][i]*rhs[i];
+     s*=2.0/vtv;
+     for (unsigned i=j;i<nrow;i++) rhs[i]-=s*a[j][i];
+     a[j][j]=alpha;
+    }
+   z.assign(ncol,0.0);
+   for (unsigned jj=ncol;jj>0;jj--)
+    {
+     unsigned j=jj-1;
+     if (a[j][j]==0.0) continue;
+     double sum=rhs[j];
+     for (unsigned l=j+1;l<ncol;l++) sum-=a[l][j]*z[l];
+     z[j]=sum/a[j][j];
+    }
+   double res=0.0;
+   for (unsigned i=ncol;i<nrow;i++) res+=rhs[i]*rhs[i];
+   return std::sqrt(res);
+  }
+
+ /// \short One cycle: Arnoldi process for (I - C C^T) A', starting 
+ /// from the current residual r, minimisation of the residual over the
+ /// recycled and Krylov vectors (updating r and y), and computation of
+ /// the new recycled space. Returns the norm of the new residual.
+ double cycle(const double& tol, std::vector<double>& r,
+              std::vector<double>& y)
+  {
+   unsigned n=r.size();
+   unsigned k=U.size();
+   unsigned s_max=(Krylov_dimension>k+1 ? Krylov_dimension-k : 1);
+   s_max=std::min(s_max,std::max(Max_iter-Iterations,1u));
+
+   // Scaled recycled vectors U D have unit length
+   std::vector<double> d(k);
+   for (unsigned i=0;i<k;i++)
+    {
+     d[i]=1.0/norm(U[i]);
+    }
+
+   // A' [U D, V_j] = [C, V_{j+1}] G with
+   // G = [D  B; 0  H] (H: upper Hessenberg matrix from Arnoldi)
+   std::vector<std::vector<double> > g(k+s_max+1,
+                                       std::vector<double>(k+s_max,0.0));
+   for (unsigned i=0;i<k;i++)
+    {
+     g[i][i]=d[i];
+    }
+   std::vector<std::vector<double> > v;
+   double beta=norm(r);
+   v.push_back(r);
+   for (unsigned i=0;i<n;i++) v[0][i]/=beta;
+   std::vector<double> ls_rhs(k+s_max+1,0.0);
+   ls_rhs[k]=beta;
+   std::vector<double> z;
+   double ls_residual=beta;
+   std::vector<double> w;
+   unsigned j=0;
+   while (j<s_max)
+    {
+     apply_operator(v[j],w);
+     Iterations++;
+     for (unsigned i=0;i<k;i++)
+      {
+       double b_ij=dot(C[i],w);
+       g[i][k+j]=b_ij;
+       axpy(-b_ij,C[i],w);
+      }
+     for (unsigned i=0;i<=j;i++)
+      {
+       double h_ij=dot(v[i],w);
+       g[k+i][k+j]=h_ij;
+       axpy(-h_ij,v[i],w);
+      }
+     double h=norm(w);
+     g[k+j+1][k+j]=h;
+     if (h>0.0)
+      {
+       for (unsigned i=0;i<n;i++) w[i]/=h;
+      }
+     v.push_back(w);
+     j++;
+     ls_residual=least_squares(g,k+j+1,k+j,ls_rhs,z);
+     if ((ls_residual<=tol)||(h==0.0)) break;
+    }
+
+   // Update the solution, y += [U D, V_j] z, and the residual,
+   // r -= [C, V_{j+1}] G z
+   for (unsigned i=0;i<k;i++)
+    {
+     axpy(z[i]*d[i],U[i],y);
+    }
+   for (unsigned i=0;i<j;i++)
+    {
+     axpy(z[k+i],v[i],y);
+    }
+   std::vector<double> gz(k+j+1,0.0);
+   for (unsigned i=0;i<k+j+1;i++)
+    {
+     for (unsigned l=0;l<k+j;l++)
+      {
+       gz[i]+=g[i][l]*z[l];
+      }
+    }
+   for (unsigned i=0;i<k;i++)
+    {
+     axpy(-gz[i],C[i],r);
+    }
+   for (unsigned i=0;i<=j;i++)
+    {
+     axpy(-gz[k+i],v[i],r);
+    }
+
+   // New recycled space (unless we're done with this solve anyway and
+   // the Krylov space has broken down)
+   if (g[k+j][k+j-1]>0.0)
+    {
+     new_recycle_space(g,k,j,d,v);
+    }
+
+   return norm(r);
+  }
+
+ /// \short Replace the recycled space by the harmonic Ritz vectors (for
+ /// the harmonic Ritz values of smallest magnitude) from the search
+ /// space [U D, V_j] of the cycle, i.e. the solutions of the generalised
+ /// eigenproblem G^T G p = theta G^T W^T V p, where W = [C, V_{j+1}] and
+ /// V = [U D, V_j]. They span the dominant invariant subspace of
+ /// (G^T G)^{-1} G^T W^T V (eigenvalues 1/theta), which is computed by
+ /// subspace iteration; this avoids complex arithmetic for complex
+ /// conjugate pairs.
+ void new_recycle_space(const std::vector<std::vector<double> >& g,
+                        const unsigned& k, const unsigned& j,
+                        const std::vector<double>& d,
+                        const std::vector<std::vector<double> >& v)
+  {
+   unsigned nrow=k+j+1;
+   unsigned ncol=k+j;
+   unsigned k_new=std::min(Nrecycle,ncol);
+   if (k_new==0) return;
+
+   // W^T V: C^T U D and V_{j+1}^T U D in the first k columns, [I; 0]
+   // in the others (C is orthogonal to the V_{j+1})
+   std::vector<std::vector<double> > wtv(nrow,std::vector<double>(ncol,0.0));
+   for (unsigned l=0;l<k;l++)
+    {
+     for (unsigned i=0;i<k;i++)
+      {
+       wtv[i][l]=dot(C[i],U[l])*d[l];
+      }
+     for (unsigned i=0;i<=j;i++)
+      {
+       wtv[k+i][l]=dot(v[i],U[l])*d[l];
+      }
+    }
+   for (unsigned l=0;l<j;l++)
+    {
+     wtv[k+l][k+l]=1.0;
+    }
+
+   // G^T G (factorised) and G^T W^T V
+   std::vector<double> gtg(ncol*ncol,0.0);
+   std::vector<double> gtwtv(ncol*ncol,0.0);
+   for (unsigned a=0;a<ncol;a++)
+    {
+     for (unsigned b=0;b<ncol;b++)
+      {
+       for (unsigned i=0;i<nrow;i++)
+        {
+         gtg[a*ncol+b]+=g[i][a]*g[i][b];
+         gtwtv[a*ncol+b]+=g[i][a]*wtv[i][b];
+        }
+      }
+    }
+   Multilevel_Helpers::DenseLU<double> gtg_lu;
+   gtg_lu.factorise(ncol,gtg);
+
+   // Subspace iteration with p_new = (G^T G)^{-1} G^T W^T V p (the
+   // columns of p are orthonormalised in each iteration)
+   std::vector<std::vector<double> > p(k_new,std::vector<double>(ncol));
+   for (unsigned l=0;l<k_new;l++)
+    {
+     for (unsigned a=0;a<ncol;a++)
+      {
+       p[l][a]=std::sin(double(1+a)*double(1+l)+0.5*double(l));
+      }
+    }
+   std::vector<std::vector<double> > dummy(k_new);
+   orthonormalise(p,dummy);
+   unsigned max_subspace_iter=100;
+   for (unsigned iter=0;iter<max_subspace_iter;iter++)
+    {
+     std::vector<std::vector<double> > p_new(p.size(),
+                                             std::vector<double>(ncol,0.0));
+     for (unsigned l=0;l<p.size();l++)
+      {
+       for (unsigned a=0;a<ncol;a++)
+        {
+         for (unsigned b=0;b<ncol;b++)
+          {
+           p_new[l][a]+=gtwtv[a*ncol+b]*p[l][b];
+          }
+        }
+       gtg_lu.solve(&p_new[l][0]);
+      }
+     dummy.resize(p_new.size());
+     orthonormalise(p_new,dummy);
+     if (p_new.size()==0) return;
+
+     // Converged if the new basis lies in the span of the old one
+     double change=0.0;
+     if (p_new.size()==p.size())
+      {
+       for (unsigned l=0;l<p_new.size();l++)
+        {
+         std::vector<double> res(p_new[l]);
+         for (unsigned i=0;i<p.size();i++)
+          {
+           axpy(-dot(p[i],p_new[l]),p[i],res);
+          }
+         change=std::max(change,norm(res));
+        }
+      }
+     else
+      {
+       change=1.0;
+      }
+     p.swap(p_new);
+     if (change<1.0e-6) break;
+    }
+   k_new=p.size();
+
+   // Orthonormalise G P = Q R; then the new C = W Q and U = V P R^{-1}
+   // (as n-vectors), so A' U = C
+   std::vector<std::vector<double> > gp(k_new,std::vector<double>(nrow,0.0));
+   for (unsigned l=0;l<k_new;l++)
+    {
+     for (unsigned i=0;i<nrow;i++)
+      {
+       for (unsigned a=0;a<ncol;a++)
+        {
+         gp[l][i]+=g[i][a]*p[l][a];
+        }
+      }
+    }
+   orthonormalise(gp,p);
+   k_new=gp.size();
+   unsigned n=v[0].size();
+   std::vector<std::vector<double> > c_new(k_new,std::vector<double>(n,0.0));
+   std::vector<std::vector<double> > u_new(k_new,std::vector<double>(n,0.0));
+   for (unsigned l=0;l<k_new;l++)
+    {
+     for (unsigned i=0;i<k;i++)
+      {
+       axpy(gp[l][i],C[i],c_new[l]);
+       axpy(p[l][i]*d[i],U[i],u_new[l]);
+      }
+     for (unsigned i=0;i<=j;i++)
+      {
+       axpy(gp[l][k+i],v[i],c_new[l]);
+      }
+     for (unsigned i=0;i<j;i++)
+      {
+       axpy(p[l][k+i],v[i],u_new[l]);
+      }
+    }
+   C.swap(c_new);
+   U.swap(u_new);
+  }
+
+ /// \short Max. dimension of the search space in a cycle (recycled 
+ /// and Krylov vectors)
+ unsigned Krylov_dimension;
+
+ /// Max. number of recycled vectors
+ unsigned Nrecycle;
+
+ /// Number of iterations in the last solve
+ unsigned Iterations;
+
+ /// \short Number of applications of the operator in the last solve to
+ /// adapt the recycled space to the operator
+ unsigned Nrecycle_application;
+
+ /// Number of rows in the last solve
+ unsigned Nrow;
+
+ /// The matrix in the current solve
+ DoubleMatrixBase* Matrix_pt;
+
+ /// The Jacobian (if the solver assembles it)
+ CRDoubleMatrix Jacobian;
+
+ /// Recycled vectors (A' U = C)
+ std::vector<std::vector<double> > U;
+
+ /// Images of the recycled vectors under A' (orthonormal)
+ std::vector<std::vector<double> > C;
+
+ /// Work vectors for the application of the operator
+ DoubleVector Work_in;
+ DoubleVector Work_out;
+ DoubleVector Work_product;
+
+};
+
+} // end of namespace oomph
+
+#endif
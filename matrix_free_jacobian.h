@@ -0,0 +1,196 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Matrix-free products with the Jacobian in GMRES: While the 
+// preconditioner is re-used, the Jacobian isn't assembled at all; its
+// products with vectors are computed element by element (the element
+// Jacobians are computed and applied straight away, in batches, by the
+// ThreadedAssembler). When the preconditioner has to be set up, the
+// Jacobian is assembled for the setup and freed again before the GMRES
+// iterations, so no global Jacobian is stored during the Krylov phase.
+// The products are exact (so this is still Newton's method) but each
+// one costs an evaluation of all element Jacobians rather than a
+// sparse matrix-vector product: more flops, but fewer bytes moved and
+// less memory. (The peak memory during the setup of the preconditioner
+// is that of the assembled case.)
+
+#ifndef MATRIX_FREE_JACOBIAN_HEADER
+#define MATRIX_FREE_JACOBIAN_HEADER
+
+#include <algorithm>
+
+#include "threaded_assembly.h"
+
+namespace oomph
+{
+
+//======================================================================
+/// \short Jacobian of a (serial) Problem, either assembled (then it's
+/// a normal CRDoubleMatrix) or matrix-free (then it has the right size
+/// but no entries, and multiply(...) applies the element Jacobians).
+//======================================================================
+class MatrixFreeJacobian : public CRDoubleMatrix
+{
+
+public:
+
+ /// \short Constructor: Pass the problem and the assembler used for the
+ /// element-by-element products
+ MatrixFreeJacobian(Problem* problem_pt, ThreadedAssembler* assembler_pt) :
+  Problem_pt(problem_pt), Assembler_pt(assembler_pt), Is_matrix_free(false),
+  Nproduct(0)
+  {}
+
+ /// \short Switch to the matrix-free representation for the current 
+ /// dofs. Frees the entries (if any).
+ void build_matrix_free()
+  {
+   unsigned long ndof=Problem_pt->ndof();
+   this->build(Problem_pt->dof_distribution_pt());
+   int* row_start=new int[ndof+1];
+   std::fill(row_start,row_start+ndof+1,0);
+   this->build_without_copy(ndof,0,new double[1],new int[1],row_start);
+   Is_matrix_free=true;
+  }
+
+ /// \short Call after the Jacobian has been assembled into this matrix:
+ /// products then use the entries
+ void use_assembled_entries() {Is_matrix_free=false;}
+
+ /// Is the Jacobian matrix-free?
+ bool is_matrix_free() const {return Is_matrix_free;}
+
+ /// \short Number of element-by-element products (since the last reset)
+ unsigned nproduct() const {return Nproduct;}
+
+ /// Reset the count of element-by-element products
+ void reset_nproduct() {Nproduct=0;}
+
+ /// \short Product with the Jacobian: element by element (unless the
+ /// Jacobian has been assembled)
+ void multiply(const DoubleVector& x, DoubleVector& soln) const
+  {
+   if (!Is_matrix_free)
+    {
+     CRDoubleMatrix::multiply(x,soln);
+     return;
+    }
+   Assembler_pt->multiply_by_jacobian(x,soln);
+   Nproduct++;
+  }
+
+private:
+
+ /// The problem
+ Problem* Problem_pt;
+
+ /// Assembler for the element-by-element products
+ ThreadedAssembler* Assembler_pt;
+
+ /// Is the Jacobian matrix-free?
+ bool Is_matrix_free;
+
+ /// Number of element-by-element products
+ mutable unsigned Nproduct;
+
+};
+
+
+
+//======================================================================
+/// \short GMRES with a MatrixFreeJacobian: The Jacobian is assembled
+/// only if the preconditioner is to be set up before the solve, and
+/// freed again after the setup; the GMRES iterations use 
+/// element-by-element products.
+//======================================================================
+class MatrixFreeGMRES : public GMRES<CRDoubleMatrix>
+{
+
+public:
+
+ /// \short Constructor: Pass the problem and the assembler used for
+ /// the residuals and the element-by-element products
+ MatrixFreeGMRES(Problem* problem_pt, ThreadedAssembler* assembler_pt) :
+  Jacobian(problem_pt,assembler_pt), Assembler_pt(assembler_pt)
+  {}
+
+ /// Solve the linear system in the Newton iteration of the problem
+ void solve(Problem* const& problem_pt, DoubleVector& result)
+  {
+   DoubleVector residuals;
+   Jacobian.reset_nproduct();
+   bool setup_preconditioner=this->Setup_preconditioner_before_solve;
+   if (setup_preconditioner)
+    {
+     // Assemble the Jacobian just for the setup of the preconditioner
+     problem_pt->get_jacobian(residuals,Jacobian);
+     Jacobian.use_assembled_entries();
+     double t_start=TimingHelpers::timer();
+     this->preconditioner_pt()->setup(&Jacobian);
+     this->Preconditioner_setup_time=TimingHelpers::timer()-t_start;
+    }
+   else
+    {
+     // (Straight from the assembler: The problem's get_residuals() also
+     // records the residuals for the telemetry and the GMRES forcing term,
+     // but the Newton solver has already evaluated them at these dofs)
+     Assembler_pt->get_residuals(residuals);
+    }
+
+   // Free the entries and iterate with element-by-element products
+   // (the preconditioner has been set up already)
+   Jacobian.build_matrix_free();
+   this->Setup_preconditioner_before_solve=false;
+   try
+    {
+     GMRES<CRDoubleMatrix>::solve(&Jacobian,residuals,result);
+    }
+   catch (...)
+    {
+     this->Setup_preconditioner_before_solve=setup_preconditioner;
+     throw;
+    }
+   this->Setup_preconditioner_before_solve=setup_preconditioner;
+  }
+
+ /// Other versions of solve(...) are the GMRES ones
+ using GMRES<CRDoubleMatrix>::solve;
+
+ /// The Jacobian used in the last solve
+ const MatrixFreeJacobian& jacobian() const {return Jacobian;}
+
+private:
+
+ /// The Jacobian
+ MatrixFreeJacobian Jacobian;
+
+ /// Assembler for the residuals
+ ThreadedAssembler* Assembler_pt;
+
+};
+
+} // end of namespace oomph
+
+#endif
@@ -0,0 +1,489 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Renumbering of the nodes and elements (and hence the equations,
+// which are assigned node by node) of a 2D mesh to reduce the
+// bandwidth/profile of the Jacobian and to keep neighbouring elements
+// close in memory: reverse Cuthill-McKee ordering of the nodes, or the
+// order of the elements along a Hilbert curve through their centroids.
+
+#ifndef MESH_RENUMBERING_HEADER
+#define MESH_RENUMBERING_HEADER
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+namespace oomph
+{
+
+//======================================================================
+/// Renumbering of elements, nodes and equations in a mesh
+//======================================================================
+namespace Mesh_Renumbering
+{
+
+ /// \short Statistics of the sparsity pattern of the Jacobian (as
+ /// implied by the equation numbers of the elements)
+ struct SparsityStatistics
+ {
+  /// Half-bandwidth: max. |i-j| over all nonzeros a_ij
+  unsigned long Bandwidth;
+
+  /// \short Profile (envelope): sum over all rows i of i-j_min(i),
+  /// where j_min(i) is the first column with a nonzero. This bounds the
+  /// fill of an LU factorisation without pivoting.
+  double Profile;
+
+  /// \short Average over the elements of the spread (max.-min.) of the
+  /// indices of their nodes in the mesh
+  double Mean_node_index_spread;
+ };
+
+
+ //=====================================================================
+ /// \short Compute the statistics of the sparsity pattern implied by the
+ /// current equation numbers of the elements in the mesh
+ //=====================================================================
+ inline void get_sparsity_statistics(Mesh* mesh_pt,
+                                     const unsigned long& ndof,
+                                     SparsityStatistics& statistics)
+ {
+  std::vector<unsigned long> first_column(ndof);
+  for (unsigned long i=0;i<ndof;i++)
+   {
+    first_column[i]=i;
+   }
+
+  std::map<Node*,unsigned long> node_index;
+  unsigned long nnod=mesh_pt->nnode();
+  for (unsigned long j=0;j<nnod;j++)
+   {
+    node_index[mesh_pt->node_pt(j)]=j;
+   }
+
+  double node_index_spread=0.0;
+  unsigned long nel=mesh_pt->nelement();
+  for (unsigned long e=0;e<nel;e++)
+   {
+    // All dofs in the element are coupled to each other
+    GeneralisedElement* elem_pt=mesh_pt->element_pt(e);
+    unsigned nvar=elem_pt->ndof();
+    if (nvar>0)
+     {
+      unsigned long min_eqn=elem_pt->eqn_number(0);
+      for (unsigned i=1;i<nvar;i++)
+       {
+        min_eqn=std::min(min_eqn,elem_pt->eqn_number(i));
+       }
+      for (unsigned i=0;i<nvar;i++)
+       {
+        unsigned long eqn=elem_pt->eqn_number(i);
+        first_column[eqn]=std::min(first_column[eqn],min_eqn);
+       }
+     }
+
+    FiniteElement* el_pt=dynamic_cast<FiniteElement*>(elem_pt);
+    if ((el_pt!=0)&&(el_pt->nnode()>0))
+     {
+      unsigned long min_index=node_index[el_pt->node_pt(0)];
+      unsigned long max_index=min_index;
+      unsigned nnod_el=el_pt->nnode();
+      for (unsigned l=1;l<nnod_el;l++)
+       {
+        unsigned long index=node_index[el_pt->node_pt(l)];
+        min_index=std::min(min_index,index);
+        max_index=std::max(max_index,index);
+       }
+      node_index_spread+=double(max_index-min_index);
+     }
+   }
+
+  statistics.Bandwidth=0;
+  statistics.Profile=0.0;
+  for (unsigned long i=0;i<ndof;i++)
+   {
+    statistics.Bandwidth=std::max(statistics.Bandwidth,i-first_column[i]);
+    statistics.Profile+=double(i-first_column[i]);
+   }
+  statistics.Mean_node_index_spread=
+   (nel==0 ? 0.0 : node_index_spread/double(nel));
+ }
+
+
+
+ //=====================================================================
+ /// \short Node adjacency graph: nodes are adjacent if they're in the
+ /// same element. Also returns the index of each node in the mesh.
+ //=====================================================================
+ inline void get_node_adjacency(Mesh* mesh_pt,
+                                std::map<Node*,unsigned>& node_index,
+                                std::vector<std::vector<unsigned> >&
+                                neighbour)
+ {
+  unsigned nnod=mesh_pt->nnode();
+  node_index.clear();
+  for (unsigned j=0;j<nnod;j++)
+   {
+    node_index[mesh_pt->node_pt(j)]=j;
+   }
+
+  neighbour.assign(nnod,std::vector<unsigned>());
+  unsigned nel=mesh_pt->nelement();
+  std::vector<unsigned> local_index;
+  for (unsigned e=0;e<nel;e++)
+   {
+    FiniteElement* el_pt=mesh_pt->finite_element_pt(e);
+    unsigned nnod_el=el_pt->nnode();
+    local_index.resize(nnod_el);
+    for (unsigned l=0;l<nnod_el;l++)
+     {
+      local_index[l]=node_index[el_pt->node_pt(l)];
+     }
+    for (unsigned l=0;l<nnod_el;l++)
+     {
+      for (unsigned m=0;m<nnod_el;m++)
+       {
+        if (m!=l) neighbour[local_index[l]].push_back(local_index[m]);
+       }
+     }
+   }
+  for (unsigned j=0;j<nnod;j++)
+   {
+    std::sort(neighbour[j].begin(),neighbour[j].end());
+    neighbour[j].erase(std::unique(neighbour[j].begin(),neighbour[j].end()),
+                       neighbour[j].end());
+   }
+ }
+
+
+ /// \short Breadth-first search from root over the vertices of the graph
+ /// (given by the neighbours of each vertex) that haven't been ordered
+ /// yet; neighbours are visited in order of increasing
+ /// degree. Appends the elements to order and returns the number of
+ /// levels; the last level starts at order[last_level_start] and width
+ /// is the size of the largest level.
+ inline unsigned breadth_first_search(
+  const std::vector<std::vector<unsigned> >& neighbour,
+  const unsigned& root,
+  std::vector<bool>& done,
+  std::vector<unsigned>& order,
+  unsigned& last_level_start,
+  unsigned& width)
+ {
+  unsigned start=order.size();
+  order.push_back(root);
+  done[root]=true;
+  unsigned nlevel=0;
+  unsigned level_start=start;
+  width=0;
+  while (level_start<order.size())
+   {
+    nlevel++;
+    last_level_start=level_start;
+    unsigned level_end=order.size();
+    width=std::max(width,level_end-level_start);
+    for (unsigned k=level_start;k<level_end;k++)
+     {
+      std::vector<std::pair<unsigned,unsigned> > degree_and_vertex;
+      const std::vector<unsigned>& nbr=neighbour[order[k]];
+      for (unsigned n=0;n<nbr.size();n++)
+       {
+        if (!done[nbr[n]])
+         {
+          done[nbr[n]]=true;
+          degree_and_vertex.push_back(
+           std::make_pair(neighbour[nbr[n]].size(),nbr[n]));
+         }
+       }
+      std::sort(degree_and_vertex.begin(),degree_and_vertex.end());
+      for (unsigned n=0;n<degree_and_vertex.size();n++)
+       {
+        order.push_back(degree_and_vertex[n].second);
+       }
+     }
+    level_start=level_end;
+   }
+  return nlevel;
+ }
+
+
+
+ //=====================================================================
+ /// \short Reverse Cuthill-McKee ordering of the vertices of a graph
+ /// (given by the neighbours of each vertex): order[k] is the vertex
+ /// that becomes vertex k. Each connected component starts from a
+ /// pseudo-peripheral vertex, found by repeated searches from the last
+ /// level of the previous search. As candidates we try the vertex of
+ /// smallest degree and the middle vertex of the last level; the latter
+ /// matters for rectangular meshes, where starting in the middle of the
+ /// short side (rather than in a corner) gives levels that are straight
+ /// lines across the mesh, i.e. half the width.
+ //=====================================================================
+ inline void get_rcm_order(
+  const std::vector<std::vector<unsigned> >& neighbour,
+  std::vector<unsigned>& order)
+ {
+  unsigned nvertex=neighbour.size();
+  std::vector<bool> done(nvertex,false);
+  order.clear();
+  order.reserve(nvertex);
+  for (unsigned v=0;v<nvertex;v++)
+   {
+    if (done[v]) continue;
+
+    unsigned start=order.size();
+    unsigned root=v;
+    unsigned last_level_start=start;
+    unsigned width=0;
+    unsigned nlevel=breadth_first_search(neighbour,root,done,order,
+                                         last_level_start,width);
+    while (true)
+     {
+      // Candidates from the last level
+      unsigned candidate[2];
+      candidate[0]=order[last_level_start];
+      for (unsigned k=last_level_start;k<order.size();k++)
+       {
+        if (neighbour[order[k]].size()<neighbour[candidate[0]].size())
+         {
+          candidate[0]=order[k];
+         }
+       }
+      candidate[1]=order[(last_level_start+order.size())/2];
+
+      // Keep the one with most levels (and smallest width)
+      bool improved=false;
+      unsigned best_root=root;
+      unsigned best_nlevel=nlevel;
+      unsigned best_width=width;
+      for (unsigned c=0;c<2;c++)
+       {
+        for (unsigned k=start;k<order.size();k++)
+         {
+          done[order[k]]=false;
+         }
+        order.resize(start);
+        unsigned trial_last_level_start=start;
+        unsigned trial_width=0;
+        unsigned trial_nlevel=
+         breadth_first_search(neighbour,candidate[c],done,order,
+                              trial_last_level_start,trial_width);
+        if ((trial_nlevel>best_nlevel)||
+            ((trial_nlevel==best_nlevel)&&(trial_width<best_width)))
+         {
+          improved=true;
+          best_root=candidate[c];
+          best_nlevel=trial_nlevel;
+          best_width=trial_width;
+         }
+       }
+
+      // Redo the search from the best root (to get its last level or,
+      // if there was no improvement, the final ordering)
+      for (unsigned k=start;k<order.size();k++)
+       {
+        done[order[k]]=false;
+       }
+      order.resize(start);
+      root=best_root;
+      nlevel=breadth_first_search(neighbour,root,done,order,
+                                  last_level_start,width);
+      if (!improved) break;
+     }
+   }
+  std::reverse(order.begin(),order.end());
+ }
+
+
+
+ //=====================================================================
+ /// \short Position along the Hilbert curve through a 2^m x 2^m grid
+ /// (n=2^m) of the point (ix,iy)
+ //=====================================================================
+ inline unsigned long hilbert_index(const unsigned long& n,
+                                    unsigned long ix, unsigned long iy)
+ {
+  unsigned long d=0;
+  for (unsigned long s=n/2;s>0;s/=2)
+   {
+    unsigned long rx=((ix&s)>0);
+    unsigned long ry=((iy&s)>0);
+    d+=s*s*((3*rx)^ry);
+
+    // Rotate the quadrant
+    if (ry==0)
+     {
+      if (rx==1)
+       {
+        ix=s-1-ix;
+        iy=s-1-iy;
+       }
+      std::swap(ix,iy);
+     }
+   }
+  return d;
+ }
+
+
+
+ //=====================================================================
+ /// \short Order of the elements along a Hilbert curve through their
+ /// centroids (scaled to the bounding box of the centroids)
+ //=====================================================================
+ inline void get_hilbert_element_order(Mesh* mesh_pt,
+                                       std::vector<unsigned>& order)
+ {
+  unsigned nel=mesh_pt->nelement();
+  std::vector<double> x_c(nel,0.0), y_c(nel,0.0);
+  for (unsigned e=0;e<nel;e++)
+   {
+    FiniteElement* el_pt=mesh_pt->finite_element_pt(e);
+    unsigned nnod_el=el_pt->nnode();
+    for (unsigned l=0;l<nnod_el;l++)
+     {
+      x_c[e]+=el_pt->node_pt(l)->x(0)/double(nnod_el);
+      y_c[e]+=el_pt->node_pt(l)->x(1)/double(nnod_el);
+     }
+   }
+  order.clear();
+  if (nel==0) return;
+  double x_min=*std::min_element(x_c.begin(),x_c.end());
+  double x_max=*std::max_element(x_c.begin(),x_c.end());
+  double y_min=*std::min_element(y_c.begin(),y_c.end());
+  double y_max=*std::max_element(y_c.begin(),y_c.end());
+
+  // Resolution of the curve
+  unsigned long n=65536;
+  std::vector<std::pair<unsigned long,unsigned> > index_and_element(nel);
+  for (unsigned e=0;e<nel;e++)
+   {
+    unsigned long ix=0;
+    unsigned long iy=0;
+    if (x_max>x_min)
+     {
+      ix=std::min(n-1,(unsigned long)(double(n)*(x_c[e]-x_min)/
+                                      (x_max-x_min)));
+     }
+    if (y_max>y_min)
+     {
+      iy=std::min(n-1,(unsigned long)(double(n)*(y_c[e]-y_min)/
+                                      (y_max-y_min)));
+     }
+    index_and_element[e]=std::make_pair(hilbert_index(n,ix,iy),e);
+   }
+  std::sort(index_and_element.begin(),index_and_element.end());
+  order.resize(nel);
+  for (unsigned e=0;e<nel;e++)
+   {
+    order[e]=index_and_element[e].second;
+   }
+ }
+
+
+
+ //=====================================================================
+ /// \short Renumber the nodes and elements of the mesh:
+ /// - "rcm": Reverse Cuthill-McKee ordering of the nodes; the elements
+ ///   are then sorted by the first of their nodes.
+ /// - "hilbert": Elements in the order along a Hilbert curve through
+ ///   their centroids; the nodes are then numbered in the order in which
+ ///   they're encountered in the elements.
+ /// The equation numbers have to be re-assigned afterwards.
+ //=====================================================================
+ inline void renumber(Mesh* mesh_pt, const std::string& method)
+ {
+  unsigned nel=mesh_pt->nelement();
+  Vector<GeneralisedElement*> old_element_pt(mesh_pt->element_pt());
+  if (method=="rcm")
+   {
+    std::map<Node*,unsigned> node_index;
+    std::vector<std::vector<unsigned> > neighbour;
+    get_node_adjacency(mesh_pt,node_index,neighbour);
+    std::vector<unsigned> order;
+    get_rcm_order(neighbour,order);
+    unsigned nnod=order.size();
+    Vector<Node*> old_node_pt(nnod);
+    for (unsigned j=0;j<nnod;j++)
+     {
+      old_node_pt[j]=mesh_pt->node_pt(j);
+     }
+    std::vector<unsigned> new_index(nnod);
+    for (unsigned j=0;j<nnod;j++)
+     {
+      mesh_pt->node_pt(j)=old_node_pt[order[j]];
+      new_index[order[j]]=j;
+     }
+
+    // Sort elements by their first node (ties by their old number)
+    std::vector<std::pair<unsigned,unsigned> > first_node_and_element(nel);
+    for (unsigned e=0;e<nel;e++)
+     {
+      FiniteElement* el_pt=mesh_pt->finite_element_pt(e);
+      unsigned first_node=nnod;
+      unsigned nnod_el=el_pt->nnode();
+      for (unsigned l=0;l<nnod_el;l++)
+       {
+        first_node=std::min(first_node,
+                            new_index[node_index[el_pt->node_pt(l)]]);
+       }
+      first_node_and_element[e]=std::make_pair(first_node,e);
+     }
+    std::sort(first_node_and_element.begin(),first_node_and_element.end());
+    for (unsigned e=0;e<nel;e++)
+     {
+      mesh_pt->element_pt(e)=old_element_pt[first_node_and_element[e].second];
+     }
+   }
+  else if (method=="hilbert")
+   {
+    std::vector<unsigned> order;
+    get_hilbert_element_order(mesh_pt,order);
+    for (unsigned e=0;e<nel;e++)
+     {
+      mesh_pt->element_pt(e)=old_element_pt[order[e]];
+     }
+
+    // Nodes in the order in which they're encountered in the elements
+    mesh_pt->reorder_nodes();
+   }
+  else
+   {
+    std::ostringstream error_stream;
+    error_stream << "Unknown renumbering method: " << method
+                 << "\nUse rcm or hilbert." << std::endl;
+    throw OomphLibError(error_stream.str(),
+                        OOMPH_CURRENT_FUNCTION,
+                        OOMPH_EXCEPTION_LOCATION);
+   }
+ }
+
+} // end of namespace Mesh_Renumbering
+
+} // end of namespace oomph
+
+#endif
@@ -0,0 +1,641 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Basic sparse and dense linear algebra for the multilevel
+// preconditioners: compressed row storage matrices, (sparse)
+// matrix-matrix products for Galerkin coarse-grid operators, ILU(0)
+// smoothers, and dense LU factorisations for small blocks and the
+// coarsest level. Everything is templated by the scalar type so the
+// hierarchies can be stored in single or double precision.
+
+#ifndef MULTILEVEL_HELPERS_HEADER
+#define MULTILEVEL_HELPERS_HEADER
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace oomph
+{
+
+//======================================================================
+/// Basic linear algebra for multilevel preconditioners
+//======================================================================
+namespace Multilevel_Helpers
+{
+
+ //=====================================================================
+ /// \short Serial sparse matrix in compressed row storage (same
+ /// layout as oomph-lib's CRDoubleMatrix, but templated by the scalar
+ /// type and with directly accessible storage)
+ //=====================================================================
+ template<class T>
+ class CSRMatrix
+ {
+ public:
+
+  /// Empty constructor
+  CSRMatrix() : Nrow(0), Ncol(0), Row_start(1,0) {}
+
+  /// Number of rows
+  unsigned nrow() const {return Nrow;}
+
+  /// Number of columns
+  unsigned ncol() const {return Ncol;}
+
+  /// Number of nonzeros
+  unsigned nnz() const {return Column_index.size();}
+
+  /// Resize (no nonzeros)
+  void resize(const unsigned& nrow, const unsigned& ncol)
+   {
+    Nrow=nrow;
+    Ncol=ncol;
+    Row_start.assign(nrow+1,0);
+    Column_index.clear();
+    Value.clear();
+   }
+
+  /// y = A x
+  template<class S>
+  void multiply(const S* x, S* y) const
+   {
+    for (unsigned i=0;i<Nrow;i++)
+     {
+      S sum=0;
+      for (int k=Row_start[i];k<Row_start[i+1];k++)
+       {
+        sum+=S(Value[k])*x[Column_index[k]];
+       }
+      y[i]=sum;
+     }
+   }
+
+  /// r = b - A x
+  template<class S>
+  void residual(const S* b, const S* x, S* r) const
+   {
+    for (unsigned i=0;i<Nrow;i++)
+     {
+      S sum=b[i];
+      for (int k=Row_start[i];k<Row_start[i+1];k++)
+       {
+        sum-=S(Value[k])*x[Column_index[k]];
+       }
+      r[i]=sum;
+     }
+   }
+
+  /// y = A^T x
+  template<class S>
+  void multiply_transpose(const S* x, S* y) const
+   {
+    std::fill(y,y+Ncol,S(0));
+    for (unsigned i=0;i<Nrow;i++)
+     {
+      S x_i=x[i];
+      for (int k=Row_start[i];k<Row_start[i+1];k++)
+       {
+        y[Column_index[k]]+=S(Value[k])*x_i;
+       }
+     }
+   }
+
+  /// Diagonal entries (zero if not stored)
+  void get_diagonal(std::vector<T>& diag) const
+   {
+    diag.assign(Nrow,T(0));
+    for (unsigned i=0;i<Nrow;i++)
+     {
+      for (int k=Row_start[i];k<Row_start[i+1];k++)
+       {
+        if (unsigned(Column_index[k])==i)
+         {
+          diag[i]+=Value[k];
+         }
+       }
+     }
+   }
+
+  /// \short Sort the column indices in each row (and add up duplicate
+  /// entries)
+  void sort_rows()
+   {
+    std::vector<std::pair<int,T> > row;
+    unsigned count=0;
+    unsigned old_start=0;
+    for (unsigned i=0;i<Nrow;i++)
+     {
+      unsigned old_end=Row_start[i+1];
+      row.clear();
+      for (unsigned k=old_start;k<old_end;k++)
+       {
+        row.push_back(std::make_pair(Column_index[k],Value[k]));
+       }
+      std::sort(row.begin(),row.end(),compare_column);
+      Row_start[i]=count;
+      for (unsigned k=0;k<row.size();k++)
+       {
+        if ((k>0)&&(row[k].first==row[k-1].first))
+         {
+          Value[count-1]+=row[k].second;
+         }
+        else
+         {
+          Column_index[count]=row[k].first;
+          Value[count]=row[k].second;
+          count++;
+         }
+       }
+      old_start=old_end;
+     }
+    Row_start[Nrow]=count;
+    Column_index.resize(count);
+    Value.resize(count);
+   }
+
+  /// Copy with conversion of the scalar type
+  template<class S>
+  void copy(const CSRMatrix<S>& matrix)
+   {
+    Nrow=matrix.Nrow;
+    Ncol=matrix.Ncol;
+    Row_start=matrix.Row_start;
+    Column_index=matrix.Column_index;
+    Value.resize(matrix.Value.size());
+    for (unsigned k=0;k<Value.size();k++)
+     {
+      Value[k]=T(matrix.Value[k]);
+     }
+   }
+
+  /// Number of rows
+  unsigned Nrow;
+
+  /// Number of columns
+  unsigned Ncol;
+
+  /// Start of each row in Column_index and Value (Nrow+1 entries)
+  std::vector<int> Row_start;
+
+  /// Column indices of the nonzeros
+  std::vector<int> Column_index;
+
+  /// Values of the nonzeros
+  std::vector<T> Value;
+
+ private:
+
+  /// Comparison of column indices for sorting
+  static bool compare_column(const std::pair<int,T>& a,
+                             const std::pair<int,T>& b)
+   {
+    return a.first<b.first;
+   }
+
+ };
+
+
+
+ //=====================================================================
+ /// Transpose: at = a^T
+ //=====================================================================
+ template<class T>
+ void transpose(const CSRMatrix<T>& a, CSRMatrix<T>& at)
+ {
+  unsigned nrow=a.nrow();
+  unsigned ncol=a.ncol();
+  at.resize(ncol,nrow);
+  unsigned nnz=a.nnz();
+  at.Column_index.resize(nnz);
+  at.Value.resize(nnz);
+
+  // Count entries per column
+  for (unsigned k=0;k<nnz;k++)
+   {
+    at.Row_start[a.Column_index[k]+1]++;
+   }
+  for (unsigned j=0;j<ncol;j++)
+   {
+    at.Row_start[j+1]+=at.Row_start[j];
+   }
+
+  // Scatter (rows of at end up sorted)
+  std::vector<int> next(at.Row_start.begin(),at.Row_start.end()-1);
+  for (unsigned i=0;i<nrow;i++)
+   {
+    for (int k=a.Row_start[i];k<a.Row_start[i+1];k++)
+     {
+      int pos=next[a.Column_index[k]]++;
+      at.Column_index[pos]=i;
+      at.Value[pos]=a.Value[k];
+     }
+   }
+ }
+
+
+
+ //=====================================================================
+ /// \short Sparse matrix-matrix product c = a b (Gustavson's algorithm;
+ /// the rows of c are sorted)
+ //=====================================================================
+ template<class T>
+ void multiply(const CSRMatrix<T>& a, const CSRMatrix<T>& b,
+               CSRMatrix<T>& c)
+ {
+  unsigned nrow=a.nrow();
+  unsigned ncol=b.ncol();
+  c.resize(nrow,ncol);
+
+  // Position of column j in current row of c (-1 if not present)
+  std::vector<int> marker(ncol,-1);
+  std::vector<T> row_value;
+  std::vector<int> row_column;
+  for (unsigned i=0;i<nrow;i++)
+   {
+    row_column.clear();
+    row_value.clear();
+    for (int ka=a.Row_start[i];ka<a.Row_start[i+1];ka++)
+     {
+      int k=a.Column_index[ka];
+      T a_ik=a.Value[ka];
+      for (int kb=b.Row_start[k];kb<b.Row_start[k+1];kb++)
+       {
+        int j=b.Column_index[kb];
+        if (marker[j]<0)
+         {
+          marker[j]=row_column.size();
+          row_column.push_back(j);
+          row_value.push_back(a_ik*b.Value[kb]);
+         }
+        else
+         {
+          row_value[marker[j]]+=a_ik*b.Value[kb];
+         }
+       }
+     }
+
+    // Sort the row and append it
+    std::vector<int> order(row_column.begin(),row_column.end());
+    std::sort(order.begin(),order.end());
+    for (unsigned l=0;l<order.size();l++)
+     {
+      c.Column_index.push_back(order[l]);
+      c.Value.push_back(row_value[marker[order[l]]]);
+     }
+    for (unsigned l=0;l<row_column.size();l++)
+     {
+      marker[row_column[l]]=-1;
+     }
+    c.Row_start[i+1]=c.Column_index.size();
+   }
+ }
+
+
+
+ //=====================================================================
+ /// \short Galerkin coarse-grid operator a_coarse = p^T a p; also
+ /// returns the restriction r = p^T
+ //=====================================================================
+ template<class T>
+ void galerkin_product(const CSRMatrix<T>& a, const CSRMatrix<T>& p,
+                       CSRMatrix<T>& r, CSRMatrix<T>& a_coarse)
+ {
+  transpose(p,r);
+  CSRMatrix<T> ap;
+  multiply(a,p,ap);
+  multiply(r,ap,a_coarse);
+ }
+
+
+
+ //=====================================================================
+ /// \short Dense LU factorisation with partial pivoting of a (small)
+ /// n x n matrix, stored row by row. Zero pivots (e.g. for the
+ /// singular pressure Poisson operators of pure Neumann problems) are
+ /// replaced by a small multiple of the largest entry so the
+ /// factorisation acts as a pseudo-inverse on the range.
+ //=====================================================================
+ template<class T>
+ class DenseLU
+ {
+ public:
+
+  /// Empty constructor
+  DenseLU() : N(0) {}
+
+  /// Size of the matrix
+  unsigned n() const {return N;}
+
+  /// Factorise the n x n matrix (row by row)
+  void factorise(const unsigned& n, const std::vector<T>& matrix)
+   {
+    N=n;
+    LU=matrix;
+    Pivot.resize(n);
+    factorise_in_place(N,&LU[0],&Pivot[0]);
+   }
+
+  /// Solve in place
+  template<class S>
+  void solve(S* x) const
+   {
+    solve_in_place(N,&LU[0],&Pivot[0],x);
+   }
+
+  /// \short Factorise the n x n matrix (row by row) in place;
+  /// the row permutation is returned in pivot
+  static void factorise_in_place(const unsigned& n, T* lu, int* pivot)
+   {
+    T max_entry=0;
+    for (unsigned k=0;k<n*n;k++)
+     {
+      max_entry=std::max(max_entry,T(std::fabs(lu[k])));
+     }
+    T tiny=(max_entry>0 ? max_entry : T(1))*
+     T(100)*std::numeric_limits<T>::epsilon();
+    for (unsigned k=0;k<n;k++)
+     {
+      // Find pivot
+      unsigned p=k;
+      for (unsigned i=k+1;i<n;i++)
+       {
+        if (std::fabs(lu[i*n+k])>std::fabs(lu[p*n+k])) p=i;
+       }
+      pivot[k]=p;
+      if (p!=k)
+       {
+        for (unsigned j=0;j<n;j++)
+         {
+          std::swap(lu[k*n+j],lu[p*n+j]);
+         }
+       }
+      if (std::fabs(lu[k*n+k])<tiny)
+       {
+        lu[k*n+k]=(lu[k*n+k]<0 ? -tiny : tiny);
+       }
+
+      // Eliminate
+      T inv_pivot=T(1)/lu[k*n+k];
+      for (unsigned i=k+1;i<n;i++)
+       {
+        T factor=(lu[i*n+k]*=inv_pivot);
+        if (factor!=T(0))
+         {
+          for (unsigned j=k+1;j<n;j++)
+           {
+            lu[i*n+j]-=factor*lu[k*n+j];
+           }
+         }
+       }
+     }
+   }
+
+  /// \short Solve in place with LU factors from factorise_in_place(...)
+  template<class S>
+  static void solve_in_place(const unsigned& n, const T* lu,
+                             const int* pivot, S* x)
+   {
+    for (unsigned k=0;k<n;k++)
+     {
+      if (unsigned(pivot[k])!=k) std::swap(x[k],x[pivot[k]]);
+     }
+    for (unsigned i=1;i<n;i++)
+     {
+      S sum=x[i];
+      for (unsigned j=0;j<i;j++)
+       {
+        sum-=S(lu[i*n+j])*x[j];
+       }
+      x[i]=sum;
+     }
+    for (unsigned ii=n;ii>0;ii--)
+     {
+      unsigned i=ii-1;
+      S sum=x[i];
+      for (unsigned j=i+1;j<n;j++)
+       {
+        sum-=S(lu[i*n+j])*x[j];
+       }
+      x[i]=sum/S(lu[i*n+i]);
+     }
+   }
+
+ private:
+
+  /// Size of matrix
+  unsigned N;
+
+  /// LU factors (row by row)
+  std::vector<T> LU;
+
+  /// Row permutation
+  std::vector<int> Pivot;
+
+ };
+
+
+
+ //=====================================================================
+ /// \short Dense LU factorisation of the coarsest-level matrix
+ //=====================================================================
+ template<class T>
+ void factorise_dense(const CSRMatrix<T>& a, DenseLU<T>& lu)
+ {
+  unsigned n=a.nrow();
+  std::vector<T> dense(n*n,T(0));
+  for (unsigned i=0;i<n;i++)
+   {
+    for (int k=a.Row_start[i];k<a.Row_start[i+1];k++)
+     {
+      dense[i*n+a.Column_index[k]]+=a.Value[k];
+     }
+   }
+  lu.factorise(n,dense);
+ }
+
+
+
+ //=====================================================================
+ /// \short Incomplete LU factorisation without fill-in, ILU(0), of a
+ /// CSRMatrix with sorted rows; the factors are stored in the sparsity
+ /// pattern of the matrix (unit lower triangle implied).
+ //=====================================================================
+ template<class T>
+ class ILU0
+ {
+ public:
+
+  /// Factorise (copies the matrix, converting the scalar type)
+  template<class S>
+  void factorise(const CSRMatrix<S>& a)
+   {
+    LU.copy(a);
+    unsigned n=LU.nrow();
+    Diagonal_index.assign(n,-1);
+
+    // Position of column j in current row (-1 if not present)
+    std::vector<int> position(n,-1);
+    for (unsigned i=0;i<n;i++)
+     {
+      int row_start=LU.Row_start[i];
+      int row_end=LU.Row_start[i+1];
+      for (int k=row_start;k<row_end;k++)
+       {
+        position[LU.Column_index[k]]=k;
+       }
+      for (int k=row_start;k<row_end;k++)
+       {
+        unsigned m=LU.Column_index[k];
+        if (m>=i) break;
+        T l_im=(LU.Value[k]/=LU.Value[Diagonal_index[m]]);
+        for (int kk=Diagonal_index[m]+1;kk<LU.Row_start[m+1];kk++)
+         {
+          int pos=position[LU.Column_index[kk]];
+          if (pos>=0)
+           {
+            LU.Value[pos]-=l_im*LU.Value[kk];
+           }
+         }
+       }
+      for (int k=row_start;k<row_end;k++)
+       {
+        if (unsigned(LU.Column_index[k])==i)
+         {
+          Diagonal_index[i]=k;
+         }
+        position[LU.Column_index[k]]=-1;
+       }
+
+      // Zero (or missing) pivots are replaced by one
+      if (Diagonal_index[i]<0)
+       {
+        throw_missing_diagonal(i);
+       }
+      if (LU.Value[Diagonal_index[i]]==T(0))
+       {
+        LU.Value[Diagonal_index[i]]=T(1);
+       }
+     }
+   }
+
+  /// Solve L U x = b in place
+  template<class S>
+  void solve(S* x) const
+   {
+    unsigned n=LU.nrow();
+    for (unsigned i=0;i<n;i++)
+     {
+      S sum=x[i];
+      for (int k=LU.Row_start[i];k<Diagonal_index[i];k++)
+       {
+        sum-=S(LU.Value[k])*x[LU.Column_index[k]];
+       }
+      x[i]=sum;
+     }
+    for (unsigned ii=n;ii>0;ii--)
+     {
+      unsigned i=ii-1;
+      S sum=x[i];
+      for (int k=Diagonal_index[i]+1;k<LU.Row_start[i+1];k++)
+       {
+        sum-=S(LU.Value[k])*x[LU.Column_index[k]];
+       }
+      x[i]=sum/S(LU.Value[Diagonal_index[i]]);
+     }
+   }
+
+ private:
+
+  /// Error: ILU(0) needs all diagonal entries to be stored
+  static void throw_missing_diagonal(const unsigned& i)
+   {
+    std::ostringstream error_stream;
+    error_stream << "ILU(0) needs all diagonal entries; row " << i 
+                 << " doesn't have one." << std::endl;
+    throw OomphLibError(error_stream.str(),
+                        OOMPH_CURRENT_FUNCTION,
+                        OOMPH_EXCEPTION_LOCATION);
+   }
+
+  /// Factors
+  CSRMatrix<T> LU;
+
+  /// Position of the diagonal entry in each row
+  std::vector<int> Diagonal_index;
+
+ };
+
+
+
+ //=====================================================================
+ /// \short Largest eigenvalue (in modulus) of D^{-1} A, estimated by
+ /// a few power iterations with a deterministic start vector
+ //=====================================================================
+ template<class T>
+ double spectral_radius_of_jacobi_matrix(const CSRMatrix<T>& a,
+                                         const std::vector<T>& diag,
+                                         const unsigned& niter=15)
+ {
+  unsigned n=a.nrow();
+  if (n==0) return 0.0;
+  std::vector<double> x(n), y(n);
+  for (unsigned i=0;i<n;i++)
+   {
+    x[i]=1.0+0.5*std::sin(double(i));
+   }
+  double lambda=0.0;
+  for (unsigned iter=0;iter<niter;iter++)
+   {
+    a.multiply(&x[0],&y[0]);
+    double norm=0.0;
+    for (unsigned i=0;i<n;i++)
+     {
+      y[i]/=double(diag[i]);
+      norm+=y[i]*y[i];
+     }
+    norm=std::sqrt(norm);
+    if (norm==0.0) return 0.0;
+    double x_norm=0.0;
+    for (unsigned i=0;i<n;i++)
+     {
+      x_norm+=x[i]*x[i];
+     }
+    lambda=norm/std::sqrt(x_norm);
+    for (unsigned i=0;i<n;i++)
+     {
+      x[i]=y[i]/norm;
+     }
+   }
+  return lambda;
+ }
+
+} // end of namespace Multilevel_Helpers
+
+} // end of namespace oomph
+
+#endif
@@ -0,0 +1,513 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Parareal: parallel-in-time integration of a time interval split into
+// slices. A cheap coarse propagator G (e.g. larger timesteps) is run
+// serially across the slices; the expensive fine propagator F is run
+// on all slices simultaneously, in separate (forked) processes. The
+// iteration
+//
+//     U_{n+1}^{k+1} = G(U_n^{k+1}) + F(U_n^k) - G(U_n^k)
+//
+// reproduces the serial fine solution exactly on the first k slices
+// after k iterations and typically converges much sooner.
+//
+// The problem class has to provide
+//
+//  - void get_state_with_history(std::vector<double>& state,
+//                                const double& dt_history):
+//    the state of the problem, including all its history values,
+//    expressed for previous timesteps dt_history (the state has to be
+//    propagated by either propagator, and setting it and propagating
+//    it with timesteps dt_history has to be the same as carrying on
+//    with the timestepping);
+//  - void set_state_with_history(const std::vector<double>& state,
+//                                const double& time,
+//                                const double& dt_history);
+//  - void parareal_propagate(const unsigned& nstep, const double& dt,
+//                            const bool& impulsive_start):
+//    take nstep timesteps of size dt from the current state (after
+//    resetting the history values if impulsive_start is true).
+//
+// The worker processes are forked from the running program, so they
+// mustn't need anything that doesn't survive fork(): MPI (hence the
+// fine propagations are always done serially in MPI builds, which
+// includes all builds with MUMPS) and OpenMP (libgomp's thread pool
+// is not fork-safe, so the caller has to set nproc() to 1 if the
+// problem's assembly uses more than one thread).
+
+#ifndef PARAREAL_HEADER
+#define PARAREAL_HEADER
+
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+// POSIX headers for the worker processes
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+namespace oomph
+{
+
+//======================================================================
+/// \short Parareal driver for the problem class PROBLEM (see above for
+/// the member functions it has to provide). The fine propagations are
+/// run in up to nproc() forked processes which return their final
+/// states through binary files in the work directory.
+//======================================================================
+template<class PROBLEM>
+class PararealDriver
+{
+
+public:
+
+ /// Constructor: Pass the problem
+ PararealDriver(PROBLEM* problem_pt) : Problem_pt(problem_pt),
+                                       Nproc(1),
+                                       Max_iter(5),
+                                       Tolerance(1.0e-6),
+                                       Compute_reference(false),
+                                       Work_directory("."),
+                                       Convergence_file("")
+  {}
+
+ /// Max. number of processes for the fine propagations
+ unsigned& nproc() {return Nproc;}
+
+ /// Max. number of Parareal iterations
+ unsigned& max_iter() {return Max_iter;}
+
+ /// \short Tolerance for the (relative) max. change of the slice end
+ /// states in an iteration
+ double& tolerance() {return Tolerance;}
+
+ /// \short Compute the serial fine solution (by plain timestepping of
+ /// the problem from its current state) first and doc the error of the
+ /// iterates relative to it?
+ bool& compute_reference() {return Compute_reference;}
+
+ /// Directory for the files through which the processes communicate
+ std::string& work_directory() {return Work_directory;}
+
+ /// \short File to which the convergence history is written (none if
+ /// empty)
+ std::string& convergence_file() {return Convergence_file;}
+
+ /// \short Solve over nstep fine timesteps of size dt_fine, starting
+ /// from the problem's current state, split into nslice time slices.
+ /// The coarse propagator takes steps of (about) dt_coarse. Returns the
+ /// number of iterations; the states at the ends of the slices are
+ /// available from slice_end_state(...) afterwards.
+ unsigned solve(const unsigned& nstep, const unsigned& nslice,
+                const double& dt_fine, const double& dt_coarse)
+  {
+#ifdef OOMPH_HAS_MPI
+   // No forking after MPI has been initialised
+   if (Nproc>1)
+    {
+     oomph_info << "Warning: Parareal can't fork worker processes in MPI "
+                << "builds;\nthe fine propagations are done serially." 
+                << std::endl;
+     Nproc=1;
+    }
+#endif
+
+   // Time slices: integer numbers of fine steps each
+   Nslice=std::max(1u,std::min(nslice,nstep));
+   Dt_fine=dt_fine;
+   Slice_start_step.resize(Nslice+1);
+   Ncoarse_step.resize(Nslice);
+   Slice_start_time.resize(Nslice+1);
+   double t0=Problem_pt->time_pt()->time();
+   for (unsigned n=0;n<=Nslice;n++)
+    {
+     Slice_start_step[n]=(nstep*n)/Nslice;
+     Slice_start_time[n]=t0+double(Slice_start_step[n])*dt_fine;
+    }
+   for (unsigned n=0;n<Nslice;n++)
+    {
+     double length=double(Slice_start_step[n+1]-Slice_start_step[n])*
+      dt_fine;
+     Ncoarse_step[n]=
+      std::max(1u,unsigned(std::floor(length/dt_coarse+0.5)));
+    }
+
+   // Initial state
+   State.resize(Nslice+1);
+   Problem_pt->get_state_with_history(State[0],Dt_fine);
+
+   std::ofstream convergence_stream;
+   if (Convergence_file!="")
+    {
+     convergence_stream.open(Convergence_file.c_str());
+     convergence_stream << "# iteration, time, max. relative change, "
+                        << "max. relative error" << std::endl;
+    }
+   double t_start=TimingHelpers::timer();
+
+   // Serial fine reference solution: Uninterrupted timestepping (the
+   // state isn't reset at the start of each slice), then go back to
+   // the initial state
+   std::vector<std::vector<double> > reference;
+   if (Compute_reference)
+    {
+     double t_ref=TimingHelpers::timer();
+     reference.resize(Nslice+1);
+     reference[0]=State[0];
+     bool impulsive_start=false;
+     for (unsigned n=0;n<Nslice;n++)
+      {
+       Problem_pt->parareal_propagate(
+        Slice_start_step[n+1]-Slice_start_step[n],Dt_fine,impulsive_start);
+       Problem_pt->get_state_with_history(reference[n+1],Dt_fine);
+      }
+     Problem_pt->set_state_with_history(State[0],Slice_start_time[0],
+                                        Dt_fine);
+     oomph_info << "Parareal: time for serial reference solution: "
+                << TimingHelpers::timer()-t_ref << " sec" << std::endl;
+     t_start=TimingHelpers::timer();
+    }
+
+   // Initial coarse sweep
+   std::vector<std::vector<double> > coarse(Nslice);
+   for (unsigned n=0;n<Nslice;n++)
+    {
+     coarse_propagate(n,State[n],coarse[n]);
+     State[n+1]=coarse[n];
+    }
+   doc_iteration(0,0.0,reference,TimingHelpers::timer()-t_start,
+                 convergence_stream);
+
+   // Parareal iterations (the first k slices are exact after k
+   // iterations, so there's no point in doing more than Nslice)
+   unsigned k=0;
+   std::vector<std::vector<double> > fine(Nslice);
+   while (k<std::min(Max_iter,Nslice))
+    {
+     k++;
+
+     // Fine propagation on the slices that aren't exact yet
+     fine_propagate_in_parallel(k-1,fine);
+
+     // Serial correction sweep
+     double max_change=0.0;
+     for (unsigned n=k-1;n<Nslice;n++)
+      {
+       std::vector<double> new_coarse;
+       if (n==k-1)
+        {
+         new_coarse=coarse[n];
+        }
+       else
+        {
+         coarse_propagate(n,State[n],new_coarse);
+        }
+       unsigned nvalue=new_coarse.size();
+       std::vector<double>& state=State[n+1];
+       for (unsigned i=0;i<nvalue;i++)
+        {
+         double new_value=new_coarse[i]+fine[n][i]-coarse[n][i];
+         max_change=std::max(max_change,std::fabs(new_value-state[i]));
+         state[i]=new_value;
+        }
+       coarse[n].swap(new_coarse);
+      }
+     max_change/=max_abs_value();
+
+     doc_iteration(k,max_change,reference,TimingHelpers::timer()-t_start,
+                   convergence_stream);
+     if (max_change<Tolerance) break;
+    }
+
+   // Leave the problem in the final state
+   Problem_pt->set_state_with_history(State[Nslice],
+                                      Slice_start_time[Nslice],Dt_fine);
+   return k;
+  }
+
+ /// Number of time slices
+ unsigned nslice() const {return Nslice;}
+
+ /// State at the end of time slice n
+ const std::vector<double>& slice_end_state(const unsigned& n) const
+  {
+   return State[n+1];
+  }
+
+ /// Time at the end of time slice n
+ double slice_end_time(const unsigned& n) const
+  {
+   return Slice_start_time[n+1];
+  }
+
+ /// Number of fine timesteps up to the end of time slice n
+ unsigned slice_end_step(const unsigned& n) const
+  {
+   return Slice_start_step[n+1];
+  }
+
+private:
+
+ /// Coarse propagation of state over slice n
+ void coarse_propagate(const unsigned& n,
+                       const std::vector<double>& state,
+                       std::vector<double>& end_state)
+  {
+   double length=Slice_start_time[n+1]-Slice_start_time[n];
+   double dt_coarse=length/double(Ncoarse_step[n]);
+   bool impulsive_start=true;
+   Problem_pt->set_state_with_history(state,Slice_start_time[n],Dt_fine);
+   Problem_pt->parareal_propagate(Ncoarse_step[n],dt_coarse,
+                                  impulsive_start);
+   Problem_pt->get_state_with_history(end_state,Dt_fine);
+  }
+
+ /// Fine propagation of state over slice n
+ void fine_propagate(const unsigned& n,
+                     const std::vector<double>& state,
+                     std::vector<double>& end_state)
+  {
+   bool impulsive_start=false;
+   Problem_pt->set_state_with_history(state,Slice_start_time[n],Dt_fine);
+   Problem_pt->parareal_propagate(Slice_start_step[n+1]-Slice_start_step[n],
+                                  Dt_fine,impulsive_start);
+   Problem_pt->get_state_with_history(end_state,Dt_fine);
+  }
+
+ /// \short Fine propagation of the current states on slices 
+ /// first_slice,...,Nslice-1 in (up to) Nproc worker processes
+ void fine_propagate_in_parallel(const unsigned& first_slice,
+                                 std::vector<std::vector<double> >& fine)
+  {
+   // Serial
+   if (Nproc<=1)
+    {
+     for (unsigned n=first_slice;n<Nslice;n++)
+      {
+       fine_propagate(n,State[n],fine[n]);
+      }
+     return;
+    }
+
+   // Fork a worker for each slice (at most Nproc at a time)
+   Parent_pid=getpid();
+   std::vector<pid_t> pid(Nslice,0);
+   unsigned next=first_slice;
+   unsigned nrunning=0;
+   unsigned nfailed=0;
+   while ((next<Nslice)||(nrunning>0))
+    {
+     if ((next<Nslice)&&(nrunning<Nproc))
+      {
+       pid[next]=fork();
+       if (pid[next]==0)
+        {
+         run_worker(next);
+        }
+       if (pid[next]<0)
+        {
+         throw OomphLibError("Parareal: fork() failed",
+                             OOMPH_CURRENT_FUNCTION,
+                             OOMPH_EXCEPTION_LOCATION);
+        }
+       next++;
+       nrunning++;
+      }
+     else
+      {
+       int status=0;
+       pid_t finished=wait(&status);
+       if (finished>0)
+        {
+         nrunning--;
+         if ((!WIFEXITED(status))||(WEXITSTATUS(status)!=0)) nfailed++;
+        }
+      }
+    }
+   if (nfailed>0)
+    {
+     std::ostringstream error_stream;
+     error_stream << "Parareal: " << nfailed 
+                  << " fine propagation(s) failed" << std::endl;
+     throw OomphLibError(error_stream.str(),
+                         OOMPH_CURRENT_FUNCTION,
+                         OOMPH_EXCEPTION_LOCATION);
+    }
+
+   // Collect the results
+   for (unsigned n=first_slice;n<Nslice;n++)
+    {
+     std::ifstream infile(slice_filename(n).c_str(),std::ios::binary);
+     fine[n].resize(State[n].size());
+     infile.read(reinterpret_cast<char*>(&fine[n][0]),
+                 fine[n].size()*sizeof(double));
+     if (!infile.good())
+      {
+       throw OomphLibError("Parareal: Can't read "+slice_filename(n),
+                           OOMPH_CURRENT_FUNCTION,
+                           OOMPH_EXCEPTION_LOCATION);
+      }
+     infile.close();
+     unlink(slice_filename(n).c_str());
+    }
+  }
+
+ /// \short Worker process: fine propagation on slice n, result written
+ /// to file; doesn't return
+ void run_worker(const unsigned& n)
+  {
+   int exit_status=0;
+   try
+    {
+     oomph_info.stream_pt()=&oomph_nullstream;
+     std::vector<double> end_state;
+     fine_propagate(n,State[n],end_state);
+     std::ofstream outfile(slice_filename(n).c_str(),std::ios::binary);
+     outfile.write(reinterpret_cast<const char*>(&end_state[0]),
+                   end_state.size()*sizeof(double));
+     outfile.close();
+     if (!outfile.good()) exit_status=1;
+    }
+   catch (...)
+    {
+     exit_status=1;
+    }
+   // Don't run any destructors or exit handlers of the parent's objects
+   _exit(exit_status);
+  }
+
+ /// \short Name of the file for the result of the fine propagation on
+ /// slice n
+ std::string slice_filename(const unsigned& n) const
+  {
+   std::ostringstream filename;
+   filename << Work_directory << "/parareal_slice" << n << "_" 
+            << Parent_pid << ".dat";
+   return filename.str();
+  }
+
+ /// Max. absolute value in the slice end states (at least 1)
+ double max_abs_value() const
+  {
+   double max_value=1.0;
+   for (unsigned n=1;n<=Nslice;n++)
+    {
+     unsigned nvalue=State[n].size();
+     for (unsigned i=0;i<nvalue;i++)
+      {
+       max_value=std::max(max_value,std::fabs(State[n][i]));
+      }
+    }
+   return max_value;
+  }
+
+ /// Doc convergence after iteration k
+ void doc_iteration(const unsigned& k, const double& max_change,
+                    const std::vector<std::vector<double> >& reference,
+                    const double& time,
+                    std::ofstream& convergence_stream)
+  {
+   double max_error=-1.0;
+   if (reference.size()>0)
+    {
+     max_error=0.0;
+     for (unsigned n=1;n<=Nslice;n++)
+      {
+       unsigned nvalue=State[n].size();
+       for (unsigned i=0;i<nvalue;i++)
+        {
+         max_error=std::max(max_error,
+                            std::fabs(State[n][i]-reference[n][i]));
+        }
+      }
+     max_error/=max_abs_value();
+    }
+   oomph_info << "Parareal iteration " << k << ": max. relative change "
+              << max_change;
+   if (max_error>=0.0)
+    {
+     oomph_info << "; max. relative error w.r.t. serial solution "
+                << max_error;
+    }
+   oomph_info << "; time so far " << time << " sec" << std::endl;
+   if (convergence_stream.is_open())
+    {
+     convergence_stream << k << " " << time << " " << max_change << " "
+                        << max_error << std::endl;
+    }
+  }
+
+ /// The problem
+ PROBLEM* Problem_pt;
+
+ /// Max. number of processes for the fine propagations
+ unsigned Nproc;
+
+ /// Max. number of Parareal iterations
+ unsigned Max_iter;
+
+ /// Tolerance for the max. relative change in an iteration
+ double Tolerance;
+
+ /// Compute the serial fine solution as reference?
+ bool Compute_reference;
+
+ /// Directory for the files through which the processes communicate
+ std::string Work_directory;
+
+ /// File for the convergence history (none if empty)
+ std::string Convergence_file;
+
+ /// Number of time slices
+ unsigned Nslice;
+
+ /// Fine timestep
+ double Dt_fine;
+
+ /// First fine timestep in each slice (Nslice+1 entries)
+ std::vector<unsigned> Slice_start_step;
+
+ /// Start time of each slice (Nslice+1 entries)
+ std::vector<double> Slice_start_time;
+
+ /// Number of coarse timesteps in each slice
+ std::vector<unsigned> Ncoarse_step;
+
+ /// States at the start of the slices (Nslice+1 entries)
+ std::vector<std::vector<double> > State;
+
+ /// \short Process id of the parent process (to make the names of the
+ /// files written by the workers unique)
+ pid_t Parent_pid;
+
+};
+
+} // end of namespace oomph
+
+#endif
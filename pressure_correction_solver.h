@@ -0,0 +1,418 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Algebraic pressure-correction (fractional-step) solver for the
+// linear systems of Taylor-Hood Navier-Stokes problems. With the
+// velocity (u) and pressure (p) dofs separated, the system
+//
+//     [ F   Bt ] [du]   [r_u]
+//     [ B   C  ] [dp] = [r_p]
+//
+// is solved approximately by a momentum predictor, a pressure Poisson
+// solve and a velocity correction:
+//
+//     F du* = r_u
+//     (B D^{-1} Bt - C) dp = B du* - r_p
+//     du = du* - D^{-1} Bt dp
+//
+// where D is the diagonal of F (dominated by the mass matrix over the
+// timestep). This is the algebraic form of the classical projection
+// scheme (an approximate block LU factorisation of the system). The
+// pressure operator only depends on D and the (fixed) divergence
+// operator, so it's factorised once and re-used until the dofs or the
+// timestep change. Both factorisations use SuperLU. Serial problems
+// only.
+
+#ifndef PRESSURE_CORRECTION_SOLVER_HEADER
+#define PRESSURE_CORRECTION_SOLVER_HEADER
+
+#include <vector>
+#include <algorithm>
+#include <sstream>
+
+#include "multilevel_helpers.h"
+
+namespace oomph
+{
+
+//======================================================================
+/// \short Algebraic pressure-correction solver for the linear systems
+/// of (Taylor-Hood) Navier-Stokes problems: momentum predictor,
+/// pressure Poisson solve with a factorised operator that's re-used
+/// across solves, velocity correction. The pressure dofs are
+/// identified as the unpinned nodal values with the given index.
+//======================================================================
+class PressureCorrectionSolver : public LinearSolver
+{
+
+public:
+
+ /// \short Constructor: Pass the mesh, the index of the pressure in
+ /// the nodal values, and the Time object (the pressure operator is
+ /// set up again when the timestep changes)
+ PressureCorrectionSolver(Mesh* mesh_pt, const unsigned& p_index,
+                          Time* time_pt) :
+  Mesh_pt(mesh_pt), P_index(p_index), Time_pt(time_pt), Ndof(0), 
+  Dt_at_pressure_operator_setup(0.0), Npressure_operator_setup(0)
+  {}
+
+ /// Destructor
+ ~PressureCorrectionSolver()
+  {
+   clean_up_memory();
+  }
+
+ /// Broken copy constructor
+ PressureCorrectionSolver(const PressureCorrectionSolver&)
+  {
+   BrokenCopy::broken_copy("PressureCorrectionSolver");
+  }
+
+ /// Broken assignment operator
+ void operator=(const PressureCorrectionSolver&)
+  {
+   BrokenCopy::broken_assign("PressureCorrectionSolver");
+  }
+
+ /// \short Solve the linear system in the Newton iteration of the
+ /// problem
+ void solve(Problem* const& problem_pt, DoubleVector& result)
+  {
+   double t_start=TimingHelpers::timer();
+   DoubleVector residuals;
+   CRDoubleMatrix jacobian;
+   problem_pt->get_jacobian(residuals,jacobian);
+   Jacobian_setup_time=TimingHelpers::timer()-t_start;
+   solve(&jacobian,residuals,result);
+  }
+
+ /// Solve the linear system
+ void solve(DoubleMatrixBase* const& matrix_pt, const DoubleVector& rhs,
+            DoubleVector& result)
+  {
+   double t_start=TimingHelpers::timer();
+   CRDoubleMatrix* cr_matrix_pt=dynamic_cast<CRDoubleMatrix*>(matrix_pt);
+   if (cr_matrix_pt==0)
+    {
+     throw OomphLibError("PressureCorrectionSolver needs CRDoubleMatrix",
+                         OOMPH_CURRENT_FUNCTION,
+                         OOMPH_EXCEPTION_LOCATION);
+    }
+#ifdef PARANOID
+   if (cr_matrix_pt->distributed())
+    {
+     throw OomphLibError(
+      "PressureCorrectionSolver only works for serial matrices",
+      OOMPH_CURRENT_FUNCTION,
+      OOMPH_EXCEPTION_LOCATION);
+    }
+#endif
+
+   // Split the dofs (again if their number has changed) and the matrix
+   unsigned ndof=cr_matrix_pt->nrow();
+   bool setup_pressure_operator=(Npressure_operator_setup==0)||
+    (Time_pt->dt()!=Dt_at_pressure_operator_setup);
+   if (ndof!=Ndof)
+    {
+     split_dofs(ndof,rhs.distribution_pt()->communicator_pt());
+     setup_pressure_operator=true;
+    }
+   Multilevel_Helpers::CSRMatrix<double> f, bt, b, c;
+   split_matrix(cr_matrix_pt,f,bt,b,c);
+
+   // Pressure Poisson operator
+   if (setup_pressure_operator)
+    {
+     double t_setup=TimingHelpers::timer();
+     f.get_diagonal(Inverse_diagonal);
+     unsigned nu=Inverse_diagonal.size();
+     for (unsigned i=0;i<nu;i++)
+      {
+       double diag=Inverse_diagonal[i];
+       Inverse_diagonal[i]=(diag!=0.0 ? 1.0/diag : 0.0);
+      }
+     Multilevel_Helpers::CSRMatrix<double> d_inv_bt(bt);
+     for (unsigned i=0;i<nu;i++)
+      {
+       for (int k=d_inv_bt.Row_start[i];k<d_inv_bt.Row_start[i+1];k++)
+        {
+         d_inv_bt.Value[k]*=Inverse_diagonal[i];
+        }
+      }
+     Multilevel_Helpers::CSRMatrix<double> s;
+     Multilevel_Helpers::multiply(b,d_inv_bt,s);
+     subtract(c,s);
+     CRDoubleMatrix s_cr;
+     copy_to_cr_matrix(s,&Pressure_distribution,s_cr);
+     Pressure_solver.clean_up_memory();
+     Pressure_solver.factorise(&s_cr);
+     Dt_at_pressure_operator_setup=Time_pt->dt();
+     Npressure_operator_setup++;
+     oomph_info << "Time for setup of pressure operator (setup no. " 
+                << Npressure_operator_setup << "): " 
+                << TimingHelpers::timer()-t_setup << " sec" << std::endl;
+    }
+
+   // Split the rhs
+   unsigned nu=Velocity_dof.size();
+   unsigned np=Pressure_dof.size();
+   DoubleVector r_u(&Velocity_distribution,0.0);
+   DoubleVector r_p(&Pressure_distribution,0.0);
+   for (unsigned i=0;i<nu;i++)
+    {
+     r_u[i]=rhs[Velocity_dof[i]];
+    }
+   for (unsigned i=0;i<np;i++)
+    {
+     r_p[i]=rhs[Pressure_dof[i]];
+    }
+
+   // Momentum predictor
+   CRDoubleMatrix f_cr;
+   copy_to_cr_matrix(f,&Velocity_distribution,f_cr);
+   DoubleVector du(&Velocity_distribution,0.0);
+   Momentum_solver.factorise(&f_cr);
+   Momentum_solver.backsub(r_u,du);
+   Momentum_solver.clean_up_memory();
+
+   // Pressure Poisson solve
+   DoubleVector g(&Pressure_distribution,0.0);
+   b.multiply(du.values_pt(),g.values_pt());
+   for (unsigned i=0;i<np;i++)
+    {
+     g[i]-=r_p[i];
+    }
+   DoubleVector dp(&Pressure_distribution,0.0);
+   Pressure_solver.backsub(g,dp);
+
+   // Velocity correction
+   std::vector<double> bt_dp(nu,0.0);
+   bt.multiply(dp.values_pt(),&bt_dp[0]);
+   result.build(rhs.distribution_pt(),0.0);
+   for (unsigned i=0;i<nu;i++)
+    {
+     result[Velocity_dof[i]]=du[i]-Inverse_diagonal[i]*bt_dp[i];
+    }
+   for (unsigned i=0;i<np;i++)
+    {
+     result[Pressure_dof[i]]=dp[i];
+    }
+
+   Solution_time=TimingHelpers::timer()-t_start;
+   if (Doc_time)
+    {
+     oomph_info << "Time for pressure-correction solve: " << Solution_time
+                << " sec" << std::endl;
+    }
+  }
+
+ /// \short Set up the pressure operator again in the next solve
+ /// (e.g. if the boundary conditions have changed)
+ void reset_pressure_operator() {Npressure_operator_setup=0;}
+
+ /// Number of setups of the pressure operator
+ unsigned npressure_operator_setup() const {return Npressure_operator_setup;}
+
+ /// Clean up memory
+ void clean_up_memory()
+  {
+   Momentum_solver.clean_up_memory();
+   Pressure_solver.clean_up_memory();
+  }
+
+private:
+
+ /// \short Classify the dofs as pressure dofs (the unpinned nodal
+ /// values P_index) and velocity dofs (all others)
+ void split_dofs(const unsigned& ndof, const OomphCommunicator* comm_pt)
+  {
+   std::vector<bool> is_pressure(ndof,false);
+   unsigned nnod=Mesh_pt->nnode();
+   for (unsigned j=0;j<nnod;j++)
+    {
+     Node* nod_pt=Mesh_pt->node_pt(j);
+     if (nod_pt->nvalue()>P_index)
+      {
+       long eqn=nod_pt->eqn_number(P_index);
+       if (eqn>=0)
+        {
+         is_pressure[eqn]=true;
+        }
+      }
+    }
+   Block_index.resize(ndof);
+   Velocity_dof.clear();
+   Pressure_dof.clear();
+   for (unsigned i=0;i<ndof;i++)
+    {
+     if (is_pressure[i])
+      {
+       Block_index[i]=Pressure_dof.size();
+       Pressure_dof.push_back(i);
+      }
+     else
+      {
+       Block_index[i]=Velocity_dof.size();
+       Velocity_dof.push_back(i);
+      }
+    }
+   Velocity_distribution.build(comm_pt,Velocity_dof.size(),false);
+   Pressure_distribution.build(comm_pt,Pressure_dof.size(),false);
+   Is_pressure.swap(is_pressure);
+   Ndof=ndof;
+  }
+
+ /// \short Split the matrix into its velocity-velocity (f),
+ /// velocity-pressure (bt), pressure-velocity (b) and
+ /// pressure-pressure (c) blocks
+ void split_matrix(CRDoubleMatrix* cr_matrix_pt,
+                   Multilevel_Helpers::CSRMatrix<double>& f,
+                   Multilevel_Helpers::CSRMatrix<double>& bt,
+                   Multilevel_Helpers::CSRMatrix<double>& b,
+                   Multilevel_Helpers::CSRMatrix<double>& c)
+  {
+   unsigned nu=Velocity_dof.size();
+   unsigned np=Pressure_dof.size();
+   f.resize(nu,nu);
+   bt.resize(nu,np);
+   b.resize(np,nu);
+   c.resize(np,np);
+   const int* row_start=cr_matrix_pt->row_start();
+   const int* column_index=cr_matrix_pt->column_index();
+   const double* value=cr_matrix_pt->value();
+   unsigned ndof=cr_matrix_pt->nrow();
+   for (unsigned i=0;i<ndof;i++)
+    {
+     // Blocks for the velocity and pressure columns in this row
+     Multilevel_Helpers::CSRMatrix<double>& block_u=Is_pressure[i] ? b : f;
+     Multilevel_Helpers::CSRMatrix<double>& block_p=Is_pressure[i] ? c : bt;
+     for (int k=row_start[i];k<row_start[i+1];k++)
+      {
+       int j=column_index[k];
+       Multilevel_Helpers::CSRMatrix<double>& block=
+        Is_pressure[j] ? block_p : block_u;
+       block.Column_index.push_back(Block_index[j]);
+       block.Value.push_back(value[k]);
+      }
+     block_u.Row_start[Block_index[i]+1]=block_u.nnz();
+     block_p.Row_start[Block_index[i]+1]=block_p.nnz();
+    }
+  }
+
+ /// s = s - c
+ static void subtract(const Multilevel_Helpers::CSRMatrix<double>& c,
+                      Multilevel_Helpers::CSRMatrix<double>& s)
+  {
+   if (c.nnz()==0) return;
+
+   // Append the entries of -c to the rows of s and add up duplicates
+   unsigned n=s.nrow();
+   Multilevel_Helpers::CSRMatrix<double> merged;
+   merged.resize(n,s.ncol());
+   for (unsigned i=0;i<n;i++)
+    {
+     for (int k=s.Row_start[i];k<s.Row_start[i+1];k++)
+      {
+       merged.Column_index.push_back(s.Column_index[k]);
+       merged.Value.push_back(s.Value[k]);
+      }
+     for (int k=c.Row_start[i];k<c.Row_start[i+1];k++)
+      {
+       merged.Column_index.push_back(c.Column_index[k]);
+       merged.Value.push_back(-c.Value[k]);
+      }
+     merged.Row_start[i+1]=merged.nnz();
+    }
+   merged.sort_rows();
+   s=merged;
+  }
+
+ /// Copy a CSRMatrix into a CRDoubleMatrix with the given distribution
+ static void copy_to_cr_matrix(
+  const Multilevel_Helpers::CSRMatrix<double>& a,
+  const LinearAlgebraDistribution* dist_pt, CRDoubleMatrix& a_cr)
+  {
+   unsigned nnz=a.nnz();
+   double* value=new double[std::max(nnz,1u)];
+   std::copy(a.Value.begin(),a.Value.end(),value);
+   int* column_index=new int[std::max(nnz,1u)];
+   std::copy(a.Column_index.begin(),a.Column_index.end(),column_index);
+   int* row_start=new int[a.nrow()+1];
+   std::copy(a.Row_start.begin(),a.Row_start.end(),row_start);
+   a_cr.build(dist_pt);
+   a_cr.build_without_copy(a.ncol(),nnz,value,column_index,row_start);
+  }
+
+ /// The mesh
+ Mesh* Mesh_pt;
+
+ /// Index of the pressure in the nodal values
+ unsigned P_index;
+
+ /// The Time object
+ Time* Time_pt;
+
+ /// Number of dofs for which the dofs were split (0 if not yet)
+ unsigned Ndof;
+
+ /// Is the dof a pressure dof?
+ std::vector<bool> Is_pressure;
+
+ /// Index of each dof in its (velocity or pressure) block
+ std::vector<unsigned> Block_index;
+
+ /// Global equation numbers of the velocity dofs
+ std::vector<unsigned> Velocity_dof;
+
+ /// Global equation numbers of the pressure dofs
+ std::vector<unsigned> Pressure_dof;
+
+ /// Distribution of the velocity block
+ LinearAlgebraDistribution Velocity_distribution;
+
+ /// Distribution of the pressure block
+ LinearAlgebraDistribution Pressure_distribution;
+
+ /// Inverse of the diagonal of the momentum block at the last setup
+ std::vector<double> Inverse_diagonal;
+
+ /// Timestep at the last setup of the pressure operator
+ double Dt_at_pressure_operator_setup;
+
+ /// Number of setups of the pressure operator
+ unsigned Npressure_operator_setup;
+
+ /// Solver for the momentum block (factorised in every solve)
+ SuperLUSolver Momentum_solver;
+
+ /// \short Solver for the pressure operator (factorised once and
+ /// re-used)
+ SuperLUSolver Pressure_solver;
+
+};
+
+} // end of namespace oomph
+
+#endif
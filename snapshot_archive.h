@@ -0,0 +1,577 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Single-file snapshot archive: a header, the (shared) mesh, an index
+// table with one entry per timestep (time and offset/size/encoding of
+// each field block) and the field blocks themselves. The writer appends
+// one timestep at a time; the reader memory-maps the file and provides
+// zero-copy access to any (step, field) pair that is stored uncompressed.
+//
+// Layout (native byte order and struct layout):
+//
+//   ArchiveHeader
+//   mesh block (see Snapshot_Compression::SnapshotMesh::write(...))
+//   Max_nstep ArchiveIndexEntry-s
+//   field blocks, each starting at a multiple of Block_alignment bytes
+//
+// Only the standard library and POSIX are used so post-processing tools
+// can use this without linking against oomph-lib.
+
+#ifndef SNAPSHOT_ARCHIVE_HEADER
+#define SNAPSHOT_ARCHIVE_HEADER
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot_compression.h"
+
+
+namespace Snapshot_Compression
+{
+
+ /// Magic string at the start of snapshot archives
+ const char Archive_magic[8]={'A','N','N','E','A','R','C','1'};
+
+ /// Max. number of fields in an archive
+ const unsigned Archive_max_nfield=8;
+
+ /// \short Field blocks start at multiples of this many bytes (so they can
+ /// be accessed in place as arrays of doubles)
+ const unsigned long Block_alignment=64;
+
+ /// \short Encoding of field blocks in archive: Contiguous raw doubles
+ /// or compressed (in the format written by compress_field(...))
+ enum {Raw_block=0, Compressed_block=1};
+
+
+ //=====================================================================
+ /// Header of snapshot archive
+ //=====================================================================
+ struct ArchiveHeader
+ {
+  /// Magic string
+  char Magic[8];
+
+  /// Number of fields
+  unsigned Nfield;
+
+  /// Number of nodes (i.e. number of values per field)
+  unsigned Nnode;
+
+  /// Max. number of timesteps (size of index table)
+  unsigned Max_nstep;
+
+  /// Number of timesteps written so far
+  unsigned Nstep;
+
+  /// Offset of mesh block
+  unsigned long Mesh_offset;
+
+  /// Size of mesh block (in bytes)
+  unsigned long Mesh_nbyte;
+
+  /// Offset of index table
+  unsigned long Index_offset;
+
+  /// Field names
+  char Field_name[Archive_max_nfield][Field_name_length];
+ };
+
+
+ //=====================================================================
+ /// Entry in index table: Time and location of the field blocks
+ //=====================================================================
+ struct ArchiveIndexEntry
+ {
+  /// Time
+  double Time;
+
+  /// Offsets of field blocks
+  unsigned long Offset[Archive_max_nfield];
+
+  /// Sizes of field blocks (in bytes)
+  unsigned long Nbyte[Archive_max_nfield];
+
+  /// Encoding of field blocks
+  unsigned Encoding[Archive_max_nfield];
+ };
+
+
+
+ //=====================================================================
+ /// \short Writer for snapshot archive: Creates a new archive or opens
+ /// an existing one and appends timesteps.
+ //=====================================================================
+ class SnapshotArchiveWriter
+ {
+ public:
+
+  /// \short Constructor: Create new archive (overwriting any existing
+  /// file) for the given fields on the given mesh, with space in the
+  /// index table for max_nstep timesteps
+  SnapshotArchiveWriter(const std::string& filename,
+                        const SnapshotMesh& mesh,
+                        const std::vector<std::string>& field_name,
+                        const unsigned& max_nstep) : Filename(filename)
+   {
+    if (field_name.size()>Archive_max_nfield)
+     {
+      throw std::runtime_error("SnapshotArchiveWriter: Too many fields");
+     }
+
+    // Setup header
+    memset(&Header,0,sizeof(ArchiveHeader));
+    memcpy(Header.Magic,Archive_magic,8);
+    Header.Nfield=field_name.size();
+    Header.Nnode=mesh.nnode();
+    Header.Max_nstep=max_nstep;
+    Header.Nstep=0;
+    for (unsigned i=0;i<Header.Nfield;i++)
+     {
+      strncpy(Header.Field_name[i],field_name[i].c_str(),
+              Field_name_length-1);
+     }
+
+    // Mesh and (empty) index table follow the header
+    std::vector<unsigned char> mesh_buffer;
+    mesh.write(mesh_buffer);
+    Header.Mesh_offset=sizeof(ArchiveHeader);
+    Header.Mesh_nbyte=mesh_buffer.size();
+    Header.Index_offset=aligned(Header.Mesh_offset+Header.Mesh_nbyte);
+
+    File_pt=fopen(filename.c_str(),"w+b");
+    if (File_pt==0)
+     {
+      throw std::runtime_error("SnapshotArchiveWriter: Couldn't create "+
+                               filename);
+     }
+    write_at(0,&Header,sizeof(ArchiveHeader));
+    write_at(Header.Mesh_offset,&mesh_buffer[0],mesh_buffer.size());
+    std::vector<ArchiveIndexEntry> index(max_nstep);
+    if (max_nstep>0)
+     {
+      memset(&index[0],0,max_nstep*sizeof(ArchiveIndexEntry));
+      write_at(Header.Index_offset,&index[0],
+               max_nstep*sizeof(ArchiveIndexEntry));
+     }
+    fflush(File_pt);
+   }
+
+  /// \short Constructor: Open existing archive for appending; timesteps
+  /// from nstep_to_keep onwards are discarded (e.g. when restarting
+  /// from a checkpoint that was written before they were computed).
+  SnapshotArchiveWriter(const std::string& filename,
+                        const unsigned& nstep_to_keep) : Filename(filename)
+   {
+    File_pt=fopen(filename.c_str(),"r+b");
+    if ((File_pt==0)||
+        (fread(&Header,sizeof(ArchiveHeader),1,File_pt)!=1)||
+        (memcmp(Header.Magic,Archive_magic,8)!=0))
+     {
+      if (File_pt!=0) fclose(File_pt);
+      throw std::runtime_error("SnapshotArchiveWriter: Couldn't open "+
+                               filename+" as snapshot archive");
+     }
+    if (nstep_to_keep<Header.Nstep)
+     {
+      Header.Nstep=nstep_to_keep;
+      write_at(0,&Header,sizeof(ArchiveHeader));
+      fflush(File_pt);
+     }
+   }
+
+  /// Destructor: Close file
+  ~SnapshotArchiveWriter()
+   {
+    fclose(File_pt);
+   }
+
+  /// Number of timesteps in archive
+  unsigned nstep() const {return Header.Nstep;}
+
+  /// Number of nodes
+  unsigned nnode() const {return Header.Nnode;}
+
+  /// Number of fields
+  unsigned nfield() const {return Header.Nfield;}
+
+  /// \short Append timestep: Field i is stored as raw doubles if
+  /// abs_error_bound[i]<=0, and compressed with that error bound
+  /// otherwise. row_length: see Snapshot_Compression::predict(...).
+  /// The header is only updated once the data and the index entry
+  /// have been written, so an interrupted append leaves a valid archive.
+  void append(const Snapshot& snapshot,
+              const std::vector<double>& abs_error_bound,
+              const unsigned& row_length)
+   {
+    if (Header.Nstep>=Header.Max_nstep)
+     {
+      throw std::runtime_error("SnapshotArchiveWriter: Index table of "+
+                               Filename+" is full");
+     }
+    if (snapshot.Field_value.size()!=Header.Nfield)
+     {
+      throw std::runtime_error("SnapshotArchiveWriter: Wrong number of fields");
+     }
+
+    ArchiveIndexEntry entry;
+    memset(&entry,0,sizeof(ArchiveIndexEntry));
+    entry.Time=snapshot.Time;
+
+    // Append field blocks at (aligned) end of file
+    fseek(File_pt,0,SEEK_END);
+    unsigned long offset=aligned(ftell(File_pt));
+    for (unsigned i=0;i<Header.Nfield;i++)
+     {
+      if (snapshot.Field_value[i].size()!=Header.Nnode)
+       {
+        throw std::runtime_error(
+         "SnapshotArchiveWriter: Wrong number of values in field");
+       }
+      const double* value_pt=&snapshot.Field_value[i][0];
+      entry.Offset[i]=offset;
+      if (abs_error_bound[i]>0.0)
+       {
+        std::vector<unsigned char> buffer;
+        compress_field(value_pt,Header.Nnode,abs_error_bound[i],
+                       row_length,buffer);
+        write_at(offset,&buffer[0],buffer.size());
+        entry.Nbyte[i]=buffer.size();
+        entry.Encoding[i]=Compressed_block;
+       }
+      else
+       {
+        entry.Nbyte[i]=Header.Nnode*sizeof(double);
+        write_at(offset,value_pt,entry.Nbyte[i]);
+        entry.Encoding[i]=Raw_block;
+       }
+      offset=aligned(offset+entry.Nbyte[i]);
+     }
+    fflush(File_pt);
+
+    // Index entry
+    write_at(Header.Index_offset+Header.Nstep*sizeof(ArchiveIndexEntry),
+             &entry,sizeof(ArchiveIndexEntry));
+    fflush(File_pt);
+
+    // Commit
+    Header.Nstep++;
+    write_at(0,&Header,sizeof(ArchiveHeader));
+    fflush(File_pt);
+   }
+
+ private:
+
+  /// Round offset up to multiple of Block_alignment
+  static unsigned long aligned(const unsigned long& offset)
+   {
+    return ((offset+Block_alignment-1)/Block_alignment)*Block_alignment;
+   }
+
+  /// Write n bytes at given offset
+  void write_at(const unsigned long& offset, const void* data_pt,
+                const size_t& n)
+   {
+    if ((fseek(File_pt,offset,SEEK_SET)!=0)||
+        ((n!=0)&&(fwrite(data_pt,1,n,File_pt)!=n)))
+     {
+      throw std::runtime_error("SnapshotArchiveWriter: Couldn't write to "+
+                               Filename);
+     }
+   }
+
+  /// Broken copy constructor
+  SnapshotArchiveWriter(const SnapshotArchiveWriter&);
+
+  /// Broken assignment operator
+  void operator=(const SnapshotArchiveWriter&);
+
+  /// Name of archive
+  std::string Filename;
+
+  /// The file
+  FILE* File_pt;
+
+  /// Header (as last written)
+  ArchiveHeader Header;
+ };
+
+
+
+
+ //=====================================================================
+ /// \short Reader for snapshot archive: Memory-maps the archive and
+ /// provides zero-copy access to field blocks that are stored as raw
+ /// doubles. Only the timesteps that had been committed when the archive
+ /// was opened are visible.
+ //=====================================================================
+ class SnapshotArchiveReader
+ {
+ public:
+
+  /// Constructor: Open and map the archive
+  SnapshotArchiveReader(const std::string& filename) : Map_pt(0), Size(0)
+   {
+    int fd=open(filename.c_str(),O_RDONLY);
+    struct stat file_stat;
+    if ((fd<0)||(fstat(fd,&file_stat)!=0))
+     {
+      if (fd>=0) close(fd);
+      throw std::runtime_error("SnapshotArchiveReader: Couldn't open "+
+                               filename);
+     }
+    Size=file_stat.st_size;
+    void* map_pt=mmap(0,Size,PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if (map_pt==MAP_FAILED)
+     {
+      throw std::runtime_error("SnapshotArchiveReader: Couldn't map "+
+                               filename);
+     }
+    Map_pt=static_cast<const unsigned char*>(map_pt);
+
+    // Header
+    if ((Size<sizeof(ArchiveHeader))||
+        (memcmp(Map_pt,Archive_magic,8)!=0))
+     {
+      munmap(const_cast<unsigned char*>(Map_pt),Size);
+      throw std::runtime_error("SnapshotArchiveReader: "+filename+
+                               " is not a snapshot archive");
+     }
+    memcpy(&Header,Map_pt,sizeof(ArchiveHeader));
+    if ((Header.Nfield>Archive_max_nfield)||
+        (Header.Nstep>Header.Max_nstep)||
+        (Header.Index_offset+
+         Header.Max_nstep*sizeof(ArchiveIndexEntry)>Size))
+     {
+      munmap(const_cast<unsigned char*>(Map_pt),Size);
+      throw std::runtime_error("SnapshotArchiveReader: Corrupt header in "+
+                               filename);
+     }
+    Index_pt=reinterpret_cast<const ArchiveIndexEntry*>(
+     Map_pt+Header.Index_offset);
+
+    // Mesh
+    ByteReader mesh_reader(Map_pt+Header.Mesh_offset,Header.Mesh_nbyte);
+    Mesh.read(mesh_reader);
+   }
+
+  /// Destructor: Unmap
+  ~SnapshotArchiveReader()
+   {
+    munmap(const_cast<unsigned char*>(Map_pt),Size);
+   }
+
+  /// Number of timesteps
+  unsigned nstep() const {return Header.Nstep;}
+
+  /// Number of fields
+  unsigned nfield() const {return Header.Nfield;}
+
+  /// Number of nodes
+  unsigned nnode() const {return Header.Nnode;}
+
+  /// Name of i-th field
+  std::string field_name(const unsigned& i) const
+   {
+    check_field(i);
+    char name[Field_name_length];
+    memcpy(name,Header.Field_name[i],Field_name_length);
+    name[Field_name_length-1]=0;
+    return name;
+   }
+
+  /// Index of field with given name (-1 if there's no such field)
+  int field_index(const std::string& name) const
+   {
+    for (unsigned i=0;i<Header.Nfield;i++)
+     {
+      if (field_name(i)==name) return i;
+     }
+    return -1;
+   }
+
+  /// The mesh
+  const SnapshotMesh& mesh() const {return Mesh;}
+
+  /// Time at given step
+  double time(const unsigned& step) const
+   {
+    check_step(step);
+    return Index_pt[step].Time;
+   }
+
+  /// \short Step whose time is closest to t (bisection: times are
+  /// assumed to increase monotonically)
+  unsigned find_step(const double& t) const
+   {
+    if (Header.Nstep==0)
+     {
+      throw std::runtime_error("SnapshotArchiveReader: Archive is empty");
+     }
+    unsigned lo=0;
+    unsigned hi=Header.Nstep-1;
+    while (hi-lo>1)
+     {
+      unsigned mid=(lo+hi)/2;
+      if (Index_pt[mid].Time<=t) {lo=mid;} else {hi=mid;}
+     }
+    return (std::fabs(Index_pt[hi].Time-t)<std::fabs(Index_pt[lo].Time-t))?
+     hi : lo;
+   }
+
+  /// Is the given field block stored as raw doubles?
+  bool is_raw(const unsigned& step, const unsigned& field) const
+   {
+    check_step(step);
+    check_field(field);
+    return Index_pt[step].Encoding[field]==Raw_block;
+   }
+
+  /// \short Zero-copy access to field block stored as raw doubles
+  /// (valid for the lifetime of the reader); throws if the block is
+  /// compressed -- use get_field(...) instead.
+  const double* field_pt(const unsigned& step, const unsigned& field) const
+   {
+    if (!is_raw(step,field))
+     {
+      throw std::runtime_error(
+       "SnapshotArchiveReader: Block is compressed; use get_field(...)");
+     }
+    return reinterpret_cast<const double*>(block_pt(step,field));
+   }
+
+  /// Get copy of field values (decompressed if required)
+  void get_field(const unsigned& step, const unsigned& field,
+                 std::vector<double>& value) const
+   {
+    if (is_raw(step,field))
+     {
+      const double* value_pt=field_pt(step,field);
+      value.assign(value_pt,value_pt+Header.Nnode);
+     }
+    else
+     {
+      ByteReader reader(block_pt(step,field),Index_pt[step].Nbyte[field]);
+      decompress_field(reader,value);
+     }
+   }
+
+  /// Get all fields at given step
+  void get_snapshot(const unsigned& step, Snapshot& snapshot) const
+   {
+    snapshot.Time=time(step);
+    snapshot.Field_name.resize(Header.Nfield);
+    snapshot.Field_value.resize(Header.Nfield);
+    for (unsigned i=0;i<Header.Nfield;i++)
+     {
+      snapshot.Field_name[i]=field_name(i);
+      get_field(step,i,snapshot.Field_value[i]);
+     }
+   }
+
+  /// \short Time series of a field at a given node (over all steps)
+  void get_time_series(const unsigned& node, const unsigned& field,
+                       std::vector<double>& value) const
+   {
+    if (node>=Header.Nnode)
+     {
+      throw std::runtime_error("SnapshotArchiveReader: Node out of range");
+     }
+    value.resize(Header.Nstep);
+    std::vector<double> decompressed;
+    for (unsigned step=0;step<Header.Nstep;step++)
+     {
+      if (is_raw(step,field))
+       {
+        value[step]=field_pt(step,field)[node];
+       }
+      else
+       {
+        get_field(step,field,decompressed);
+        value[step]=decompressed[node];
+       }
+     }
+   }
+
+ private:
+
+  /// Pointer to start of field block (with bounds check)
+  const unsigned char* block_pt(const unsigned& step,
+                                const unsigned& field) const
+   {
+    const ArchiveIndexEntry& entry=Index_pt[step];
+    if (entry.Offset[field]+entry.Nbyte[field]>Size)
+     {
+      throw std::runtime_error("SnapshotArchiveReader: Block out of range");
+     }
+    return Map_pt+entry.Offset[field];
+   }
+
+  /// Check step number
+  void check_step(const unsigned& step) const
+   {
+    if (step>=Header.Nstep)
+     {
+      throw std::runtime_error("SnapshotArchiveReader: Step out of range");
+     }
+   }
+
+  /// Check field number
+  void check_field(const unsigned& field) const
+   {
+    if (field>=Header.Nfield)
+     {
+      throw std::runtime_error("SnapshotArchiveReader: Field out of range");
+     }
+   }
+
+  /// Broken copy constructor
+  SnapshotArchiveReader(const SnapshotArchiveReader&);
+
+  /// Broken assignment operator
+  void operator=(const SnapshotArchiveReader&);
+
+  /// Start of mapped file
+  const unsigned char* Map_pt;
+
+  /// Size of mapped file
+  size_t Size;
+
+  /// Header
+  ArchiveHeader Header;
+
+  /// Index table (in mapped file)
+  const ArchiveIndexEntry* Index_pt;
+
+  /// The mesh
+  SnapshotMesh Mesh;
+ };
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,767 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Error-bounded lossy compression of nodal snapshots, plus i/o for the
+// (shared) mesh. Deliberately only uses the standard library so that
+// post-processing tools can use it without linking against oomph-lib.
+
+#ifndef SNAPSHOT_COMPRESSION_HEADER
+#define SNAPSHOT_COMPRESSION_HEADER
+
+#include <vector>
+#include <string>
+#include <queue>
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+
+//===start_of_namespace=================================================
+/// \short Error-bounded lossy compression of nodal fields:
+/// Each value is predicted from previously reconstructed values
+/// (Lorenzo predictor on the lexicographically numbered nodes of a
+/// structured mesh, or simply the previous value), the prediction error
+/// is quantised with bin width 2*error_bound, and the quantisation codes
+/// are Huffman coded. Values whose reconstruction would violate the
+/// error bound are stored exactly. So |value-reconstructed value|
+/// <= error_bound for every value.
+//======================================================================
+namespace Snapshot_Compression
+{
+
+ /// Encodings of a field block
+ enum {Raw=0, Quantised=1};
+
+ /// \short Max. magnitude of quantisation code; larger prediction errors
+ /// are stored as raw doubles
+ const int Max_quantisation_code=32767;
+
+ /// Max. length of Huffman codes (in bits)
+ const unsigned Max_code_length=24;
+
+ /// Magic string at the start of compressed snapshot files
+ const char Snapshot_magic[8]={'A','N','N','E','S','N','P','1'};
+
+ /// Magic string at the start of mesh files
+ const char Mesh_magic[8]={'A','N','N','E','M','S','H','1'};
+
+ /// Max. length of field names (incl. terminating zero)
+ const unsigned Field_name_length=16;
+
+
+ //=====================================================================
+ /// Append POD data to byte buffer
+ //=====================================================================
+ template<class T>
+ inline void append(std::vector<unsigned char>& buffer,
+                    const T* data_pt, const size_t& n)
+ {
+  if (n==0) return;
+  size_t old_size=buffer.size();
+  buffer.resize(old_size+n*sizeof(T));
+  memcpy(&buffer[old_size],data_pt,n*sizeof(T));
+ }
+
+ //=====================================================================
+ /// Append single POD value to byte buffer
+ //=====================================================================
+ template<class T>
+ inline void append(std::vector<unsigned char>& buffer, const T& data)
+ {
+  append(buffer,&data,1);
+ }
+
+
+ //=====================================================================
+ /// \short Cursor for reading POD data from a byte buffer (e.g. a
+ /// memory-mapped file); throws if we run off the end.
+ //=====================================================================
+ class ByteReader
+ {
+ public:
+
+  /// Constructor: Pass pointer to start of buffer and its size
+  ByteReader(const unsigned char* data_pt, const size_t& size) :
+   Data_pt(data_pt), Size(size), Position(0)
+   {}
+
+  /// Read n items of POD data
+  template<class T>
+  void read(T* result_pt, const size_t& n)
+   {
+    if (n==0) return;
+    check_available(n*sizeof(T));
+    memcpy(result_pt,Data_pt+Position,n*sizeof(T));
+    Position+=n*sizeof(T);
+   }
+
+  /// Read single item of POD data
+  template<class T>
+  T read()
+   {
+    T result;
+    read(&result,1);
+    return result;
+   }
+
+  /// \short Pointer to current position, then skip n bytes
+  const unsigned char* skip(const size_t& n)
+   {
+    check_available(n);
+    const unsigned char* result_pt=Data_pt+Position;
+    Position+=n;
+    return result_pt;
+   }
+
+  /// Current position
+  size_t position() const {return Position;}
+
+ private:
+
+  /// Throw if there aren't n more bytes
+  void check_available(const size_t& n) const
+   {
+    if (Position+n>Size)
+     {
+      throw std::runtime_error("Snapshot_Compression: Unexpected end of data");
+     }
+   }
+
+  /// Start of buffer
+  const unsigned char* Data_pt;
+
+  /// Size of buffer
+  size_t Size;
+
+  /// Current position
+  size_t Position;
+ };
+
+
+
+ //=====================================================================
+ /// \short Compute Huffman code lengths for the symbols with nonzero
+ /// frequency. Lengths are limited to Max_code_length by repeatedly
+ /// flattening the frequency distribution.
+ //=====================================================================
+ inline void huffman_code_lengths(const std::vector<unsigned>& frequency,
+                                  std::vector<unsigned char>& length)
+ {
+  unsigned nsymbol=frequency.size();
+  length.assign(nsymbol,0);
+  std::vector<unsigned> freq(frequency);
+
+  // Only a single symbol? Give it a one-bit code
+  unsigned nused=0;
+  for (unsigned i=0;i<nsymbol;i++) {if (freq[i]!=0) nused++;}
+  if (nused==0) return;
+  if (nused==1)
+   {
+    for (unsigned i=0;i<nsymbol;i++) {if (freq[i]!=0) length[i]=1;}
+    return;
+   }
+
+  while (true)
+   {
+    // Tree nodes: leaves first, then internal nodes
+    std::vector<int> parent;
+    parent.reserve(2*nused);
+    std::vector<unsigned> leaf_symbol;
+    leaf_symbol.reserve(nused);
+
+    // Min-heap of (weight, node)
+    std::priority_queue<std::pair<double,int>,
+                        std::vector<std::pair<double,int> >,
+                        std::greater<std::pair<double,int> > > heap;
+    for (unsigned i=0;i<nsymbol;i++)
+     {
+      if (freq[i]!=0)
+       {
+        heap.push(std::make_pair(double(freq[i]),int(parent.size())));
+        parent.push_back(-1);
+        leaf_symbol.push_back(i);
+       }
+     }
+
+    // Merge the two lightest nodes until there's only one left
+    while (heap.size()>1)
+     {
+      std::pair<double,int> a=heap.top(); heap.pop();
+      std::pair<double,int> b=heap.top(); heap.pop();
+      int new_node=parent.size();
+      parent.push_back(-1);
+      parent[a.second]=new_node;
+      parent[b.second]=new_node;
+      heap.push(std::make_pair(a.first+b.first,new_node));
+     }
+
+    // Depth of leaves
+    unsigned max_length=0;
+    for (unsigned k=0;k<nused;k++)
+     {
+      unsigned depth=0;
+      int node=k;
+      while (parent[node]!=-1) {node=parent[node]; depth++;}
+      length[leaf_symbol[k]]=depth;
+      max_length=std::max(max_length,depth);
+     }
+    if (max_length<=Max_code_length) return;
+
+    // Too long: Flatten the distribution and try again
+    for (unsigned i=0;i<nsymbol;i++)
+     {
+      if (freq[i]!=0) freq[i]=(freq[i]>>1)|1;
+     }
+   }
+ }
+
+
+ //=====================================================================
+ /// \short Canonical Huffman code: symbols sorted by (length,symbol) and,
+ /// for each length, the first code and the index of the first symbol
+ /// of that length in the sorted list.
+ //=====================================================================
+ class CanonicalHuffmanCode
+ {
+ public:
+
+  /// Setup from code lengths (zero length: symbol is not used)
+  void setup(const std::vector<unsigned char>& length)
+   {
+    Length=length;
+    unsigned nsymbol=length.size();
+    Code.assign(nsymbol,0);
+    Count.assign(Max_code_length+1,0);
+    for (unsigned i=0;i<nsymbol;i++) {Count[length[i]]++;}
+    Count[0]=0;
+
+    // Symbols sorted by length, then by symbol
+    Sorted_symbol.clear();
+    for (unsigned l=1;l<=Max_code_length;l++)
+     {
+      for (unsigned i=0;i<nsymbol;i++)
+       {
+        if (length[i]==l) Sorted_symbol.push_back(i);
+       }
+     }
+
+    // First code and first index for each length
+    First_code.assign(Max_code_length+2,0);
+    First_index.assign(Max_code_length+2,0);
+    unsigned code=0;
+    unsigned index=0;
+    for (unsigned l=1;l<=Max_code_length;l++)
+     {
+      code=(code+Count[l-1])<<1;
+      First_code[l]=code;
+      First_index[l]=index;
+      index+=Count[l];
+     }
+
+    // Codes for each symbol
+    for (unsigned l=1;l<=Max_code_length;l++)
+     {
+      for (unsigned k=0;k<Count[l];k++)
+       {
+        Code[Sorted_symbol[First_index[l]+k]]=First_code[l]+k;
+       }
+     }
+   }
+
+  /// Code length for symbol
+  std::vector<unsigned char> Length;
+
+  /// Code for symbol
+  std::vector<unsigned> Code;
+
+  /// Number of codes of given length
+  std::vector<unsigned> Count;
+
+  /// Symbols sorted by (code length, symbol)
+  std::vector<unsigned> Sorted_symbol;
+
+  /// First code of given length
+  std::vector<unsigned> First_code;
+
+  /// Index (in Sorted_symbol) of first symbol of given length
+  std::vector<unsigned> First_index;
+ };
+
+
+ //=====================================================================
+ /// \short Predict value i from the previously reconstructed values:
+ /// Lorenzo predictor if row_length>0 (nodes are numbered
+ /// lexicographically in rows of that length), previous value otherwise.
+ //=====================================================================
+ inline double predict(const std::vector<double>& reconstructed,
+                       const unsigned& i, const unsigned& row_length)
+ {
+  if (i==0) return 0.0;
+  if ((row_length==0)||(i<row_length)) return reconstructed[i-1];
+  if (i%row_length==0) return reconstructed[i-row_length];
+  return reconstructed[i-1]+reconstructed[i-row_length]-
+   reconstructed[i-row_length-1];
+ }
+
+
+ //=====================================================================
+ /// \short Absolute error bound for a field, given either an absolute
+ /// bound or a bound relative to the range of values.
+ //=====================================================================
+ inline double absolute_error_bound(const double* value_pt,
+                                    const unsigned& nvalue,
+                                    const double& error_bound,
+                                    const bool& relative)
+ {
+  if ((!relative)||(nvalue==0)) return error_bound;
+  double min_value=value_pt[0];
+  double max_value=value_pt[0];
+  for (unsigned i=1;i<nvalue;i++)
+   {
+    min_value=std::min(min_value,value_pt[i]);
+    max_value=std::max(max_value,value_pt[i]);
+   }
+  return error_bound*(max_value-min_value);
+ }
+
+
+ //=====================================================================
+ /// \short Compress nvalue values so that the reconstruction differs by
+ /// no more than abs_error_bound from the original values (which are
+ /// stored exactly if abs_error_bound<=0). row_length: see predict(...).
+ /// Compressed data is appended to buffer.
+ //=====================================================================
+ inline void compress_field(const double* value_pt,
+                            const unsigned& nvalue,
+                            const double& abs_error_bound,
+                            const unsigned& row_length,
+                            std::vector<unsigned char>& buffer)
+ {
+  // No error allowed (or nothing sensible to quantise): Store raw
+  if (!(abs_error_bound>0.0))
+   {
+    append(buffer,unsigned(Raw));
+    append(buffer,nvalue);
+    append(buffer,value_pt,nvalue);
+    return;
+   }
+
+  // Quantise the prediction errors
+  //-------------------------------
+  // Symbol 0 is the escape code (value stored exactly); code q is
+  // stored as symbol q+Max_quantisation_code+1
+  double bin_width=2.0*abs_error_bound;
+  unsigned nsymbol=2*Max_quantisation_code+2;
+  std::vector<unsigned> symbol(nvalue);
+  std::vector<unsigned> frequency(nsymbol,0);
+  std::vector<double> reconstructed(nvalue);
+  std::vector<double> escaped;
+  for (unsigned i=0;i<nvalue;i++)
+   {
+    double prediction=predict(reconstructed,i,row_length);
+    double q=floor((value_pt[i]-prediction)/bin_width+0.5);
+    bool escape=true;
+    if (std::fabs(q)<=double(Max_quantisation_code))
+     {
+      double recon=prediction+bin_width*q;
+      if (std::fabs(recon-value_pt[i])<=abs_error_bound)
+       {
+        escape=false;
+        reconstructed[i]=recon;
+        symbol[i]=unsigned(int(q)+Max_quantisation_code+1);
+       }
+     }
+    if (escape)
+     {
+      reconstructed[i]=value_pt[i];
+      symbol[i]=0;
+      escaped.push_back(value_pt[i]);
+     }
+    frequency[symbol[i]]++;
+   }
+
+  // Huffman code
+  //-------------
+  std::vector<unsigned char> length;
+  huffman_code_lengths(frequency,length);
+  CanonicalHuffmanCode code;
+  code.setup(length);
+
+  // Encode the bitstream (most significant bit first)
+  std::vector<unsigned char> bits;
+  unsigned long nbit=0;
+  unsigned char current_byte=0;
+  for (unsigned i=0;i<nvalue;i++)
+   {
+    unsigned c=code.Code[symbol[i]];
+    unsigned l=length[symbol[i]];
+    for (int b=int(l)-1;b>=0;b--)
+     {
+      current_byte=(current_byte<<1)|((c>>b)&1);
+      nbit++;
+      if (nbit%8==0)
+       {
+        bits.push_back(current_byte);
+        current_byte=0;
+       }
+     }
+   }
+  if (nbit%8!=0)
+   {
+    current_byte<<=(8-nbit%8);
+    bits.push_back(current_byte);
+   }
+
+  // Write it all
+  //-------------
+  append(buffer,unsigned(Quantised));
+  append(buffer,nvalue);
+  append(buffer,abs_error_bound);
+  append(buffer,row_length);
+
+  // Escaped values
+  append(buffer,unsigned(escaped.size()));
+  if (!escaped.empty()) append(buffer,&escaped[0],escaped.size());
+
+  // Code table: (symbol, length) pairs for used symbols
+  unsigned nused=code.Sorted_symbol.size();
+  append(buffer,nused);
+  for (unsigned k=0;k<nused;k++)
+   {
+    append(buffer,code.Sorted_symbol[k]);
+    append(buffer,length[code.Sorted_symbol[k]]);
+   }
+
+  // Bitstream
+  append(buffer,nbit);
+  if (!bits.empty()) append(buffer,&bits[0],bits.size());
+ }
+
+
+ //=====================================================================
+ /// \short Decompress field that was compressed by compress_field(...),
+ /// reading from the current position of the reader.
+ //=====================================================================
+ inline void decompress_field(ByteReader& reader,
+                              std::vector<double>& value)
+ {
+  unsigned encoding=reader.read<unsigned>();
+  unsigned nvalue=reader.read<unsigned>();
+  value.resize(nvalue);
+  if (encoding==Raw)
+   {
+    if (nvalue!=0) reader.read(&value[0],nvalue);
+    return;
+   }
+  if (encoding!=Quantised)
+   {
+    throw std::runtime_error("Snapshot_Compression: Unknown encoding");
+   }
+
+  double abs_error_bound=reader.read<double>();
+  unsigned row_length=reader.read<unsigned>();
+  double bin_width=2.0*abs_error_bound;
+
+  // Escaped values
+  std::vector<double> escaped(reader.read<unsigned>());
+  if (!escaped.empty()) reader.read(&escaped[0],escaped.size());
+
+  // Rebuild canonical code
+  unsigned nsymbol=2*Max_quantisation_code+2;
+  std::vector<unsigned char> length(nsymbol,0);
+  unsigned nused=reader.read<unsigned>();
+  for (unsigned k=0;k<nused;k++)
+   {
+    unsigned sym=reader.read<unsigned>();
+    unsigned char l=reader.read<unsigned char>();
+    if ((sym>=nsymbol)||(l==0)||(l>Max_code_length))
+     {
+      throw std::runtime_error("Snapshot_Compression: Corrupt code table");
+     }
+    length[sym]=l;
+   }
+  CanonicalHuffmanCode code;
+  code.setup(length);
+
+  // Decode
+  unsigned long nbit=reader.read<unsigned long>();
+  const unsigned char* bits=reader.skip((nbit+7)/8);
+  unsigned long ibit=0;
+  unsigned iescaped=0;
+  for (unsigned i=0;i<nvalue;i++)
+   {
+    // Read bits until we have a valid code
+    unsigned c=0;
+    unsigned l=0;
+    unsigned sym=0;
+    bool found=false;
+    while (!found)
+     {
+      if ((ibit>=nbit)||(l>=Max_code_length))
+       {
+        throw std::runtime_error("Snapshot_Compression: Corrupt bitstream");
+       }
+      c=(c<<1)|((bits[ibit/8]>>(7-ibit%8))&1);
+      ibit++;
+      l++;
+      if ((code.Count[l]!=0)&&(c>=code.First_code[l])&&
+          (c-code.First_code[l]<code.Count[l]))
+       {
+        sym=code.Sorted_symbol[code.First_index[l]+c-code.First_code[l]];
+        found=true;
+       }
+     }
+
+    // Reconstruct
+    if (sym==0)
+     {
+      if (iescaped>=escaped.size())
+       {
+        throw std::runtime_error("Snapshot_Compression: Corrupt escapes");
+       }
+      value[i]=escaped[iescaped++];
+     }
+    else
+     {
+      double q=double(int(sym)-Max_quantisation_code-1);
+      value[i]=predict(value,i,row_length)+bin_width*q;
+     }
+   }
+ }
+
+
+
+ //=====================================================================
+ /// \short Mesh of Q2 quads, shared by all snapshots: nodal coordinates
+ /// and connectivity (nnode_per_element local nodes per element,
+ /// numbered lexicographically as in oomph-lib's QElements). Row_length
+ /// is the row length for the Lorenzo predictor (0 if nodes aren't
+ /// numbered lexicographically).
+ //=====================================================================
+ class SnapshotMesh
+ {
+ public:
+
+  /// Number of nodes
+  unsigned nnode() const {return X.size();}
+
+  /// Number of elements
+  unsigned nelement() const
+   {return Nnode_per_element==0 ? 0 : Connectivity.size()/Nnode_per_element;}
+
+  /// Append to buffer
+  void write(std::vector<unsigned char>& buffer) const
+   {
+    append(buffer,Mesh_magic,8);
+    append(buffer,nnode());
+    append(buffer,nelement());
+    append(buffer,Nnode_per_element);
+    append(buffer,Row_length);
+    if (nnode()!=0)
+     {
+      append(buffer,&X[0],nnode());
+      append(buffer,&Y[0],nnode());
+     }
+    if (!Connectivity.empty())
+     {
+      append(buffer,&Connectivity[0],Connectivity.size());
+     }
+   }
+
+  /// Read from reader
+  void read(ByteReader& reader)
+   {
+    char magic[8];
+    reader.read(magic,8);
+    if (memcmp(magic,Mesh_magic,8)!=0)
+     {
+      throw std::runtime_error("Snapshot_Compression: Not a snapshot mesh");
+     }
+    unsigned nnod=reader.read<unsigned>();
+    unsigned nel=reader.read<unsigned>();
+    Nnode_per_element=reader.read<unsigned>();
+    Row_length=reader.read<unsigned>();
+    X.resize(nnod);
+    Y.resize(nnod);
+    Connectivity.resize(nel*Nnode_per_element);
+    if (nnod!=0)
+     {
+      reader.read(&X[0],nnod);
+      reader.read(&Y[0],nnod);
+     }
+    if (!Connectivity.empty())
+     {
+      reader.read(&Connectivity[0],Connectivity.size());
+     }
+   }
+
+  /// Nodal x coordinates
+  std::vector<double> X;
+
+  /// Nodal y coordinates
+  std::vector<double> Y;
+
+  /// Number of nodes per element
+  unsigned Nnode_per_element;
+
+  /// Row length for Lorenzo predictor
+  unsigned Row_length;
+
+  /// Node numbers of the elements' local nodes
+  std::vector<unsigned> Connectivity;
+ };
+
+
+
+ //=====================================================================
+ /// \short Nodal fields at one instant: time, names and values
+ //=====================================================================
+ class Snapshot
+ {
+ public:
+
+  /// Time
+  double Time;
+
+  /// Field names
+  std::vector<std::string> Field_name;
+
+  /// Nodal values of fields: Field_value[i_field][j_node]
+  std::vector<std::vector<double> > Field_value;
+ };
+
+
+
+ //=====================================================================
+ /// \short Write whole buffer to file (throws on failure)
+ //=====================================================================
+ inline void write_buffer(const std::string& filename,
+                          const std::vector<unsigned char>& buffer)
+ {
+  FILE* file_pt=fopen(filename.c_str(),"wb");
+  bool ok=(file_pt!=0);
+  if (ok && (!buffer.empty()))
+   {
+    ok=(fwrite(&buffer[0],1,buffer.size(),file_pt)==buffer.size());
+   }
+  if (file_pt!=0) ok=(fclose(file_pt)==0)&&ok;
+  if (!ok)
+   {
+    throw std::runtime_error("Snapshot_Compression: Couldn't write "+
+                             filename);
+   }
+ }
+
+ //=====================================================================
+ /// \short Read whole file into buffer (throws on failure)
+ //=====================================================================
+ inline void read_buffer(const std::string& filename,
+                         std::vector<unsigned char>& buffer)
+ {
+  FILE* file_pt=fopen(filename.c_str(),"rb");
+  if (file_pt==0)
+   {
+    throw std::runtime_error("Snapshot_Compression: Couldn't open "+
+                             filename);
+   }
+  fseek(file_pt,0,SEEK_END);
+  long size=ftell(file_pt);
+  fseek(file_pt,0,SEEK_SET);
+  buffer.resize(size);
+  bool ok=(size==0)||(fread(&buffer[0],1,size,file_pt)==size_t(size));
+  fclose(file_pt);
+  if (!ok)
+   {
+    throw std::runtime_error("Snapshot_Compression: Couldn't read "+
+                             filename);
+   }
+ }
+
+
+ //=====================================================================
+ /// \short Compress snapshot and append it to the buffer.
+ /// error_bound[i_field] is the absolute error bound for the field or,
+ /// if relative is true, the error bound relative to the field's
+ /// range of values. Zero bound: field is stored exactly.
+ //=====================================================================
+ inline void compress_snapshot(const Snapshot& snapshot,
+                               const std::vector<double>& error_bound,
+                               const bool& relative,
+                               const unsigned& row_length,
+                               std::vector<unsigned char>& buffer)
+ {
+  unsigned nfield=snapshot.Field_value.size();
+  append(buffer,Snapshot_magic,8);
+  append(buffer,snapshot.Time);
+  append(buffer,nfield);
+  for (unsigned i=0;i<nfield;i++)
+   {
+    char name[Field_name_length];
+    memset(name,0,Field_name_length);
+    strncpy(name,snapshot.Field_name[i].c_str(),Field_name_length-1);
+    append(buffer,name,Field_name_length);
+
+    unsigned nvalue=snapshot.Field_value[i].size();
+    const double* value_pt=
+     (nvalue==0) ? 0 : &snapshot.Field_value[i][0];
+    double abs_error_bound=
+     absolute_error_bound(value_pt,nvalue,error_bound[i],relative);
+    compress_field(value_pt,nvalue,abs_error_bound,row_length,buffer);
+   }
+ }
+
+
+ //=====================================================================
+ /// \short Decompress snapshot written by compress_snapshot(...)
+ //=====================================================================
+ inline void decompress_snapshot(ByteReader& reader, Snapshot& snapshot)
+ {
+  char magic[8];
+  reader.read(magic,8);
+  if (memcmp(magic,Snapshot_magic,8)!=0)
+   {
+    throw std::runtime_error(
+     "Snapshot_Compression: Not a compressed snapshot");
+   }
+  snapshot.Time=reader.read<double>();
+  unsigned nfield=reader.read<unsigned>();
+  snapshot.Field_name.resize(nfield);
+  snapshot.Field_value.resize(nfield);
+  for (unsigned i=0;i<nfield;i++)
+   {
+    char name[Field_name_length];
+    reader.read(name,Field_name_length);
+    name[Field_name_length-1]=0;
+    snapshot.Field_name[i]=name;
+    decompress_field(reader,snapshot.Field_value[i]);
+   }
+ }
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,298 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Decompress snapshots written by anne --compressed_output, or extract
+// them from the archive written by anne --snapshot_archive, into
+// Tecplot (.dat) or VTK unstructured grid (.vtu) files for paraview:
+//
+//    snapshot_convert snapshot_mesh.bin soln5.snp soln5.vtu
+//    snapshot_convert snapshot_mesh.bin soln5.snp soln5.dat
+//    snapshot_convert --archive soln_archive.bin 5 soln5.vtu
+//    snapshot_convert --archive soln_archive.bin all soln.vtu
+//
+// (the latter writes soln0.vtu, soln1.vtu, ...). Doesn't require
+// oomph-lib.
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+
+#include "snapshot_compression.h"
+#include "snapshot_archive.h"
+
+using namespace std;
+using namespace Snapshot_Compression;
+
+
+//======================================================================
+/// \short Write snapshot as Tecplot FE zone: Each Q2 element is split
+/// into four bilinear quads.
+//======================================================================
+void write_tecplot(const SnapshotMesh& mesh, const Snapshot& snapshot,
+                   std::ostream& outfile)
+{
+ unsigned nnod=mesh.nnode();
+ unsigned nel=mesh.nelement();
+ unsigned nfield=snapshot.Field_value.size();
+ if (mesh.Nnode_per_element!=9)
+  {
+   throw std::runtime_error("Tecplot output only works for Q2 elements");
+  }
+
+ outfile << "VARIABLES=\"x\",\"y\"";
+ for (unsigned i=0;i<nfield;i++)
+  {
+   outfile << ",\"" << snapshot.Field_name[i] << "\"";
+  }
+ outfile << "\n";
+ outfile << "ZONE T=\"time=" << snapshot.Time << "\", N=" << nnod
+         << ", E=" << 4*nel << ", F=FEPOINT, ET=QUADRILATERAL\n";
+ outfile << "SOLUTIONTIME=" << snapshot.Time << "\n";
+ for (unsigned j=0;j<nnod;j++)
+  {
+   outfile << mesh.X[j] << " " << mesh.Y[j];
+   for (unsigned i=0;i<nfield;i++)
+    {
+     outfile << " " << snapshot.Field_value[i][j];
+    }
+   outfile << "\n";
+  }
+
+ // Sub-quads (Tecplot node numbers start at 1)
+ for (unsigned e=0;e<nel;e++)
+  {
+   const unsigned* con=&mesh.Connectivity[9*e];
+   for (unsigned j=0;j<2;j++)
+    {
+     for (unsigned i=0;i<2;i++)
+      {
+       outfile << con[i+3*j]+1 << " " << con[i+1+3*j]+1 << " "
+               << con[i+1+3*(j+1)]+1 << " " << con[i+3*(j+1)]+1 << "\n";
+      }
+    }
+  }
+}
+
+
+
+//======================================================================
+/// \short Write snapshot as VTK unstructured grid of biquadratic quads
+//======================================================================
+void write_vtu(const SnapshotMesh& mesh, const Snapshot& snapshot,
+               std::ostream& outfile)
+{
+ unsigned nnod=mesh.nnode();
+ unsigned nel=mesh.nelement();
+ unsigned nfield=snapshot.Field_value.size();
+ if (mesh.Nnode_per_element!=9)
+  {
+   throw std::runtime_error("VTU output only works for Q2 elements");
+  }
+
+ // VTK's ordering of the local nodes of a biquadratic quad: corners,
+ // midside nodes, centre
+ unsigned vtk_order[9]={0,2,8,6,1,5,7,3,4};
+
+ outfile << "<?xml version=\"1.0\"?>\n"
+         << "<VTKFile type=\"UnstructuredGrid\" version=\"0.1\">\n"
+         << "<UnstructuredGrid>\n"
+         << "<FieldData>\n"
+         << "<DataArray type=\"Float64\" Name=\"TimeValue\" "
+         << "NumberOfTuples=\"1\" format=\"ascii\">" << snapshot.Time
+         << "</DataArray>\n"
+         << "</FieldData>\n"
+         << "<Piece NumberOfPoints=\"" << nnod
+         << "\" NumberOfCells=\"" << nel << "\">\n";
+
+ // Fields
+ outfile << "<PointData>\n";
+ for (unsigned i=0;i<nfield;i++)
+  {
+   outfile << "<DataArray type=\"Float64\" Name=\""
+           << snapshot.Field_name[i] << "\" format=\"ascii\">\n";
+   for (unsigned j=0;j<nnod;j++)
+    {
+     outfile << snapshot.Field_value[i][j] << "\n";
+    }
+   outfile << "</DataArray>\n";
+  }
+ outfile << "</PointData>\n";
+
+ // Points
+ outfile << "<Points>\n"
+         << "<DataArray type=\"Float64\" NumberOfComponents=\"3\" "
+         << "format=\"ascii\">\n";
+ for (unsigned j=0;j<nnod;j++)
+  {
+   outfile << mesh.X[j] << " " << mesh.Y[j] << " 0\n";
+  }
+ outfile << "</DataArray>\n"
+         << "</Points>\n";
+
+ // Cells
+ outfile << "<Cells>\n"
+         << "<DataArray type=\"Int32\" Name=\"connectivity\" "
+         << "format=\"ascii\">\n";
+ for (unsigned e=0;e<nel;e++)
+  {
+   for (unsigned l=0;l<9;l++)
+    {
+     outfile << mesh.Connectivity[9*e+vtk_order[l]] << " ";
+    }
+   outfile << "\n";
+  }
+ outfile << "</DataArray>\n"
+         << "<DataArray type=\"Int32\" Name=\"offsets\" format=\"ascii\">\n";
+ for (unsigned e=0;e<nel;e++)
+  {
+   outfile << 9*(e+1) << "\n";
+  }
+ outfile << "</DataArray>\n"
+         << "<DataArray type=\"UInt8\" Name=\"types\" format=\"ascii\">\n";
+ for (unsigned e=0;e<nel;e++)
+  {
+   // VTK_BIQUADRATIC_QUAD
+   outfile << "28\n";
+  }
+ outfile << "</DataArray>\n"
+         << "</Cells>\n"
+         << "</Piece>\n"
+         << "</UnstructuredGrid>\n"
+         << "</VTKFile>\n";
+}
+
+
+
+//======================================================================
+/// \short Write snapshot in format determined by extension of filename
+//======================================================================
+void write_snapshot(const SnapshotMesh& mesh, const Snapshot& snapshot,
+                    const std::string& filename)
+{
+ ofstream outfile(filename.c_str());
+ outfile << setprecision(16);
+ if ((filename.size()>4)&&(filename.substr(filename.size()-4)==".vtu"))
+  {
+   write_vtu(mesh,snapshot,outfile);
+  }
+ else
+  {
+   write_tecplot(mesh,snapshot,outfile);
+  }
+}
+
+
+
+//======================================================================
+/// \short Extract step(s) from archive: step_string is the step number 
+/// or "all"; in the latter case the step number is inserted before the
+/// extension of the output filename.
+//======================================================================
+void convert_archive(const std::string& archive_filename,
+                     const std::string& step_string,
+                     const std::string& filename)
+{
+ SnapshotArchiveReader archive(archive_filename);
+ Snapshot snapshot;
+ if (step_string=="all")
+  {
+   size_t dot=filename.rfind('.');
+   std::string stem=filename.substr(0,dot);
+   std::string extension=
+    (dot==std::string::npos) ? std::string("") : filename.substr(dot);
+   unsigned nstep=archive.nstep();
+   for (unsigned step=0;step<nstep;step++)
+    {
+     std::ostringstream step_filename;
+     step_filename << stem << step << extension;
+     archive.get_snapshot(step,snapshot);
+     write_snapshot(archive.mesh(),snapshot,step_filename.str());
+    }
+  }
+ else
+  {
+   unsigned step=atoi(step_string.c_str());
+   archive.get_snapshot(step,snapshot);
+   write_snapshot(archive.mesh(),snapshot,filename);
+  }
+}
+
+
+
+//======================================================================
+/// Driver
+//======================================================================
+int main(int argc, char* argv[])
+{
+ if ((argc==5)&&(std::string(argv[1])=="--archive"))
+  {
+   try
+    {
+     convert_archive(argv[2],argv[3],argv[4]);
+    }
+   catch (std::exception& error)
+    {
+     cerr << "Error: " << error.what() << endl;
+     return 1;
+    }
+   return 0;
+  }
+
+ if (argc!=4)
+  {
+   cerr << "Usage: " << argv[0]
+        << " snapshot_mesh.bin snapshot.snp output.[dat|vtu]\n"
+        << "   or: " << argv[0] 
+        << " --archive soln_archive.bin [step|all] output.[dat|vtu]" 
+        << endl;
+   return 1;
+  }
+
+ try
+  {
+   // Read mesh
+   std::vector<unsigned char> buffer;
+   read_buffer(argv[1],buffer);
+   SnapshotMesh mesh;
+   ByteReader mesh_reader(&buffer[0],buffer.size());
+   mesh.read(mesh_reader);
+
+   // Read and decompress snapshot
+   read_buffer(argv[2],buffer);
+   Snapshot snapshot;
+   ByteReader snapshot_reader(&buffer[0],buffer.size());
+   decompress_snapshot(snapshot_reader,snapshot);
+
+   // Write it
+   write_snapshot(mesh,snapshot,argv[3]);
+  }
+ catch (std::exception& error)
+  {
+   cerr << "Error: " << error.what() << endl;
+   return 1;
+  }
+ return 0;
+}
@@ -0,0 +1,216 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Per-timestep log of the solver's work (Newton and GMRES iterations,
+// residuals) and of the time spent in the various phases (assembly,
+// preconditioner setup, linear solves, vorticity recovery, output),
+// written as one CSV line per timestep. Lists (the residuals after each
+// Newton step, the GMRES iterations in each linear solve) are written
+// as semicolon-separated values in a single column. Doesn't require
+// oomph-lib.
+
+#ifndef SOLVER_TELEMETRY_HEADER
+#define SOLVER_TELEMETRY_HEADER
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace oomph
+{
+
+//======================================================================
+/// \short Accumulates the solver statistics and phase timings during a
+/// timestep and writes them as a line of a CSV file
+//======================================================================
+class SolverTelemetry
+{
+
+public:
+
+ /// Constructor: Not writing to a file (yet)
+ SolverTelemetry() : Outfile_pt(0)
+  {
+   reset();
+  }
+
+ /// Destructor: Close the file
+ ~SolverTelemetry()
+  {
+   delete Outfile_pt;
+  }
+
+ /// \short Open the CSV file (append to it if append is true and the
+ /// file exists, e.g. after a restart; otherwise start a new one with a
+ /// header line)
+ void open(const std::string& filename, const bool& append)
+  {
+   delete Outfile_pt;
+   bool write_header=true;
+   if (append)
+    {
+     std::ifstream existing_file(filename.c_str());
+     write_header=!existing_file.good();
+    }
+   Outfile_pt=new std::ofstream(filename.c_str(),
+                                append ? std::ios::app : std::ios::out);
+   if (write_header)
+    {
+     (*Outfile_pt) << "step,time,dt,n_attempt,n_newton,max_residuals,"
+                   << "gmres_iterations,t_jacobian,t_residuals,"
+                   << "t_preconditioner_setup,t_linear_solve,t_recovery,"
+                   << "t_output,t_step" << std::endl;
+    }
+  }
+
+ /// Start recording a new timestep (at the given wall clock time)
+ void start_timestep(const double& wall_time)
+  {
+   reset();
+   Step_start_time=wall_time;
+  }
+
+ /// Count an attempt at an implicit timestep
+ void add_attempt() {Nattempt++;}
+
+ /// Count a Newton step
+ void add_newton_step() {Nnewton++;}
+
+ /// Record the max. residual (at the start or after a Newton step)
+ void add_max_residual(const double& max_res)
+  {
+   Max_residual.push_back(max_res);
+  }
+
+ /// \short Record the number of GMRES iterations in a linear solve
+ /// (all applications of the Jacobian, i.e. with GCRO-DR including 
+ /// those for the recycled space)
+ void add_gmres_iterations(const unsigned& niter)
+  {
+   Gmres_iterations.push_back(niter);
+  }
+
+ /// Add time for assembly of the Jacobian (and residuals)
+ void add_jacobian_time(const double& t) {Jacobian_time+=t;}
+
+ /// Add time for assembly of the residuals
+ void add_residual_time(const double& t) {Residual_time+=t;}
+
+ /// Add time for setup of the preconditioner
+ void add_preconditioner_setup_time(const double& t)
+  {Preconditioner_setup_time+=t;}
+
+ /// Add time for linear solve
+ void add_linear_solve_time(const double& t) {Linear_solve_time+=t;}
+
+ /// Add time for recovery of the vorticity
+ void add_recovery_time(const double& t) {Recovery_time+=t;}
+
+ /// Add time for output (excluding the recovery of the vorticity)
+ void add_output_time(const double& t) {Output_time+=t;}
+
+ /// \short Write the line for the timestep (finished at the given wall
+ /// clock time)
+ void write_timestep(const unsigned& step, const double& time,
+                     const double& dt, const double& wall_time)
+  {
+   if (Outfile_pt==0) return;
+   std::ofstream& outfile=*Outfile_pt;
+   outfile << step << "," << time << "," << dt << "," << Nattempt << ","
+           << Nnewton << ",";
+   for (unsigned i=0;i<Max_residual.size();i++)
+    {
+     outfile << (i>0 ? ";" : "") << Max_residual[i];
+    }
+   outfile << ",";
+   for (unsigned i=0;i<Gmres_iterations.size();i++)
+    {
+     outfile << (i>0 ? ";" : "") << Gmres_iterations[i];
+    }
+   outfile << "," << Jacobian_time << "," << Residual_time << ","
+           << Preconditioner_setup_time << "," << Linear_solve_time << ","
+           << Recovery_time << "," << Output_time << ","
+           << wall_time-Step_start_time << std::endl;
+  }
+
+private:
+
+ /// Reset the statistics for a new timestep
+ void reset()
+  {
+   Nattempt=0;
+   Nnewton=0;
+   Max_residual.clear();
+   Gmres_iterations.clear();
+   Jacobian_time=0.0;
+   Residual_time=0.0;
+   Preconditioner_setup_time=0.0;
+   Linear_solve_time=0.0;
+   Recovery_time=0.0;
+   Output_time=0.0;
+   Step_start_time=0.0;
+  }
+
+ /// The CSV file (null if not open)
+ std::ofstream* Outfile_pt;
+
+ /// Number of attempts at implicit timesteps (>1 if steps are rejected)
+ unsigned Nattempt;
+
+ /// Number of Newton steps (in all attempts)
+ unsigned Nnewton;
+
+ /// Max. residuals at the start and after each Newton step
+ std::vector<double> Max_residual;
+
+ /// Number of GMRES iterations in each linear solve
+ std::vector<unsigned> Gmres_iterations;
+
+ /// Time for assembly of the Jacobian (and residuals)
+ double Jacobian_time;
+
+ /// Time for assembly of the residuals only
+ double Residual_time;
+
+ /// Time for setup of the preconditioner
+ double Preconditioner_setup_time;
+
+ /// Time for linear solves
+ double Linear_solve_time;
+
+ /// Time for recovery of the vorticity
+ double Recovery_time;
+
+ /// Time for output
+ double Output_time;
+
+ /// Wall clock time at the start of the timestep
+ double Step_start_time;
+
+};
+
+} // end of namespace oomph
+
+#endif
@@ -0,0 +1,799 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Static condensation of the unknowns at element-interior nodes (the
+// centre nodes of Q2 elements). The values at such a node are only
+// coupled to the unknowns of its own element, so they can be eliminated
+// element by element. With the interior (I) and retained (B) unknowns
+// separated, the system
+//
+//     [ A_BB  A_BI ] [x_B]   [r_B]
+//     [ A_IB  A_II ] [x_I] = [r_I]
+//
+// is solved as
+//
+//     (A_BB - A_BI A_II^{-1} A_IB) x_B = r_B - A_BI A_II^{-1} r_I
+//     x_I = A_II^{-1} (r_I - A_IB x_B)
+//
+// where A_II is block diagonal, with one small dense block per interior
+// node. The reduced system is smaller and its factorisation has less
+// fill. The elimination works on the assembled matrix (the entries of the
+// interior rows and columns all come from a single element), so it
+// doesn't affect the Problem's equation numbering. It's used either for
+// the monolithic direct solve or for the (direct) solves with the
+// diagonal blocks of the momentum block in the block preconditioner.
+// Serial problems only.
+
+#ifndef STATIC_CONDENSATION_HEADER
+#define STATIC_CONDENSATION_HEADER
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <sstream>
+
+#include "multilevel_helpers.h"
+
+namespace oomph
+{
+
+//======================================================================
+/// \short Elimination of groups of "interior" rows/columns from a
+/// square sparse matrix, each group only being coupled to itself and to
+/// the retained rows. Provides the reduced matrix, the condensation of
+/// right-hand sides and the recovery of the eliminated unknowns.
+//======================================================================
+class StaticCondensation
+{
+
+public:
+
+ /// Empty constructor
+ StaticCondensation() : Nrow(0) {}
+
+ /// Number of rows of the full matrix
+ unsigned nrow() const {return Nrow;}
+
+ /// Number of eliminated rows
+ unsigned ninterior() const {return Interior_row.size();}
+
+ /// Number of rows of the reduced matrix
+ unsigned nreduced() const {return Retained_row.size();}
+
+ /// \short The nodes of the mesh that are only used by a single
+ /// element and are neither on a boundary nor hanging, i.e. the
+ /// element-interior nodes
+ static void get_interior_nodes(Mesh* mesh_pt, 
+                                std::vector<Node*>& interior_node_pt)
+  {
+   std::map<Node*,unsigned> nelement_of_node;
+   unsigned nel=mesh_pt->nelement();
+   for (unsigned e=0;e<nel;e++)
+    {
+     FiniteElement* el_pt=mesh_pt->finite_element_pt(e);
+     unsigned nnod=el_pt->nnode();
+     for (unsigned j=0;j<nnod;j++)
+      {
+       nelement_of_node[el_pt->node_pt(j)]++;
+      }
+    }
+   interior_node_pt.clear();
+   unsigned nnod=mesh_pt->nnode();
+   for (unsigned j=0;j<nnod;j++)
+    {
+     Node* nod_pt=mesh_pt->node_pt(j);
+     if ((nelement_of_node[nod_pt]==1)&&(!nod_pt->is_on_boundary())&&
+         (!nod_pt->is_hanging()))
+      {
+       interior_node_pt.push_back(nod_pt);
+      }
+    }
+  }
+
+ /// \short Eliminate the groups of interior rows (and the corresponding
+ /// columns) from the square matrix a; the reduced matrix (for the
+ /// retained rows, in their original order) is returned in reduced.
+ void setup(const Multilevel_Helpers::CSRMatrix<double>& a,
+            const std::vector<std::vector<unsigned> >& interior_group,
+            Multilevel_Helpers::CSRMatrix<double>& reduced)
+  {
+   // Number the interior rows group by group, and the retained rows
+   Nrow=a.nrow();
+   unsigned ngroup=interior_group.size();
+   Group_start.assign(ngroup+1,0);
+   Interior_row.clear();
+   std::vector<int> interior_index(Nrow,-1);
+   std::vector<int> group_of_row(Nrow,-1);
+   for (unsigned g=0;g<ngroup;g++)
+    {
+     unsigned m=interior_group[g].size();
+     for (unsigned l=0;l<m;l++)
+      {
+       unsigned row=interior_group[g][l];
+       interior_index[row]=Interior_row.size();
+       group_of_row[row]=g;
+       Interior_row.push_back(row);
+      }
+     Group_start[g+1]=Interior_row.size();
+    }
+   Reduced_index.assign(Nrow,-1);
+   Retained_row.clear();
+   for (unsigned i=0;i<Nrow;i++)
+    {
+     if (interior_index[i]<0)
+      {
+       Reduced_index[i]=Retained_row.size();
+       Retained_row.push_back(i);
+      }
+    }
+   unsigned nreduced=Retained_row.size();
+   unsigned ninterior=Interior_row.size();
+
+   // Interior rows: diagonal blocks A_II and couplings A_IB
+   std::vector<std::vector<double> > a_ii(ngroup);
+   for (unsigned g=0;g<ngroup;g++)
+    {
+     unsigned m=Group_start[g+1]-Group_start[g];
+     a_ii[g].assign(m*m,0.0);
+    }
+   A_ib.resize(ninterior,nreduced);
+   for (unsigned p=0;p<ninterior;p++)
+    {
+     unsigned row=Interior_row[p];
+     unsigned g=group_of_row[row];
+     unsigned m=Group_start[g+1]-Group_start[g];
+     unsigned l=p-Group_start[g];
+     for (int k=a.Row_start[row];k<a.Row_start[row+1];k++)
+      {
+       unsigned col=a.Column_index[k];
+       if (interior_index[col]<0)
+        {
+         A_ib.Column_index.push_back(Reduced_index[col]);
+         A_ib.Value.push_back(a.Value[k]);
+        }
+       else if (group_of_row[col]==int(g))
+        {
+         a_ii[g][l*m+interior_index[col]-Group_start[g]]+=a.Value[k];
+        }
+       else
+        {
+         std::ostringstream error_stream;
+         error_stream << "Interior row " << row << " is coupled to interior "
+                      << "row " << col << " of another group." << std::endl;
+         throw OomphLibError(error_stream.str(),
+                             OOMPH_CURRENT_FUNCTION,
+                             OOMPH_EXCEPTION_LOCATION);
+        }
+      }
+     A_ib.Row_start[p+1]=A_ib.Column_index.size();
+    }
+
+   // Retained rows: A_BB (the start of the reduced matrix, stored as
+   // triplets) and the couplings A_BI, stored as their transpose
+   std::vector<unsigned> triplet_row;
+   std::vector<int> triplet_column;
+   std::vector<double> triplet_value;
+   A_bi_transpose.resize(ninterior,nreduced);
+   std::vector<int>& bi_start=A_bi_transpose.Row_start;
+   for (unsigned b=0;b<nreduced;b++)
+    {
+     unsigned row=Retained_row[b];
+     for (int k=a.Row_start[row];k<a.Row_start[row+1];k++)
+      {
+       int p=interior_index[a.Column_index[k]];
+       if (p<0)
+        {
+         triplet_row.push_back(b);
+         triplet_column.push_back(Reduced_index[a.Column_index[k]]);
+         triplet_value.push_back(a.Value[k]);
+        }
+       else
+        {
+         bi_start[p+1]++;
+        }
+      }
+    }
+   for (unsigned p=0;p<ninterior;p++)
+    {
+     bi_start[p+1]+=bi_start[p];
+    }
+   A_bi_transpose.Column_index.resize(bi_start[ninterior]);
+   A_bi_transpose.Value.resize(bi_start[ninterior]);
+   std::vector<int> next(bi_start.begin(),bi_start.end()-1);
+   for (unsigned b=0;b<nreduced;b++)
+    {
+     unsigned row=Retained_row[b];
+     for (int k=a.Row_start[row];k<a.Row_start[row+1];k++)
+      {
+       int p=interior_index[a.Column_index[k]];
+       if (p>=0)
+        {
+         A_bi_transpose.Column_index[next[p]]=b;
+         A_bi_transpose.Value[next[p]]=a.Value[k];
+         next[p]++;
+        }
+      }
+    }
+
+   // Eliminate group by group: subtract A_BI A_II^{-1} A_IB
+   Interior_lu.resize(ngroup);
+   std::vector<int> column;
+   std::vector<double> w;
+   std::vector<double> x;
+   for (unsigned g=0;g<ngroup;g++)
+    {
+     unsigned m=Group_start[g+1]-Group_start[g];
+     Interior_lu[g].factorise(m,a_ii[g]);
+
+     // Retained columns coupled to the group
+     column.clear();
+     for (unsigned p=Group_start[g];p<Group_start[g+1];p++)
+      {
+       for (int k=A_ib.Row_start[p];k<A_ib.Row_start[p+1];k++)
+        {
+         if (std::find(column.begin(),column.end(),A_ib.Column_index[k])==
+             column.end())
+          {
+           column.push_back(A_ib.Column_index[k]);
+          }
+        }
+      }
+     unsigned ncol=column.size();
+
+     // w = A_II^{-1} A_IB (dense, column by column)
+     w.assign(m*ncol,0.0);
+     for (unsigned p=Group_start[g];p<Group_start[g+1];p++)
+      {
+       unsigned l=p-Group_start[g];
+       for (int k=A_ib.Row_start[p];k<A_ib.Row_start[p+1];k++)
+        {
+         unsigned c=std::find(column.begin(),column.end(),
+                              A_ib.Column_index[k])-column.begin();
+         w[l*ncol+c]+=A_ib.Value[k];
+        }
+      }
+     x.resize(m);
+     for (unsigned c=0;c<ncol;c++)
+      {
+       for (unsigned l=0;l<m;l++)
+        {
+         x[l]=w[l*ncol+c];
+        }
+       Interior_lu[g].solve(&x[0]);
+       for (unsigned l=0;l<m;l++)
+        {
+         w[l*ncol+c]=x[l];
+        }
+      }
+
+     // Fill in the reduced matrix
+     for (unsigned p=Group_start[g];p<Group_start[g+1];p++)
+      {
+       unsigned l=p-Group_start[g];
+       for (int k=A_bi_transpose.Row_start[p];
+            k<A_bi_transpose.Row_start[p+1];k++)
+        {
+         for (unsigned c=0;c<ncol;c++)
+          {
+           triplet_row.push_back(A_bi_transpose.Column_index[k]);
+           triplet_column.push_back(column[c]);
+           triplet_value.push_back(-A_bi_transpose.Value[k]*w[l*ncol+c]);
+          }
+        }
+      }
+    }
+
+   // Assemble the reduced matrix from the triplets (adding up the
+   // contributions to the same entry)
+   reduced.resize(nreduced,nreduced);
+   unsigned ntriplet=triplet_row.size();
+   for (unsigned t=0;t<ntriplet;t++)
+    {
+     reduced.Row_start[triplet_row[t]+1]++;
+    }
+   for (unsigned b=0;b<nreduced;b++)
+    {
+     reduced.Row_start[b+1]+=reduced.Row_start[b];
+    }
+   reduced.Column_index.resize(ntriplet);
+   reduced.Value.resize(ntriplet);
+   next.assign(reduced.Row_start.begin(),reduced.Row_start.end()-1);
+   for (unsigned t=0;t<ntriplet;t++)
+    {
+     int k=next[triplet_row[t]]++;
+     reduced.Column_index[k]=triplet_column[t];
+     reduced.Value[k]=triplet_value[t];
+    }
+   reduced.sort_rows();
+  }
+
+ /// \short Condense the right-hand side of the full system:
+ /// reduced_rhs = r_B - A_BI A_II^{-1} r_I
+ void condense_rhs(const double* rhs, double* reduced_rhs) const
+  {
+   unsigned nreduced=Retained_row.size();
+   for (unsigned b=0;b<nreduced;b++)
+    {
+     reduced_rhs[b]=rhs[Retained_row[b]];
+    }
+   unsigned ninterior=Interior_row.size();
+   if (ninterior==0) return;
+   std::vector<double> y(ninterior);
+   for (unsigned p=0;p<ninterior;p++)
+    {
+     y[p]=rhs[Interior_row[p]];
+    }
+   solve_interior(y);
+   for (unsigned p=0;p<ninterior;p++)
+    {
+     for (int k=A_bi_transpose.Row_start[p];
+          k<A_bi_transpose.Row_start[p+1];k++)
+      {
+       reduced_rhs[A_bi_transpose.Column_index[k]]-=
+        A_bi_transpose.Value[k]*y[p];
+      }
+    }
+  }
+
+ /// \short Assemble the solution of the full system from the solution
+ /// of the reduced system and the right-hand side of the full system:
+ /// x_I = A_II^{-1} (r_I - A_IB x_B)
+ void recover(const double* rhs, const double* reduced_solution,
+              double* solution) const
+  {
+   unsigned nreduced=Retained_row.size();
+   for (unsigned b=0;b<nreduced;b++)
+    {
+     solution[Retained_row[b]]=reduced_solution[b];
+    }
+   unsigned ninterior=Interior_row.size();
+   if (ninterior==0) return;
+   std::vector<double> r(ninterior);
+   for (unsigned p=0;p<ninterior;p++)
+    {
+     r[p]=rhs[Interior_row[p]];
+    }
+   std::vector<double> y(ninterior);
+   A_ib.residual(&r[0],reduced_solution,&y[0]);
+   solve_interior(y);
+   for (unsigned p=0;p<ninterior;p++)
+    {
+     solution[Interior_row[p]]=y[p];
+    }
+  }
+
+ /// \short Copy a CSRMatrix into oomph-lib's CRDoubleMatrix (with the
+ /// given distribution)
+ static void copy_to_cr_matrix(
+  const Multilevel_Helpers::CSRMatrix<double>& a,
+  const LinearAlgebraDistribution* dist_pt, CRDoubleMatrix& a_cr)
+  {
+   unsigned nnz=a.nnz();
+   double* value=new double[std::max(nnz,1u)];
+   std::copy(a.Value.begin(),a.Value.end(),value);
+   int* column_index=new int[std::max(nnz,1u)];
+   std::copy(a.Column_index.begin(),a.Column_index.end(),column_index);
+   int* row_start=new int[a.nrow()+1];
+   std::copy(a.Row_start.begin(),a.Row_start.end(),row_start);
+   a_cr.build(dist_pt);
+   a_cr.build_without_copy(a.ncol(),nnz,value,column_index,row_start);
+  }
+
+ /// Copy oomph-lib's (serial) CRDoubleMatrix into a CSRMatrix
+ static void copy_from_cr_matrix(CRDoubleMatrix* cr_matrix_pt,
+                                 Multilevel_Helpers::CSRMatrix<double>& a)
+  {
+   unsigned nrow=cr_matrix_pt->nrow();
+   unsigned nnz=cr_matrix_pt->nnz();
+   const int* row_start=cr_matrix_pt->row_start();
+   const int* column_index=cr_matrix_pt->column_index();
+   const double* value=cr_matrix_pt->value();
+   a.resize(nrow,cr_matrix_pt->ncol());
+   a.Row_start.assign(row_start,row_start+nrow+1);
+   a.Column_index.assign(column_index,column_index+nnz);
+   a.Value.assign(value,value+nnz);
+  }
+
+private:
+
+ /// Solve with the diagonal blocks A_II (in place)
+ void solve_interior(std::vector<double>& y) const
+  {
+   unsigned ngroup=Interior_lu.size();
+   for (unsigned g=0;g<ngroup;g++)
+    {
+     if (Group_start[g+1]>Group_start[g])
+      {
+       Interior_lu[g].solve(&y[Group_start[g]]);
+      }
+    }
+  }
+
+ /// Number of rows of the full matrix
+ unsigned Nrow;
+
+ /// \short Start of each group in the numbering of the interior rows
+ /// (ngroup+1 entries)
+ std::vector<unsigned> Group_start;
+
+ /// Row in the full matrix for each interior row
+ std::vector<unsigned> Interior_row;
+
+ /// Row in the full matrix for each row of the reduced matrix
+ std::vector<unsigned> Retained_row;
+
+ /// Row in the reduced matrix for each row (-1 if it's eliminated)
+ std::vector<int> Reduced_index;
+
+ /// LU factors of the diagonal blocks A_II
+ std::vector<Multilevel_Helpers::DenseLU<double> > Interior_lu;
+
+ /// Couplings of the interior rows to the retained unknowns
+ Multilevel_Helpers::CSRMatrix<double> A_ib;
+
+ /// \short Couplings of the retained rows to the interior unknowns,
+ /// transposed (one row per interior unknown)
+ Multilevel_Helpers::CSRMatrix<double> A_bi_transpose;
+
+};
+
+
+
+//======================================================================
+/// \short Direct solver for the linear systems of the Newton iteration
+/// with static condensation of the unknowns at the element-interior
+/// nodes of the mesh. The reduced system is solved with SuperLU.
+//======================================================================
+class StaticCondensationSolver : public LinearSolver
+{
+
+public:
+
+ /// Constructor: Pass the mesh
+ StaticCondensationSolver(Mesh* mesh_pt) : Mesh_pt(mesh_pt) {}
+
+ /// Destructor
+ ~StaticCondensationSolver()
+  {
+   clean_up_memory();
+  }
+
+ /// Broken copy constructor
+ StaticCondensationSolver(const StaticCondensationSolver&)
+  {
+   BrokenCopy::broken_copy("StaticCondensationSolver");
+  }
+
+ /// Broken assignment operator
+ void operator=(const StaticCondensationSolver&)
+  {
+   BrokenCopy::broken_assign("StaticCondensationSolver");
+  }
+
+ /// \short Solve the linear system in the Newton iteration of the
+ /// problem
+ void solve(Problem* const& problem_pt, DoubleVector& result)
+  {
+   double t_start=TimingHelpers::timer();
+   DoubleVector residuals;
+   CRDoubleMatrix jacobian;
+   problem_pt->get_jacobian(residuals,jacobian);
+   Jacobian_setup_time=TimingHelpers::timer()-t_start;
+   solve(&jacobian,residuals,result);
+  }
+
+ /// \short Solve the linear system (the factorisation of the reduced
+ /// system is kept for resolves if they are enabled)
+ void solve(DoubleMatrixBase* const& matrix_pt, const DoubleVector& rhs,
+            DoubleVector& result)
+  {
+   double t_start=TimingHelpers::timer();
+   CRDoubleMatrix* cr_matrix_pt=dynamic_cast<CRDoubleMatrix*>(matrix_pt);
+   if (cr_matrix_pt==0)
+    {
+     throw OomphLibError("StaticCondensationSolver needs CRDoubleMatrix",
+                         OOMPH_CURRENT_FUNCTION,
+                         OOMPH_EXCEPTION_LOCATION);
+    }
+#ifdef PARANOID
+   if (cr_matrix_pt->distributed())
+    {
+     throw OomphLibError(
+      "StaticCondensationSolver only works for serial matrices",
+      OOMPH_CURRENT_FUNCTION,
+      OOMPH_EXCEPTION_LOCATION);
+    }
+#endif
+
+   // Each group of interior rows comprises the unpinned values at an
+   // interior node
+   std::vector<Node*> interior_node_pt;
+   StaticCondensation::get_interior_nodes(Mesh_pt,interior_node_pt);
+   std::vector<std::vector<unsigned> > interior_group;
+   unsigned nnod=interior_node_pt.size();
+   for (unsigned j=0;j<nnod;j++)
+    {
+     std::vector<unsigned> group;
+     unsigned nvalue=interior_node_pt[j]->nvalue();
+     for (unsigned i=0;i<nvalue;i++)
+      {
+       long eqn=interior_node_pt[j]->eqn_number(i);
+       if (eqn>=0)
+        {
+         group.push_back(eqn);
+        }
+      }
+     if (group.size()>0)
+      {
+       interior_group.push_back(group);
+      }
+    }
+
+   // Eliminate them and factorise the reduced matrix
+   Multilevel_Helpers::CSRMatrix<double> a;
+   StaticCondensation::copy_from_cr_matrix(cr_matrix_pt,a);
+   Multilevel_Helpers::CSRMatrix<double> reduced;
+   Condensation.setup(a,interior_group,reduced);
+   Reduced_distribution.build(rhs.distribution_pt()->communicator_pt(),
+                              Condensation.nreduced(),false);
+   CRDoubleMatrix reduced_cr;
+   StaticCondensation::copy_to_cr_matrix(reduced,&Reduced_distribution,
+                                         reduced_cr);
+   Reduced_solver.clean_up_memory();
+   Reduced_solver.factorise(&reduced_cr);
+   if (Doc_time)
+    {
+     oomph_info << "Static condensation: eliminated " 
+                << Condensation.ninterior() << " of " 
+                << Condensation.nrow() << " unknowns; " 
+                << reduced.nnz() << " nonzeros in reduced matrix (vs. "
+                << a.nnz() << ")" << std::endl;
+    }
+
+   // Solve
+   backsub(rhs,result);
+   if (!Enable_resolve)
+    {
+     Reduced_solver.clean_up_memory();
+    }
+
+   Solution_time=TimingHelpers::timer()-t_start;
+   if (Doc_time)
+    {
+     oomph_info << "Time for static condensation solve: " 
+                << Solution_time << " sec" << std::endl;
+    }
+  }
+
+ /// Resolve with the factorisation from the last solve
+ void resolve(const DoubleVector& rhs, DoubleVector& result)
+  {
+   backsub(rhs,result);
+  }
+
+ /// Clean up memory
+ void clean_up_memory()
+  {
+   Reduced_solver.clean_up_memory();
+  }
+
+private:
+
+ /// Condense the rhs, solve the reduced system and recover the rest
+ void backsub(const DoubleVector& rhs, DoubleVector& result)
+  {
+   DoubleVector reduced_rhs(&Reduced_distribution,0.0);
+   Condensation.condense_rhs(rhs.values_pt(),reduced_rhs.values_pt());
+   DoubleVector reduced_result(&Reduced_distribution,0.0);
+   Reduced_solver.backsub(reduced_rhs,reduced_result);
+   result.build(rhs.distribution_pt(),0.0);
+   Condensation.recover(rhs.values_pt(),reduced_result.values_pt(),
+                        result.values_pt());
+  }
+
+ /// The mesh
+ Mesh* Mesh_pt;
+
+ /// The elimination of the interior unknowns
+ StaticCondensation Condensation;
+
+ /// Distribution of the reduced system
+ LinearAlgebraDistribution Reduced_distribution;
+
+ /// Solver for the reduced system
+ SuperLUSolver Reduced_solver;
+
+};
+
+
+
+//======================================================================
+/// \short Preconditioner for a diagonal block of the momentum block
+/// (one velocity component) with static condensation of the unknowns
+/// at the element-interior nodes; the reduced block is passed to
+/// another (direct) preconditioner, which is deleted with this one.
+/// The rows of the block are the unpinned nodal values with the given
+/// index, in the order of their equation numbers.
+//======================================================================
+class StaticCondensationPreconditioner : public Preconditioner
+{
+
+public:
+
+ /// \short Constructor: Pass the mesh, the index of the velocity 
+ /// component in the nodal values and the preconditioner for the
+ /// reduced block
+ StaticCondensationPreconditioner(Mesh* mesh_pt, const unsigned& value_index,
+                                  Preconditioner* reduced_preconditioner_pt) :
+  Mesh_pt(mesh_pt), Value_index(value_index), 
+  Reduced_preconditioner_pt(reduced_preconditioner_pt)
+  {}
+
+ /// Destructor: Delete the preconditioner for the reduced block
+ ~StaticCondensationPreconditioner()
+  {
+   delete Reduced_preconditioner_pt;
+  }
+
+ /// Broken copy constructor
+ StaticCondensationPreconditioner(const StaticCondensationPreconditioner&)
+  {
+   BrokenCopy::broken_copy("StaticCondensationPreconditioner");
+  }
+
+ /// Broken assignment operator
+ void operator=(const StaticCondensationPreconditioner&)
+  {
+   BrokenCopy::broken_assign("StaticCondensationPreconditioner");
+  }
+
+ /// Eliminate the interior unknowns and set up the reduced block
+ void setup()
+  {
+   double t_start=TimingHelpers::timer();
+   CRDoubleMatrix* cr_matrix_pt=dynamic_cast<CRDoubleMatrix*>(matrix_pt());
+   if (cr_matrix_pt==0)
+    {
+     throw OomphLibError(
+      "StaticCondensationPreconditioner needs CRDoubleMatrix",
+      OOMPH_CURRENT_FUNCTION,
+      OOMPH_EXCEPTION_LOCATION);
+    }
+#ifdef PARANOID
+   if (cr_matrix_pt->distributed())
+    {
+     throw OomphLibError(
+      "StaticCondensationPreconditioner only works for serial matrices",
+      OOMPH_CURRENT_FUNCTION,
+      OOMPH_EXCEPTION_LOCATION);
+    }
+#endif
+
+   // Rows of the block: the unpinned values, in the order of their
+   // equation numbers
+   std::vector<Node*> interior_node_pt;
+   StaticCondensation::get_interior_nodes(Mesh_pt,interior_node_pt);
+   std::vector<long> interior_eqn;
+   unsigned ninterior_node=interior_node_pt.size();
+   for (unsigned j=0;j<ninterior_node;j++)
+    {
+     interior_eqn.push_back(interior_node_pt[j]->eqn_number(Value_index));
+    }
+   std::sort(interior_eqn.begin(),interior_eqn.end());
+   std::vector<long> eqn;
+   unsigned nnod=Mesh_pt->nnode();
+   for (unsigned j=0;j<nnod;j++)
+    {
+     long e=Mesh_pt->node_pt(j)->eqn_number(Value_index);
+     if (e>=0)
+      {
+       eqn.push_back(e);
+      }
+    }
+   std::sort(eqn.begin(),eqn.end());
+   unsigned n=eqn.size();
+   if (n!=cr_matrix_pt->nrow())
+    {
+     std::ostringstream error_stream;
+     error_stream << "Matrix has " << cr_matrix_pt->nrow()
+                  << " rows but there are " << n
+                  << " unpinned nodal values " << Value_index
+                  << " in the mesh." << std::endl;
+     throw OomphLibError(error_stream.str(),
+                         OOMPH_CURRENT_FUNCTION,
+                         OOMPH_EXCEPTION_LOCATION);
+    }
+
+   // Each interior unknown is a group of its own
+   std::vector<std::vector<unsigned> > interior_group;
+   for (unsigned i=0;i<n;i++)
+    {
+     if (std::binary_search(interior_eqn.begin(),interior_eqn.end(),eqn[i]))
+      {
+       interior_group.push_back(std::vector<unsigned>(1,i));
+      }
+    }
+
+   // Eliminate them and set up the preconditioner for the reduced block
+   Multilevel_Helpers::CSRMatrix<double> a;
+   StaticCondensation::copy_from_cr_matrix(cr_matrix_pt,a);
+   Multilevel_Helpers::CSRMatrix<double> reduced;
+   Condensation.setup(a,interior_group,reduced);
+   Reduced_distribution.build(
+    cr_matrix_pt->distribution_pt()->communicator_pt(),
+    Condensation.nreduced(),false);
+   StaticCondensation::copy_to_cr_matrix(reduced,&Reduced_distribution,
+                                         Reduced_matrix);
+   Reduced_preconditioner_pt->setup(&Reduced_matrix);
+
+   oomph_info << "Time for setup of static condensation preconditioner ("
+              << Condensation.ninterior() << " of " << n 
+              << " unknowns eliminated): " 
+              << TimingHelpers::timer()-t_start << " sec" << std::endl;
+  }
+
+ /// \short Condense the rhs, apply the preconditioner for the reduced
+ /// block and recover the rest
+ void preconditioner_solve(const DoubleVector& r, DoubleVector& z)
+  {
+   DoubleVector reduced_r(&Reduced_distribution,0.0);
+   Condensation.condense_rhs(r.values_pt(),reduced_r.values_pt());
+   DoubleVector reduced_z(&Reduced_distribution,0.0);
+   Reduced_preconditioner_pt->preconditioner_solve(reduced_r,reduced_z);
+   z.build(r.distribution_pt(),0.0);
+   Condensation.recover(r.values_pt(),reduced_z.values_pt(),z.values_pt());
+  }
+
+ /// Clean up memory
+ void clean_up_memory()
+  {
+   Reduced_preconditioner_pt->clean_up_memory();
+  }
+
+private:
+
+ /// The mesh
+ Mesh* Mesh_pt;
+
+ /// Index of the velocity component in the nodal values
+ unsigned Value_index;
+
+ /// Preconditioner for the reduced block
+ Preconditioner* Reduced_preconditioner_pt;
+
+ /// The elimination of the interior unknowns
+ StaticCondensation Condensation;
+
+ /// Distribution of the reduced block
+ LinearAlgebraDistribution Reduced_distribution;
+
+ /// The reduced block
+ CRDoubleMatrix Reduced_matrix;
+
+};
+
+} // end of namespace oomph
+
+#endif
@@ -0,0 +1,627 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Geometric multigrid for the diagonal blocks of the momentum (F)
+// block of the Navier-Stokes preconditioner on structured (tensor
+// product) meshes. The nodes at which a velocity component is
+// unknown form a lattice of "grid lines"; coarser levels are obtained
+// by dropping every other grid line in each direction (i.e. they are
+// the node lattices of the nested hierarchy of uniformly refined
+// meshes), the prolongation is tensor-product linear interpolation in
+// physical coordinates, the coarse-level operators are Galerkin
+// products, and the smoother is ILU(0), which is robust for the
+// convection-dominated operators at high Reynolds numbers.
+
+#ifndef STRUCTURED_GMG_PRECONDITIONER_HEADER
+#define STRUCTURED_GMG_PRECONDITIONER_HEADER
+
+#include "multilevel_helpers.h"
+#include "anisotropic_amg_preconditioner.h"
+
+namespace oomph
+{
+
+//======================================================================
+/// \short Geometric multigrid hierarchy for a matrix whose rows are
+/// associated with the points of a (possibly incomplete) tensor
+/// product lattice, with ILU(0) smoothing. The scalar type T is used
+/// for the storage of the hierarchy (matrices, prolongations and ILU
+/// factors) while the vectors in the V-cycle are in double precision.
+//======================================================================
+template<class T>
+class StructuredGeometricMultigrid
+{
+
+public:
+
+ /// Constructor: Set default parameters
+ StructuredGeometricMultigrid() : Max_nlevel(20),
+                                  Max_coarsest_nrow(400),
+                                  Nsmooth(1),
+                                  Doc_hierarchy(true)
+  {}
+
+ /// Max. number of levels
+ unsigned& max_nlevel() {return Max_nlevel;}
+
+ /// Max. number of rows for (direct solve on) coarsest level
+ unsigned& max_coarsest_nrow() {return Max_coarsest_nrow;}
+
+ /// Number of pre- and post-smoothing sweeps
+ unsigned& nsmooth() {return Nsmooth;}
+
+ /// Doc the hierarchy when it's built?
+ bool& doc_hierarchy() {return Doc_hierarchy;}
+
+ /// Number of levels
+ unsigned nlevel() const {return Level.size();}
+
+ /// \short Build the hierarchy for the matrix a; x[i] and y[i] are the
+ /// coordinates of the point associated with row i.
+ template<class S>
+ void setup(const Multilevel_Helpers::CSRMatrix<S>& a,
+            const std::vector<double>& x,
+            const std::vector<double>& y)
+  {
+   clean_up_memory();
+   Level.resize(1);
+   Level[0].A.copy(a);
+   Level[0].A.sort_rows();
+   build_lattice(x,y,Level[0]);
+
+   // Coarsen until the matrix is small enough to be solved directly
+   // (or the lattice can't be coarsened any further)
+   while (Level.size()<Max_nlevel)
+    {
+     unsigned l=Level.size()-1;
+     if (Level[l].A.nrow()<=Max_coarsest_nrow) break;
+     Level.resize(l+2);
+     if (!coarsen(Level[l],Level[l+1]))
+      {
+       Level.resize(l+1);
+       break;
+      }
+     Multilevel_Helpers::galerkin_product(Level[l].A,Level[l].P,
+                                          Level[l].R,Level[l+1].A);
+    }
+
+   // Smoothers on all but the coarsest level; direct solve on the
+   // coarsest level if it's small enough, otherwise just smooth there too
+   unsigned nlev=Level.size();
+   for (unsigned l=0;l+1<nlev;l++)
+    {
+     Level[l].Smoother.factorise(Level[l].A);
+    }
+   if (Level[nlev-1].A.nrow()<=Max_coarsest_nrow*10)
+    {
+     Multilevel_Helpers::factorise_dense(Level[nlev-1].A,Coarsest_lu);
+    }
+   else
+    {
+     Level[nlev-1].Smoother.factorise(Level[nlev-1].A);
+    }
+
+   // Work vectors
+   for (unsigned l=0;l<nlev;l++)
+    {
+     unsigned n=Level[l].A.nrow();
+     Level[l].X.assign(n,0.0);
+     Level[l].B.assign(n,0.0);
+     Level[l].Residual.assign(n,0.0);
+    }
+
+   if (Doc_hierarchy)
+    {
+     std::ostringstream doc_stream;
+     doc_hierarchy(doc_stream);
+     oomph_info << doc_stream.str();
+    }
+  }
+
+ /// \short Apply one V-cycle to rhs (with zero initial guess)
+ void solve(const double* rhs, double* soln)
+  {
+   if (Level.size()==0) return;
+   std::copy(rhs,rhs+Level[0].A.nrow(),Level[0].B.begin());
+   vcycle(0);
+   std::copy(Level[0].X.begin(),Level[0].X.end(),soln);
+  }
+
+ /// \short Operator complexity: total number of nonzeros in all levels
+ /// divided by the number of nonzeros on the finest level
+ double operator_complexity() const
+  {
+   if (Level.size()==0) return 0.0;
+   double nnz=0.0;
+   for (unsigned l=0;l<Level.size();l++)
+    {
+     nnz+=Level[l].A.nnz();
+    }
+   return nnz/double(Level[0].A.nnz());
+  }
+
+ /// Doc sizes of levels
+ void doc_hierarchy(std::ostream& outfile) const
+  {
+   outfile << "GMG hierarchy with " << Level.size() << " levels: ";
+   for (unsigned l=0;l<Level.size();l++)
+    {
+     outfile << Level[l].A.nrow() << " (" << Level[l].Line_x.size()
+             << "x" << Level[l].Line_y.size() << ") ";
+    }
+   outfile << "rows; operator complexity: " << operator_complexity()
+           << std::endl;
+  }
+
+ /// Wipe the hierarchy
+ void clean_up_memory()
+  {
+   Level.clear();
+   Coarsest_lu=Multilevel_Helpers::DenseLU<T>();
+  }
+
+private:
+
+ /// Matrices, lattice, smoother and work vectors on a level
+ struct GMGLevel
+ {
+  /// Matrix
+  Multilevel_Helpers::CSRMatrix<T> A;
+
+  /// Prolongation to this level from the next coarser one
+  Multilevel_Helpers::CSRMatrix<T> P;
+
+  /// Restriction from this level to the next coarser one (P^T)
+  Multilevel_Helpers::CSRMatrix<T> R;
+
+  /// ILU(0) factors for smoothing
+  Multilevel_Helpers::ILU0<T> Smoother;
+
+  /// x-coordinates of the vertical grid lines (sorted)
+  std::vector<double> Line_x;
+
+  /// y-coordinates of the horizontal grid lines (sorted)
+  std::vector<double> Line_y;
+
+  /// Vertical grid line that each dof is on
+  std::vector<int> Dof_ix;
+
+  /// Horizontal grid line that each dof is on
+  std::vector<int> Dof_iy;
+
+  /// \short Dof at lattice point (ix,iy), stored at ix+nx*iy
+  /// (-1 if there's no dof there)
+  std::vector<int> Lattice_dof;
+
+  /// Solution
+  std::vector<double> X;
+
+  /// Right-hand side
+  std::vector<double> B;
+
+  /// Residual
+  std::vector<double> Residual;
+ };
+
+ /// \short Sort coordinates and merge those that agree to within a
+ /// (relative) tolerance into grid lines
+ static void find_grid_lines(const std::vector<double>& coordinate,
+                             std::vector<double>& line)
+  {
+   std::vector<double> sorted(coordinate);
+   std::sort(sorted.begin(),sorted.end());
+   line.clear();
+   if (sorted.size()==0) return;
+   double tol=1.0e-8*std::max(1.0,sorted.back()-sorted.front());
+   line.push_back(sorted[0]);
+   for (unsigned i=1;i<sorted.size();i++)
+    {
+     if (sorted[i]-line.back()>tol)
+      {
+       line.push_back(sorted[i]);
+      }
+    }
+  }
+
+ /// Index of the grid line closest to the given coordinate
+ static int grid_line(const std::vector<double>& line, const double& c)
+  {
+   std::vector<double>::const_iterator it=
+    std::lower_bound(line.begin(),line.end(),c);
+   int i=it-line.begin();
+   if (i==int(line.size())) return i-1;
+   if ((i>0)&&(c-line[i-1]<line[i]-c)) return i-1;
+   return i;
+  }
+
+ /// Set up the lattice of the finest level from the dofs' coordinates
+ static void build_lattice(const std::vector<double>& x,
+                           const std::vector<double>& y,
+                           GMGLevel& level)
+  {
+   unsigned n=level.A.nrow();
+   find_grid_lines(x,level.Line_x);
+   find_grid_lines(y,level.Line_y);
+   unsigned nx=level.Line_x.size();
+   level.Lattice_dof.assign(nx*level.Line_y.size(),-1);
+   level.Dof_ix.resize(n);
+   level.Dof_iy.resize(n);
+   for (unsigned i=0;i<n;i++)
+    {
+     level.Dof_ix[i]=grid_line(level.Line_x,x[i]);
+     level.Dof_iy[i]=grid_line(level.Line_y,y[i]);
+     level.Lattice_dof[level.Dof_ix[i]+nx*level.Dof_iy[i]]=i;
+    }
+  }
+
+ /// \short Coarse grid lines: every other fine line, always including
+ /// the first and last ones. Returns the fine line of each coarse line.
+ static void select_coarse_lines(const unsigned& nfine,
+                                 std::vector<int>& fine_line)
+  {
+   fine_line.clear();
+   if (nfine<3)
+    {
+     for (unsigned i=0;i<nfine;i++) fine_line.push_back(i);
+     return;
+    }
+   for (unsigned i=0;i<nfine;i+=2)
+    {
+     fine_line.push_back(i);
+    }
+   if ((nfine-1)%2!=0)
+    {
+     fine_line.push_back(nfine-1);
+    }
+  }
+
+ /// \short Linear interpolation weights between coarse lines for each
+ /// fine line: fine line i is interpolated from coarse lines
+ /// left[i] and right[i] with weights w_left[i] and 1-w_left[i].
+ static void interpolation_weights(const std::vector<double>& fine_coord,
+                                   const std::vector<int>& fine_line,
+                                   std::vector<int>& left,
+                                   std::vector<int>& right,
+                                   std::vector<double>& w_left)
+  {
+   unsigned nfine=fine_coord.size();
+   left.resize(nfine);
+   right.resize(nfine);
+   w_left.resize(nfine);
+   unsigned c=0;
+   for (unsigned i=0;i<nfine;i++)
+    {
+     while ((c+1<fine_line.size())&&(fine_line[c+1]<=int(i))) c++;
+     if (fine_line[c]==int(i))
+      {
+       left[i]=c;
+       right[i]=c;
+       w_left[i]=1.0;
+      }
+     else
+      {
+       double x_left=fine_coord[fine_line[c]];
+       double x_right=fine_coord[fine_line[c+1]];
+       left[i]=c;
+       right[i]=c+1;
+       w_left[i]=(x_right-fine_coord[i])/(x_right-x_left);
+      }
+    }
+  }
+
+ /// \short Build the coarse lattice and the prolongation from it;
+ /// returns false if the lattice can't be coarsened any further.
+ static bool coarsen(GMGLevel& fine, GMGLevel& coarse)
+  {
+   unsigned nx=fine.Line_x.size();
+   unsigned ny=fine.Line_y.size();
+   std::vector<int> fine_line_x, fine_line_y;
+   select_coarse_lines(nx,fine_line_x);
+   select_coarse_lines(ny,fine_line_y);
+   unsigned ncx=fine_line_x.size();
+   unsigned ncy=fine_line_y.size();
+   if ((ncx==nx)&&(ncy==ny)) return false;
+
+   coarse.Line_x.resize(ncx);
+   for (unsigned i=0;i<ncx;i++) coarse.Line_x[i]=fine.Line_x[fine_line_x[i]];
+   coarse.Line_y.resize(ncy);
+   for (unsigned i=0;i<ncy;i++) coarse.Line_y[i]=fine.Line_y[fine_line_y[i]];
+
+   std::vector<int> left_x, right_x, left_y, right_y;
+   std::vector<double> w_x, w_y;
+   interpolation_weights(fine.Line_x,fine_line_x,left_x,right_x,w_x);
+   interpolation_weights(fine.Line_y,fine_line_y,left_y,right_y,w_y);
+
+   // Coarse dofs: the fine dofs on coarse lattice points (numbered in
+   // the same order as on the fine level, so the ILU ordering carries
+   // over)
+   unsigned n=fine.A.nrow();
+   coarse.Lattice_dof.assign(ncx*ncy,-1);
+   coarse.Dof_ix.clear();
+   coarse.Dof_iy.clear();
+   for (unsigned i=0;i<n;i++)
+    {
+     int ix=fine.Dof_ix[i];
+     int iy=fine.Dof_iy[i];
+     if ((left_x[ix]==right_x[ix])&&(left_y[iy]==right_y[iy]))
+      {
+       coarse.Lattice_dof[left_x[ix]+ncx*left_y[iy]]=coarse.Dof_ix.size();
+       coarse.Dof_ix.push_back(left_x[ix]);
+       coarse.Dof_iy.push_back(left_y[iy]);
+      }
+    }
+   unsigned ncoarse=coarse.Dof_ix.size();
+   if (ncoarse==0) return false;
+
+   // Tensor product linear interpolation; coarse lattice points without
+   // a dof are (homogeneous) Dirichlet points and don't contribute
+   fine.P.resize(n,ncoarse);
+   for (unsigned i=0;i<n;i++)
+    {
+     int ix=fine.Dof_ix[i];
+     int iy=fine.Dof_iy[i];
+     int cx[2]={left_x[ix],right_x[ix]};
+     int cy[2]={left_y[iy],right_y[iy]};
+     double wx[2]={w_x[ix],1.0-w_x[ix]};
+     double wy[2]={w_y[iy],1.0-w_y[iy]};
+     for (unsigned jy=0;jy<2;jy++)
+      {
+       for (unsigned jx=0;jx<2;jx++)
+        {
+         double w=wx[jx]*wy[jy];
+         if (w==0.0) continue;
+         int j=coarse.Lattice_dof[cx[jx]+ncx*cy[jy]];
+         if (j<0) continue;
+         fine.P.Column_index.push_back(j);
+         fine.P.Value.push_back(T(w));
+        }
+      }
+     fine.P.Row_start[i+1]=fine.P.Column_index.size();
+    }
+   fine.P.sort_rows();
+   return true;
+  }
+
+ /// \short One ILU(0) smoothing step: x += (LU)^{-1} (b - A x)
+ void smooth(GMGLevel& level) const
+  {
+   level.A.residual(&level.B[0],&level.X[0],&level.Residual[0]);
+   level.Smoother.solve(&level.Residual[0]);
+   for (unsigned i=0;i<level.X.size();i++)
+    {
+     level.X[i]+=level.Residual[i];
+    }
+  }
+
+ /// V-cycle on level l for the rhs in Level[l].B
+ void vcycle(const unsigned& l)
+  {
+   GMGLevel& level=Level[l];
+   std::fill(level.X.begin(),level.X.end(),0.0);
+
+   // Coarsest level
+   if (l==Level.size()-1)
+    {
+     if (Coarsest_lu.n()==level.A.nrow())
+      {
+       level.X=level.B;
+       Coarsest_lu.solve(&level.X[0]);
+      }
+     else
+      {
+       for (unsigned i=0;i<10*Nsmooth;i++)
+        {
+         smooth(level);
+        }
+      }
+     return;
+    }
+
+   // Pre-smooth
+   for (unsigned i=0;i<Nsmooth;i++)
+    {
+     smooth(level);
+    }
+
+   // Coarse-grid correction
+   level.A.residual(&level.B[0],&level.X[0],&level.Residual[0]);
+   level.R.multiply(&level.Residual[0],&Level[l+1].B[0]);
+   vcycle(l+1);
+   level.P.multiply(&Level[l+1].X[0],&level.Residual[0]);
+   for (unsigned i=0;i<level.X.size();i++)
+    {
+     level.X[i]+=level.Residual[i];
+    }
+
+   // Post-smooth
+   for (unsigned i=0;i<Nsmooth;i++)
+    {
+     smooth(level);
+    }
+  }
+
+ /// Max. number of levels
+ unsigned Max_nlevel;
+
+ /// Max. number of rows on coarsest level
+ unsigned Max_coarsest_nrow;
+
+ /// Number of pre- and post-smoothing sweeps
+ unsigned Nsmooth;
+
+ /// Doc the hierarchy when it's built?
+ bool Doc_hierarchy;
+
+ /// The levels
+ std::vector<GMGLevel> Level;
+
+ /// LU factors of the matrix on the coarsest level
+ Multilevel_Helpers::DenseLU<T> Coarsest_lu;
+
+};
+
+
+
+
+//////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////
+
+
+
+
+//======================================================================
+/// \short Preconditioner that applies one V-cycle of geometric multigrid
+/// to the block of the matrix associated with one nodal value (e.g. a
+/// velocity component) of a structured mesh. Meant as subsidiary
+/// preconditioner for the diagonal blocks of the momentum block.
+/// The rows of the block are assumed to be ordered like the (global)
+/// equation numbers of the value, which is how the block
+/// preconditioners order the dofs within each dof block. The hierarchy
+/// is stored in the scalar type T (float or double). Serial matrices
+/// only.
+//======================================================================
+template<class T>
+class StructuredGMGPreconditioner : public Preconditioner
+{
+
+public:
+
+ /// \short Constructor: Pass the mesh and the index of the nodal value
+ /// whose block is to be preconditioned
+ StructuredGMGPreconditioner(Mesh* mesh_pt, const unsigned& value_index) :
+  Mesh_pt(mesh_pt), Value_index(value_index) {}
+
+ /// Destructor
+ ~StructuredGMGPreconditioner()
+  {
+   clean_up_memory();
+  }
+
+ /// Broken copy constructor
+ StructuredGMGPreconditioner(const StructuredGMGPreconditioner&)
+  {
+   BrokenCopy::broken_copy("StructuredGMGPreconditioner");
+  }
+
+ /// Broken assignment operator
+ void operator=(const StructuredGMGPreconditioner&)
+  {
+   BrokenCopy::broken_assign("StructuredGMGPreconditioner");
+  }
+
+ /// Access to the multigrid hierarchy (e.g. to set its parameters)
+ StructuredGeometricMultigrid<T>& gmg() {return GMG;}
+
+ /// Build the multigrid hierarchy for the matrix
+ void setup()
+  {
+   double t_start=TimingHelpers::timer();
+   CRDoubleMatrix* cr_matrix_pt=dynamic_cast<CRDoubleMatrix*>(matrix_pt());
+   if (cr_matrix_pt==0)
+    {
+     throw OomphLibError("StructuredGMGPreconditioner needs CRDoubleMatrix",
+                         OOMPH_CURRENT_FUNCTION,
+                         OOMPH_EXCEPTION_LOCATION);
+    }
+#ifdef PARANOID
+   if (cr_matrix_pt->distributed())
+    {
+     throw OomphLibError(
+      "StructuredGMGPreconditioner only works for serial matrices",
+      OOMPH_CURRENT_FUNCTION,
+      OOMPH_EXCEPTION_LOCATION);
+    }
+#endif
+
+   // Coordinates of the dofs, in the order of their equation numbers
+   std::vector<std::pair<long,unsigned> > eqn_and_node;
+   unsigned nnod=Mesh_pt->nnode();
+   for (unsigned j=0;j<nnod;j++)
+    {
+     long eqn=Mesh_pt->node_pt(j)->eqn_number(Value_index);
+     if (eqn>=0)
+      {
+       eqn_and_node.push_back(std::make_pair(eqn,j));
+      }
+    }
+   std::sort(eqn_and_node.begin(),eqn_and_node.end());
+   unsigned n=eqn_and_node.size();
+   if (n!=cr_matrix_pt->nrow())
+    {
+     std::ostringstream error_stream;
+     error_stream << "Matrix has " << cr_matrix_pt->nrow()
+                  << " rows but there are " << n
+                  << " unpinned nodal values " << Value_index
+                  << " in the mesh." << std::endl;
+     throw OomphLibError(error_stream.str(),
+                         OOMPH_CURRENT_FUNCTION,
+                         OOMPH_EXCEPTION_LOCATION);
+    }
+   std::vector<double> x(n), y(n);
+   for (unsigned i=0;i<n;i++)
+    {
+     Node* nod_pt=Mesh_pt->node_pt(eqn_and_node[i].second);
+     x[i]=nod_pt->x(0);
+     y[i]=nod_pt->x(1);
+    }
+
+   Multilevel_Helpers::CSRMatrix<double> matrix;
+   AnisotropicAMGPreconditioner<T>::copy_cr_matrix(cr_matrix_pt,matrix);
+   GMG.setup(matrix,x,y);
+
+   oomph_info << "Time for setup of GMG preconditioner: "
+              << TimingHelpers::timer()-t_start << " sec" << std::endl;
+  }
+
+ /// Apply one V-cycle
+ void preconditioner_solve(const DoubleVector& r, DoubleVector& z)
+  {
+   z.build(r.distribution_pt(),0.0);
+   GMG.solve(r.values_pt(),z.values_pt());
+  }
+
+ /// Clean up memory
+ void clean_up_memory()
+  {
+   GMG.clean_up_memory();
+  }
+
+private:
+
+ /// The mesh
+ Mesh* Mesh_pt;
+
+ /// Index of the nodal value whose block is preconditioned
+ unsigned Value_index;
+
+ /// The multigrid hierarchy
+ StructuredGeometricMultigrid<T> GMG;
+
+};
+
+} // end of namespace oomph
+
+#endif
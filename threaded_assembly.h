@@ -0,0 +1,631 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2016 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Shared-memory (OpenMP) parallel assembly of the residual vector and
+// the Jacobian matrix of a serial Problem. The elements are processed
+// in batches: the element residuals and Jacobians of a batch are
+// computed in parallel, then added into the global system in parallel,
+// each thread owning a contiguous range of rows. Every entry is
+// therefore accumulated in the order of the elements, independent of
+// the number of threads and of the scheduling, so the results are
+// bitwise reproducible. Without OpenMP everything runs serially.
+//
+// Optionally the sparsity pattern of the Jacobian (all couplings
+// between the dofs of each element) is computed once per equation
+// numbering, together with the position of each entry of each element
+// Jacobian in the compressed row storage. Later assemblies then add
+// the element Jacobians directly into the array of values.
+//
+// Products of the Jacobian with a vector can also be computed element
+// by element, without assembling the global Jacobian: the element
+// Jacobians of each batch are applied as soon as they're computed.
+
+#ifndef THREADED_ASSEMBLY_HEADER
+#define THREADED_ASSEMBLY_HEADER
+
+#include <vector>
+#include <algorithm>
+#include <sstream>
+
+namespace oomph
+{
+
+//======================================================================
+/// \short Multithreaded assembly of the residuals and the Jacobian
+/// from the elements in the Problem's (global) mesh. Serial problems
+/// without global Data only.
+//======================================================================
+class ThreadedAssembler
+{
+
+public:
+
+ /// Constructor: Pass the problem
+ ThreadedAssembler(Problem* problem_pt) : Problem_pt(problem_pt),
+                                          Nthread(1),
+                                          Nelement_per_thread_in_batch(64),
+                                          Reuse_sparsity_pattern(false),
+                                          Pattern_ndof(0)
+  {}
+
+ /// \short Compute the sparsity pattern once per equation numbering
+ /// and re-use it
+ void enable_sparsity_pattern_reuse() {Reuse_sparsity_pattern=true;}
+
+ /// \short Build the Jacobian from scratch in every assembly (default)
+ void disable_sparsity_pattern_reuse()
+  {
+   Reuse_sparsity_pattern=false;
+   invalidate_sparsity_pattern();
+  }
+
+ /// \short Wipe the stored sparsity pattern; must be called whenever
+ /// the equation numbers have been re-assigned (it's also rebuilt
+ /// automatically if the number of dofs or elements changes).
+ void invalidate_sparsity_pattern()
+  {
+   Pattern_ndof=0;
+   Pattern_row_start.clear();
+   Pattern_column_index.clear();
+   Element_nonzero_start.clear();
+   Element_nonzero_index.clear();
+   Element_eqn_start.clear();
+   Element_eqn_number.clear();
+  }
+
+ /// \short Product of the Jacobian with x, computed element by element
+ /// (the global Jacobian isn't assembled; only the element Jacobians of
+ /// one batch are stored at any time)
+ void multiply_by_jacobian(const DoubleVector& x, DoubleVector& soln)
+  {
+   check_problem();
+   soln.build(Problem_pt->dof_distribution_pt(),0.0);
+   unsigned long ndof=Problem_pt->ndof();
+   unsigned long nel=Problem_pt->mesh_pt()->nelement();
+   unsigned nthread=std::max(Nthread,1u);
+   unsigned long nel_per_batch=nthread*Nelement_per_thread_in_batch;
+   Contribution.resize(std::min(nel_per_batch,nel));
+
+   // Contiguous range of rows for each thread
+   std::vector<long> first_row(nthread+1);
+   for (unsigned t=0;t<=nthread;t++)
+    {
+     first_row[t]=(ndof*t)/nthread;
+    }
+
+   const double* x_pt=x.values_pt();
+   double* soln_pt=soln.values_pt();
+   bool compute_jacobian=true;
+   for (unsigned long first_element=0;first_element<nel;
+        first_element+=nel_per_batch)
+    {
+     unsigned long nel_in_batch=
+      std::min(nel_per_batch,nel-first_element);
+     compute_batch(first_element,nel_in_batch,compute_jacobian);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthread) schedule(static,1)
+#endif
+     for (int t=0;t<int(nthread);t++)
+      {
+       apply_batch(nel_in_batch,first_row[t],first_row[t+1],x_pt,soln_pt);
+      }
+    }
+  }
+
+ /// \short Build the stored sparsity pattern now (if it's re-used and
+ /// isn't up to date) rather than in the next assembly of the Jacobian
+ void setup_sparsity_pattern()
+  {
+   if (!Reuse_sparsity_pattern) return;
+   check_problem();
+   unsigned long ndof=Problem_pt->ndof();
+   unsigned long nel=Problem_pt->mesh_pt()->nelement();
+   if ((Pattern_ndof!=ndof)||(Element_nonzero_start.size()!=nel+1))
+    {
+     build_sparsity_pattern();
+    }
+  }
+
+ /// Number of threads
+ unsigned& nthread() {return Nthread;}
+
+ /// \short Number of elements per thread in each batch (the element
+ /// Jacobians of a batch are stored simultaneously)
+ unsigned& nelement_per_thread_in_batch()
+  {return Nelement_per_thread_in_batch;}
+
+ /// Assemble the residual vector
+ void get_residuals(DoubleVector& residuals)
+  {
+   check_problem();
+   residuals.build(Problem_pt->dof_distribution_pt(),0.0);
+   assemble(residuals.values_pt(),false);
+  }
+
+ /// Assemble the residual vector and the Jacobian
+ void get_jacobian(DoubleVector& residuals, CRDoubleMatrix& jacobian)
+  {
+   check_problem();
+   residuals.build(Problem_pt->dof_distribution_pt(),0.0);
+   unsigned long ndof=Problem_pt->ndof();
+
+   // Add the element Jacobians into the stored sparsity pattern
+   if (Reuse_sparsity_pattern)
+    {
+     setup_sparsity_pattern();
+#ifdef PARANOID
+     check_sparsity_pattern();
+#endif
+     unsigned long nnz=Pattern_column_index.size();
+     int* row_start=new int[ndof+1];
+     std::copy(Pattern_row_start.begin(),Pattern_row_start.end(),row_start);
+     int* column_index=new int[nnz];
+     std::copy(Pattern_column_index.begin(),Pattern_column_index.end(),
+               column_index);
+     double* value=new double[nnz];
+     std::fill(value,value+nnz,0.0);
+     assemble(residuals.values_pt(),true,value);
+     jacobian.build(Problem_pt->dof_distribution_pt());
+     jacobian.build_without_copy(ndof,nnz,value,column_index,row_start);
+     return;
+    }
+
+   Row.resize(ndof);
+   for (unsigned long i=0;i<ndof;i++)
+    {
+     Row[i].clear();
+    }
+   assemble(residuals.values_pt(),true);
+
+   // Sort the rows and convert to compressed row storage
+   int* row_start=new int[ndof+1];
+   row_start[0]=0;
+   for (unsigned long i=0;i<ndof;i++)
+    {
+     row_start[i+1]=row_start[i]+Row[i].size();
+    }
+   unsigned long nnz=row_start[ndof];
+   int* column_index=new int[nnz];
+   double* value=new double[nnz];
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(Nthread) schedule(static)
+#endif
+   for (long i=0;i<long(ndof);i++)
+    {
+     std::sort(Row[i].begin(),Row[i].end(),compare_column);
+     int k=row_start[i];
+     for (unsigned j=0;j<Row[i].size();j++)
+      {
+       column_index[k]=Row[i][j].first;
+       value[k]=Row[i][j].second;
+       k++;
+      }
+    }
+   jacobian.build(Problem_pt->dof_distribution_pt());
+   jacobian.build_without_copy(ndof,nnz,value,column_index,row_start);
+  }
+
+private:
+
+ /// Residuals, Jacobian and equation numbers of an element
+ struct ElementContribution
+ {
+  /// Residuals
+  Vector<double> Residuals;
+
+  /// Jacobian
+  DenseMatrix<double> Jacobian;
+
+  /// Global equation numbers of the element's dofs
+  Vector<long> Eqn_number;
+ };
+
+ /// Comparison of column indices for sorting
+ static bool compare_column(const std::pair<int,double>& a,
+                            const std::pair<int,double>& b)
+  {
+   return a.first<b.first;
+  }
+
+ /// Check that the problem is suitable for threaded assembly
+ void check_problem()
+  {
+   if (Problem_pt->distributed()||(Problem_pt->nglobal_data()!=0))
+    {
+     throw OomphLibError(
+      "Threaded assembly only works for serial problems without global data",
+      OOMPH_CURRENT_FUNCTION,
+      OOMPH_EXCEPTION_LOCATION);
+    }
+  }
+
+ /// \short Compute the element contributions of a batch of elements
+ /// (in parallel)
+ void compute_batch(const unsigned long& first_element,
+                    const unsigned long& nel_in_batch,
+                    const bool& compute_jacobian)
+  {
+   Mesh* mesh_pt=Problem_pt->mesh_pt();
+   AssemblyHandler* assembly_handler_pt=Problem_pt->assembly_handler_pt();
+   bool failed=false;
+   std::string error_message;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(Nthread) schedule(dynamic,4)
+#endif
+   for (long e=0;e<long(nel_in_batch);e++)
+    {
+     try
+      {
+       GeneralisedElement* elem_pt=mesh_pt->element_pt(first_element+e);
+       ElementContribution& contribution=Contribution[e];
+       unsigned nvar=assembly_handler_pt->ndof(elem_pt);
+       contribution.Residuals.resize(nvar);
+       contribution.Eqn_number.resize(nvar);
+       for (unsigned i=0;i<nvar;i++)
+        {
+         contribution.Eqn_number[i]=
+          assembly_handler_pt->eqn_number(elem_pt,i);
+        }
+       if (compute_jacobian)
+        {
+         contribution.Jacobian.resize(nvar,nvar);
+         assembly_handler_pt->get_jacobian(elem_pt,contribution.Residuals,
+                                           contribution.Jacobian);
+        }
+       else
+        {
+         assembly_handler_pt->get_residuals(elem_pt,
+                                            contribution.Residuals);
+        }
+      }
+     catch (std::exception& error)
+      {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+       {
+        failed=true;
+        error_message=error.what();
+       }
+      }
+    }
+   if (failed)
+    {
+     std::ostringstream error_stream;
+     error_stream << "Threaded element assembly failed:\n"
+                  << error_message << std::endl;
+     throw OomphLibError(error_stream.str(),
+                         OOMPH_CURRENT_FUNCTION,
+                         OOMPH_EXCEPTION_LOCATION);
+    }
+  }
+
+ /// \short Add the element contributions of a batch (starting with
+ /// element first_element) to the rows in [first_row,last_row), in the
+ /// order of the elements. The Jacobian entries are added to Row or,
+ /// if value isn't null, into the values of the stored sparsity pattern.
+ void add_batch(const unsigned long& first_element,
+                const unsigned long& nel_in_batch,
+                const long& first_row, const long& last_row,
+                double* residuals, const bool& compute_jacobian,
+                double* value)
+  {
+   for (unsigned long e=0;e<nel_in_batch;e++)
+    {
+     const ElementContribution& contribution=Contribution[e];
+     unsigned nvar=contribution.Eqn_number.size();
+     for (unsigned i=0;i<nvar;i++)
+      {
+       long row=contribution.Eqn_number[i];
+       if ((row<first_row)||(row>=last_row)) continue;
+       residuals[row]+=contribution.Residuals[i];
+       if (!compute_jacobian) continue;
+
+       // Straight into the stored sparsity pattern
+       if (value!=0)
+        {
+         const int* nonzero_index=&Element_nonzero_index[
+          Element_nonzero_start[first_element+e]+i*nvar];
+         for (unsigned j=0;j<nvar;j++)
+          {
+           value[nonzero_index[j]]+=contribution.Jacobian(i,j);
+          }
+         continue;
+        }
+
+       // Add to existing entries in the row (linear search) or append
+       std::vector<std::pair<int,double> >& row_entries=Row[row];
+       for (unsigned j=0;j<nvar;j++)
+        {
+         double jac_entry=contribution.Jacobian(i,j);
+         if (jac_entry==0.0) continue;
+         int column=contribution.Eqn_number[j];
+         unsigned n=row_entries.size();
+         unsigned k=0;
+         while ((k<n)&&(row_entries[k].first!=column)) k++;
+         if (k<n)
+          {
+           row_entries[k].second+=jac_entry;
+          }
+         else
+          {
+           row_entries.push_back(std::make_pair(column,jac_entry));
+          }
+        }
+      }
+    }
+  }
+
+ /// \short Add the products of the element Jacobians of a batch with x
+ /// to the rows in [first_row,last_row) of soln, in the order of the
+ /// elements
+ void apply_batch(const unsigned long& nel_in_batch,
+                  const long& first_row, const long& last_row,
+                  const double* x, double* soln)
+  {
+   for (unsigned long e=0;e<nel_in_batch;e++)
+    {
+     const ElementContribution& contribution=Contribution[e];
+     unsigned nvar=contribution.Eqn_number.size();
+     for (unsigned i=0;i<nvar;i++)
+      {
+       long row=contribution.Eqn_number[i];
+       if ((row<first_row)||(row>=last_row)) continue;
+       double sum=0.0;
+       for (unsigned j=0;j<nvar;j++)
+        {
+         sum+=contribution.Jacobian(i,j)*x[contribution.Eqn_number[j]];
+        }
+       soln[row]+=sum;
+      }
+    }
+  }
+
+ /// \short Build the sparsity pattern of the Jacobian for the current
+ /// equation numbers (all dofs in an element are assumed to be coupled)
+ /// and the position of the entries of each element Jacobian in it
+ void build_sparsity_pattern()
+  {
+   double t_start=TimingHelpers::timer();
+   Mesh* mesh_pt=Problem_pt->mesh_pt();
+   AssemblyHandler* assembly_handler_pt=Problem_pt->assembly_handler_pt();
+   unsigned long ndof=Problem_pt->ndof();
+   unsigned long nel=mesh_pt->nelement();
+
+   // Equation numbers of all elements
+   Element_eqn_start.assign(nel+1,0);
+   Element_eqn_number.clear();
+   for (unsigned long e=0;e<nel;e++)
+    {
+     GeneralisedElement* elem_pt=mesh_pt->element_pt(e);
+     unsigned nvar=assembly_handler_pt->ndof(elem_pt);
+     for (unsigned i=0;i<nvar;i++)
+      {
+       Element_eqn_number.push_back(
+        assembly_handler_pt->eqn_number(elem_pt,i));
+      }
+     Element_eqn_start[e+1]=Element_eqn_number.size();
+    }
+
+   // Columns in each row (each thread handles its own range of rows)
+   unsigned nthread=std::max(Nthread,1u);
+   std::vector<long> first_row(nthread+1);
+   for (unsigned t=0;t<=nthread;t++)
+    {
+     first_row[t]=(ndof*t)/nthread;
+    }
+   std::vector<std::vector<int> > column(ndof);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthread) schedule(static,1)
+#endif
+   for (int t=0;t<int(nthread);t++)
+    {
+     for (unsigned long e=0;e<nel;e++)
+      {
+       unsigned long start=Element_eqn_start[e];
+       unsigned long end=Element_eqn_start[e+1];
+       for (unsigned long i=start;i<end;i++)
+        {
+         long row=Element_eqn_number[i];
+         if ((row<first_row[t])||(row>=first_row[t+1])) continue;
+         for (unsigned long j=start;j<end;j++)
+          {
+           column[row].push_back(Element_eqn_number[j]);
+          }
+        }
+      }
+     for (long row=first_row[t];row<first_row[t+1];row++)
+      {
+       std::sort(column[row].begin(),column[row].end());
+       column[row].erase(std::unique(column[row].begin(),column[row].end()),
+                         column[row].end());
+      }
+    }
+
+   // Compressed row storage
+   Pattern_row_start.assign(ndof+1,0);
+   for (unsigned long i=0;i<ndof;i++)
+    {
+     Pattern_row_start[i+1]=Pattern_row_start[i]+column[i].size();
+    }
+   Pattern_column_index.resize(Pattern_row_start[ndof]);
+   for (unsigned long i=0;i<ndof;i++)
+    {
+     std::copy(column[i].begin(),column[i].end(),
+               Pattern_column_index.begin()+Pattern_row_start[i]);
+    }
+
+   // Position of each entry of each element Jacobian
+   Element_nonzero_start.assign(nel+1,0);
+   for (unsigned long e=0;e<nel;e++)
+    {
+     unsigned long nvar=Element_eqn_start[e+1]-Element_eqn_start[e];
+     Element_nonzero_start[e+1]=Element_nonzero_start[e]+nvar*nvar;
+    }
+   Element_nonzero_index.resize(Element_nonzero_start[nel]);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthread) schedule(static)
+#endif
+   for (long e=0;e<long(nel);e++)
+    {
+     unsigned long start=Element_eqn_start[e];
+     unsigned nvar=Element_eqn_start[e+1]-start;
+     int* nonzero_index=&Element_nonzero_index[Element_nonzero_start[e]];
+     for (unsigned i=0;i<nvar;i++)
+      {
+       long row=Element_eqn_number[start+i];
+       std::vector<int>::const_iterator row_begin=
+        Pattern_column_index.begin()+Pattern_row_start[row];
+       std::vector<int>::const_iterator row_end=
+        Pattern_column_index.begin()+Pattern_row_start[row+1];
+       for (unsigned j=0;j<nvar;j++)
+        {
+         nonzero_index[i*nvar+j]=
+          std::lower_bound(row_begin,row_end,
+                           int(Element_eqn_number[start+j]))-
+          Pattern_column_index.begin();
+        }
+      }
+    }
+   Pattern_ndof=ndof;
+
+   oomph_info << "Time for setup of sparsity pattern of Jacobian ("
+              << Pattern_column_index.size() << " nonzeros): "
+              << TimingHelpers::timer()-t_start << " sec" << std::endl;
+  }
+
+#ifdef PARANOID
+ /// \short Check that the equation numbers of the elements haven't
+ /// changed since the sparsity pattern was built
+ void check_sparsity_pattern()
+  {
+   Mesh* mesh_pt=Problem_pt->mesh_pt();
+   AssemblyHandler* assembly_handler_pt=Problem_pt->assembly_handler_pt();
+   unsigned long nel=mesh_pt->nelement();
+   for (unsigned long e=0;e<nel;e++)
+    {
+     GeneralisedElement* elem_pt=mesh_pt->element_pt(e);
+     unsigned nvar=assembly_handler_pt->ndof(elem_pt);
+     bool changed=(nvar!=Element_eqn_start[e+1]-Element_eqn_start[e]);
+     for (unsigned i=0;(i<nvar)&&(!changed);i++)
+      {
+       changed=(assembly_handler_pt->eqn_number(elem_pt,i)!=
+                Element_eqn_number[Element_eqn_start[e]+i]);
+      }
+     if (changed)
+      {
+       std::ostringstream error_stream;
+       error_stream << "Equation numbers of element " << e 
+                    << " have changed since the sparsity pattern was built."
+                    << "\nCall invalidate_sparsity_pattern() after "
+                    << "re-assigning the equation numbers." << std::endl;
+       throw OomphLibError(error_stream.str(),
+                           OOMPH_CURRENT_FUNCTION,
+                           OOMPH_EXCEPTION_LOCATION);
+      }
+    }
+  }
+#endif
+
+ /// \short Assemble the residuals (and the Jacobian into Row or, if
+ /// value isn't null, into the values of the stored sparsity pattern)
+ void assemble(double* residuals, const bool& compute_jacobian,
+               double* value=0)
+  {
+   unsigned long ndof=Problem_pt->ndof();
+   unsigned long nel=Problem_pt->mesh_pt()->nelement();
+   unsigned nthread=std::max(Nthread,1u);
+   unsigned long nel_per_batch=nthread*Nelement_per_thread_in_batch;
+   Contribution.resize(std::min(nel_per_batch,nel));
+
+   // Contiguous range of rows for each thread
+   std::vector<long> first_row(nthread+1);
+   for (unsigned t=0;t<=nthread;t++)
+    {
+     first_row[t]=(ndof*t)/nthread;
+    }
+
+   for (unsigned long first_element=0;first_element<nel;
+        first_element+=nel_per_batch)
+    {
+     unsigned long nel_in_batch=
+      std::min(nel_per_batch,nel-first_element);
+     compute_batch(first_element,nel_in_batch,compute_jacobian);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthread) schedule(static,1)
+#endif
+     for (int t=0;t<int(nthread);t++)
+      {
+       add_batch(first_element,nel_in_batch,first_row[t],first_row[t+1],
+                 residuals,compute_jacobian,value);
+      }
+    }
+  }
+
+ /// The problem
+ Problem* Problem_pt;
+
+ /// Number of threads
+ unsigned Nthread;
+
+ /// Number of elements per thread in each batch
+ unsigned Nelement_per_thread_in_batch;
+
+ /// Element contributions for the current batch
+ std::vector<ElementContribution> Contribution;
+
+ /// Entries (column index and value) in each row of the Jacobian
+ std::vector<std::vector<std::pair<int,double> > > Row;
+
+ /// Re-use the sparsity pattern of the Jacobian?
+ bool Reuse_sparsity_pattern;
+
+ /// Number of dofs for which the sparsity pattern was built (0 if none)
+ unsigned long Pattern_ndof;
+
+ /// Start of the rows of the stored sparsity pattern
+ std::vector<int> Pattern_row_start;
+
+ /// Column indices of the stored sparsity pattern
+ std::vector<int> Pattern_column_index;
+
+ /// \short Start of each element's entries in Element_nonzero_index
+ std::vector<unsigned long> Element_nonzero_start;
+
+ /// \short Position in the stored sparsity pattern of the entries of the
+ /// element Jacobians (row by row)
+ std::vector<int> Element_nonzero_index;
+
+ /// Start of each element's equation numbers in Element_eqn_number
+ std::vector<unsigned long> Element_eqn_start;
+
+ /// Equation numbers of the elements' dofs when the pattern was built
+ std::vector<unsigned long> Element_eqn_number;
+
+};
+
+} // end of namespace oomph
+
+#endif
@@ -33,8 +33,196 @@ public:
    // Pointer to fct that specifies exact vorticity and
    // derivs (for validation).
    Exact_vorticity_fct_pt=0;
+
+   // Use general (isoparametric) mapping until we know better
+   Affine_rectangle=false;
   } 
 
+ /// \short Check if the element is an axis-aligned rectangle with an
+ /// affine mapping x_i = c_i + h_i s_i (all nodes, including the 
+ /// edge and centre nodes, at the positions implied by their local 
+ /// coordinates) and, if so, use the fast path for the mapping: 
+ /// constant Jacobian, derivatives of the shape functions obtained by 
+ /// scaling the (tabulated) local derivatives by 1/h_i. Call again 
+ /// whenever the nodes have moved (or the element has been created
+ /// by refinement).
+ void setup_affine_rectangle()
+  {
+   Affine_rectangle=false;
+   unsigned n_node=this->nnode();
+   Vector<double> s(2);
+
+   // Least-squares fit of x_i = c_i + h_i s_i (the local coordinates 
+   // of the nodes are symmetric about zero)
+   double x_sum[2]={0.0,0.0};
+   double xs_sum[2]={0.0,0.0};
+   double ss_sum[2]={0.0,0.0};
+   for (unsigned l=0;l<n_node;l++)
+    {
+     this->local_coordinate_of_node(l,s);
+     for (unsigned i=0;i<2;i++)
+      {
+       double x=this->nodal_position(l,i);
+       x_sum[i]+=x;
+       xs_sum[i]+=x*s[i];
+       ss_sum[i]+=s[i]*s[i];
+      }
+    }
+   for (unsigned i=0;i<2;i++)
+    {
+     if (ss_sum[i]==0.0) return;
+     Centre[i]=x_sum[i]/double(n_node);
+     Half_width[i]=xs_sum[i]/ss_sum[i];
+    }
+   double h_max=std::max(std::fabs(Half_width[0]),std::fabs(Half_width[1]));
+   if ((Half_width[0]==0.0)||(Half_width[1]==0.0)) return;
+
+   // Check that all nodes are where the affine mapping puts them
+   double tol=1.0e-10*h_max;
+   for (unsigned l=0;l<n_node;l++)
+    {
+     this->local_coordinate_of_node(l,s);
+     for (unsigned i=0;i<2;i++)
+      {
+       if (std::fabs(this->nodal_position(l,i)-
+                     (Centre[i]+Half_width[i]*s[i]))>tol)
+        {
+         return;
+        }
+      }
+    }
+
+   // Tabulate shape functions and their local derivatives at the knots
+   // (same for all elements of this type)
+   Integral* integral_pt=this->integral_pt();
+   unsigned n_intpt=integral_pt->nweight();
+   if ((Knot_nnode!=n_node)||(Knot_nintpt!=n_intpt))
+    {
+     Knot_psi.resize(n_intpt*n_node);
+     Knot_dpsids.resize(2*n_intpt*n_node);
+     Shape psi(n_node);
+     DShape dpsids(n_node,2);
+     for (unsigned ipt=0;ipt<n_intpt;ipt++)
+      {
+       for (unsigned i=0;i<2;i++)
+        {
+         s[i]=integral_pt->knot(ipt,i);
+        }
+       this->dshape_local(s,psi,dpsids);
+       for (unsigned l=0;l<n_node;l++)
+        {
+         Knot_psi[ipt*n_node+l]=psi[l];
+         Knot_dpsids[2*(ipt*n_node+l)]=dpsids(l,0);
+         Knot_dpsids[2*(ipt*n_node+l)+1]=dpsids(l,1);
+        }
+      }
+     Knot_nnode=n_node;
+     Knot_nintpt=n_intpt;
+    }
+
+   Inverse_half_width[0]=1.0/Half_width[0];
+   Inverse_half_width[1]=1.0/Half_width[1];
+   Jacobian_determinant=Half_width[0]*Half_width[1];
+   Affine_rectangle=true;
+  }
+
+ /// \short Is the element an axis-aligned rectangle with an affine 
+ /// mapping (as determined by setup_affine_rectangle())?
+ bool is_affine_rectangle() const {return Affine_rectangle;}
+
+ /// Other versions are the element's
+ using ELEMENT::dshape_eulerian;
+ using ELEMENT::dshape_eulerian_at_knot;
+ using ELEMENT::J_eulerian;
+ using ELEMENT::J_eulerian_at_knot;
+ using ELEMENT::interpolated_x;
+
+ /// \short Derivatives of the shape functions w.r.t. the global 
+ /// coordinates (scaled local derivatives for affine rectangles);
+ /// returns the Jacobian of the mapping
+ double dshape_eulerian(const Vector<double>& s, Shape& psi, 
+                        DShape& dpsidx) const
+  {
+   if (!Affine_rectangle)
+    {
+     return ELEMENT::dshape_eulerian(s,psi,dpsidx);
+    }
+   this->dshape_local(s,psi,dpsidx);
+   unsigned n_node=this->nnode();
+   for (unsigned l=0;l<n_node;l++)
+    {
+     dpsidx(l,0)*=Inverse_half_width[0];
+     dpsidx(l,1)*=Inverse_half_width[1];
+    }
+   return Jacobian_determinant;
+  }
+
+ /// \short Shape functions and their derivatives w.r.t. the global 
+ /// coordinates at integration point ipt (from the tabulated local
+ /// derivatives for affine rectangles); returns the Jacobian of the 
+ /// mapping
+ double dshape_eulerian_at_knot(const unsigned& ipt, Shape& psi, 
+                                DShape& dpsidx) const
+  {
+   if (!Affine_rectangle)
+    {
+     return ELEMENT::dshape_eulerian_at_knot(ipt,psi,dpsidx);
+    }
+   unsigned n_node=this->nnode();
+   const double* psi_pt=&Knot_psi[ipt*n_node];
+   const double* dpsids_pt=&Knot_dpsids[2*ipt*n_node];
+   for (unsigned l=0;l<n_node;l++)
+    {
+     psi[l]=psi_pt[l];
+     dpsidx(l,0)=dpsids_pt[2*l]*Inverse_half_width[0];
+     dpsidx(l,1)=dpsids_pt[2*l+1]*Inverse_half_width[1];
+    }
+   return Jacobian_determinant;
+  }
+
+ /// Jacobian of the mapping (constant for affine rectangles)
+ double J_eulerian(const Vector<double>& s) const
+  {
+   if (!Affine_rectangle)
+    {
+     return ELEMENT::J_eulerian(s);
+    }
+   return Jacobian_determinant;
+  }
+
+ /// \short Jacobian of the mapping at integration point ipt (constant
+ /// for affine rectangles)
+ double J_eulerian_at_knot(const unsigned& ipt) const
+  {
+   if (!Affine_rectangle)
+    {
+     return ELEMENT::J_eulerian_at_knot(ipt);
+    }
+   return Jacobian_determinant;
+  }
+
+ /// Global coordinate i at local coordinate s
+ double interpolated_x(const Vector<double>& s, const unsigned& i) const
+  {
+   if (!Affine_rectangle)
+    {
+     return ELEMENT::interpolated_x(s,i);
+    }
+   return Centre[i]+Half_width[i]*s[i];
+  }
+
+ /// Global coordinates at local coordinate s
+ void interpolated_x(const Vector<double>& s, Vector<double>& x) const
+  {
+   if (!Affine_rectangle)
+    {
+     ELEMENT::interpolated_x(s,x);
+     return;
+    }
+   x[0]=Centre[0]+Half_width[0]*s[0];
+   x[1]=Centre[1]+Half_width[1]*s[1];
+  }
+
  /// Typedef for pointer to function that specifies the exact
  /// vorticity and derivs (for validation)
  typedef void (*ExactVorticityFctPt)(const Vector<double>& x, 
@@ -306,66 +494,103 @@ public:
 
 
  /// \short Overloaded output fct: Output veloc, pressure, 
- /// smoothed vorticity 
+ /// smoothed vorticity. Uses the plot-point shape functions that are
+ /// tabulated once per nplot (see plot_point_shape_table(...)), so 
+ /// the output of all fields reduces to a small dense matrix-matrix
+ /// product of the tabulated shape functions with the element's
+ /// block of nodal values.
  void output(std::ostream &outfile, const unsigned &nplot)
   {
-   //Vector of local coordinates
-   Vector<double> s(2);
-   
-   // Shape functions
-   unsigned n_node = this->nnode();
-   Shape psif(n_node);
+   // Tabulated shape functions at plot points
+   const PlotPointShapeTable& table=plot_point_shape_table(nplot);
+   unsigned num_plot_points=table.Nplot_points;
+   unsigned n_node=table.Nnode;
+   unsigned n_pres=table.Npres;
+
+   // Number of columns in nodal block: x, y, u, v, smoothed vorticity 
+   // and its 13 derivatives (the pressure is interpolated separately 
+   // since it uses its own shape functions)
+   unsigned n_col=4+14;
+
+   // Gather the element's nodal values into a contiguous 
+   // (n_node x n_col) block
+   Vector<double> nodal_block(n_node*n_col);
+   for(unsigned l=0;l<n_node;l++)
+    {
+     double* block_row_pt=&nodal_block[l*n_col];
+     block_row_pt[0]=this->nodal_position(l,0);
+     block_row_pt[1]=this->nodal_position(l,1);
+     block_row_pt[2]=this->nodal_value(l,this->u_index_nst(0));
+     block_row_pt[3]=this->nodal_value(l,this->u_index_nst(1));
+     for (unsigned i=0;i<14;i++)
+      {
+       block_row_pt[4+i]=this->nodal_value(l,Smoothed_vorticity_index+i);
+      }
+    }
+
+   // Pressure values
+   Vector<double> pressure(n_pres);
+   for(unsigned l=0;l<n_pres;l++)
+    {
+     pressure[l]=this->p_nst(l);
+    }
+
+   // Interpolate: (num_plot_points x n_node) times (n_node x n_col).
+   // Loop over plot points in blocks; innermost loop runs over the 
+   // contiguous columns so it vectorises.
+   Vector<double> plot_values(num_plot_points*n_col,0.0);
+   Vector<double> plot_pressure(num_plot_points,0.0);
+   unsigned block_size=8;
+   for (unsigned iplot_start=0;iplot_start<num_plot_points;
+        iplot_start+=block_size)
+    {
+     unsigned iplot_end=std::min(iplot_start+block_size,num_plot_points);
+     for(unsigned l=0;l<n_node;l++)
+      {
+       const double* block_row_pt=&nodal_block[l*n_col];
+       for (unsigned iplot=iplot_start;iplot<iplot_end;iplot++)
+        {
+         double psi=table.Psi[iplot*n_node+l];
+         double* plot_row_pt=&plot_values[iplot*n_col];
+         for (unsigned i=0;i<n_col;i++)
+          {
+           plot_row_pt[i]+=psi*block_row_pt[i];
+          }
+        }
+      }
+     for (unsigned iplot=iplot_start;iplot<iplot_end;iplot++)
+      {
+       const double* psip_pt=&table.Psi_p[iplot*n_pres];
+       for(unsigned l=0;l<n_pres;l++)
+        {
+         plot_pressure[iplot]+=psip_pt[l]*pressure[l];
+        }
+      }
+    }
 
    // Tecplot header info
    outfile << this->tecplot_zone_string(nplot);
    
    // Loop over plot points
-   unsigned num_plot_points=this->nplot_points(nplot);
    for (unsigned iplot=0;iplot<num_plot_points;iplot++)
     {
-     // Get local coordinates of plot point
-     this->get_s_plot(iplot,nplot,s);
-     
-     // Get shape fct
-     this->shape(s,psif);
+     const double* plot_row_pt=&plot_values[iplot*n_col];
 
-     // Coordinates
-     Vector<double> x(2);
-     for(unsigned i=0;i<2;i++)
+     // Coordinates and veloc
+     for(unsigned i=0;i<4;i++)
       {
-       x[i]=this->interpolated_x(s,i);
-       outfile << x[i] << " ";
+       outfile << plot_row_pt[i] << " ";
       }
-     
-     // Veloc
-     Vector<double> veloc(2);
-     this->interpolated_u_nst(s,veloc);
-     outfile << veloc[0] << " "
-             << veloc[1] << " ";
 
      // Pressure
-     outfile << this->interpolated_p_nst(s) << " ";
-
-     // Smoothed vorticity
-     double smoothed_vort=0.0;
-     for(unsigned l=0;l<n_node;l++)
-      {
-       smoothed_vort += this->nodal_value(l,Smoothed_vorticity_index)*psif[l];
-      }
-     outfile << smoothed_vort << " ";
+     outfile << plot_pressure[iplot] << " ";
 
-     // Smoothed vorticity derivatives (d/dx, d/dy, d^2/dx^2, d^2/dxdy, d^2/dy^2
-     // d^3/dx^3, d^3/dx^2dy, d^3/dxdy^2, d^3/dy^3,
+     // Smoothed vorticity and its derivatives (d/dx, d/dy, d^2/dx^2, 
+     // d^2/dxdy, d^2/dy^2, d^3/dx^3, d^3/dx^2dy, d^3/dxdy^2, d^3/dy^3,
      // du/dx, du/dy, dv/dx, dv/dy
-     for (unsigned i=1;i<14;i++) // hierher was 10
+     for (unsigned i=4;i<n_col;i++) 
       {
-       double smoothed_vort_deriv=0.0;
-       for(unsigned l=0;l<n_node;l++)
-        {
-         smoothed_vort_deriv+=
-          this->nodal_value(l,Smoothed_vorticity_index+i)*psif[l];
-        }
-       outfile << smoothed_vort_deriv << " ";
+       outfile << plot_row_pt[i] << " ";
       }
 
      outfile << std::endl;
@@ -376,6 +601,77 @@ public:
   }
 
 
+ /// \short Shape functions at the plot points for a given nplot,
+ /// stored row-wise: Psi[iplot*Nnode+l] is the l-th (geometric/velocity)
+ /// shape function at plot point iplot; ditto Psi_p for the pressure
+ /// shape functions.
+ class PlotPointShapeTable
+ {
+ public:
+
+  /// Number of plot points
+  unsigned Nplot_points;
+
+  /// Number of nodes
+  unsigned Nnode;
+
+  /// Number of pressure dofs
+  unsigned Npres;
+
+  /// Shape functions at plot points (Nplot_points x Nnode)
+  Vector<double> Psi;
+
+  /// Pressure shape functions at plot points (Nplot_points x Npres)
+  Vector<double> Psi_p;
+ };
+
+ /// \short Shape functions at the plot points. The local coordinates
+ /// of the plot points are the same in every element so the table 
+ /// is computed once per nplot (and element type) and then re-used.
+ const PlotPointShapeTable& plot_point_shape_table(const unsigned& nplot)
+  {
+   // Already tabulated?
+   typename std::map<unsigned,PlotPointShapeTable>::iterator it=
+    Plot_point_shape_table.find(nplot);
+   if (it!=Plot_point_shape_table.end())
+    {
+     return it->second;
+    }
+
+   // Make new one
+   PlotPointShapeTable& table=Plot_point_shape_table[nplot];
+   table.Nplot_points=this->nplot_points(nplot);
+   table.Nnode=this->nnode();
+   table.Npres=this->npres_nst();
+   table.Psi.resize(table.Nplot_points*table.Nnode);
+   table.Psi_p.resize(table.Nplot_points*table.Npres);
+
+   // Shape functions
+   Shape psif(table.Nnode);
+   Shape psip(table.Npres);
+   Vector<double> s(2);
+   for (unsigned iplot=0;iplot<table.Nplot_points;iplot++)
+    {
+     // Get local coordinates of plot point
+     this->get_s_plot(iplot,nplot,s);
+     
+     // Get shape fcts
+     this->shape(s,psif);
+     this->pshape_nst(s,psip);
+     for(unsigned l=0;l<table.Nnode;l++)
+      {
+       table.Psi[iplot*table.Nnode+l]=psif[l];
+      }
+     for(unsigned l=0;l<table.Npres;l++)
+      {
+       table.Psi_p[iplot*table.Npres+l]=psip[l];
+      }
+    }
+
+   return table;
+  }
+
+
  /// Get raw derivative of velocity
  void get_raw_velocity_deriv(const Vector<double>& s,
                              Vector<double>& dveloc_dx) const
@@ -710,10 +1006,75 @@ public:
  /// derivs (for validation).
  ExactVorticityFctPt Exact_vorticity_fct_pt;
 
+ /// \short Is the element an axis-aligned rectangle with an affine 
+ /// mapping (then the fast path for the mapping is used)?
+ bool Affine_rectangle;
+
+ /// Centre of the (affine) rectangle
+ double Centre[2];
+
+ /// Half widths of the (affine) rectangle: x_i = c_i + h_i s_i
+ double Half_width[2];
+
+ /// Inverses of the half widths
+ double Inverse_half_width[2];
+
+ /// Jacobian of the (affine) mapping
+ double Jacobian_determinant;
+
+ /// \short Number of nodes and integration points for which the knot
+ /// tables have been computed
+ static unsigned Knot_nnode;
+ static unsigned Knot_nintpt;
+
+ /// \short Shape functions at the integration points (Knot_nintpt x
+ /// Knot_nnode). Shared by all elements of this type.
+ static std::vector<double> Knot_psi;
+
+ /// \short Local derivatives of the shape functions at the integration
+ /// points (Knot_nintpt x Knot_nnode x 2). Shared by all elements of 
+ /// this type.
+ static std::vector<double> Knot_dpsids;
+
+ /// \short Shape functions at plot points, tabulated for each nplot
+ /// used so far. Shared by all elements of this type.
+ static std::map<unsigned,PlotPointShapeTable> Plot_point_shape_table;
 
 };
 
 
+//===============================================
+/// Shape functions at plot points, tabulated for 
+/// each nplot used so far
+//===============================================
+template<class ELEMENT>
+std::map<unsigned,
+         typename VorticitySmootherElement<ELEMENT>::PlotPointShapeTable> 
+VorticitySmootherElement<ELEMENT>::Plot_point_shape_table;
+
+//===============================================
+/// Sizes of the tables of the shape functions 
+/// (and their local derivatives) at the knots 
+//===============================================
+template<class ELEMENT>
+unsigned VorticitySmootherElement<ELEMENT>::Knot_nnode=0;
+template<class ELEMENT>
+unsigned VorticitySmootherElement<ELEMENT>::Knot_nintpt=0;
+
+//===============================================
+/// Shape functions at the knots
+//===============================================
+template<class ELEMENT>
+std::vector<double> VorticitySmootherElement<ELEMENT>::Knot_psi;
+
+//===============================================
+/// Local derivatives of the shape functions at
+/// the knots
+//===============================================
+template<class ELEMENT>
+std::vector<double> VorticitySmootherElement<ELEMENT>::Knot_dpsids;
+
+
 } // end namespace extension
 
 
@@ -739,7 +1100,7 @@ class VorticitySmoother
  
  /// Constructor: Set order of recovery shape functions
  VorticitySmoother(const unsigned& recovery_order) : 
-  Recovery_order(recovery_order)
+  Recovery_order(recovery_order), Patch_mesh_pt(0)
   {}
  
   /// Broken copy constructor
@@ -754,8 +1115,37 @@ class VorticitySmoother
    BrokenCopy::broken_assign("VorticitySmoother");
   }
  
- /// Empty virtual destructor
- virtual ~VorticitySmoother(){}
+ /// Destructor: Wipe the patches
+ virtual ~VorticitySmoother()
+  {
+   invalidate_patches();
+  }
+
+ /// \short Set up the patches for the given mesh (unless they've 
+ /// already been set up for it). They're kept (and used in
+ /// recover_vorticity(...)) until invalidate_patches() is called, which
+ /// has to be done whenever the mesh has been adapted.
+ void setup_patches(Mesh* mesh_pt)
+  {
+   if ((mesh_pt==Patch_mesh_pt)&&(!Adjacent_elements_pt.empty())) return;
+   invalidate_patches();
+   setup_patches(mesh_pt,Adjacent_elements_pt,Vertex_node_pt);
+   Patch_mesh_pt=mesh_pt;
+  }
+
+ /// Wipe the patches
+ void invalidate_patches()
+  {
+   for (typename std::map<Node*,Vector<ELEMENT*>*>::iterator it=
+         Adjacent_elements_pt.begin();
+        it!=Adjacent_elements_pt.end();it++)
+    {
+     delete it->second;
+    }
+   Adjacent_elements_pt.clear();
+   Vertex_node_pt.clear();
+   Patch_mesh_pt=0;
+  }
  
  /// Access function for order of recovery polynomials
  unsigned& recovery_order() {return Recovery_order;}
@@ -1348,13 +1738,11 @@ class VorticitySmoother
    
    double t_start=TimingHelpers::timer();
 
-   // Make patches
-   //-------------
-   std::map<Node*,Vector<ELEMENT*>*> adjacent_elements_pt;
-   Vector<Node*> vertex_node_pt;
-   setup_patches(mesh_pt,
-                 adjacent_elements_pt,
-                 vertex_node_pt);
+   // Make patches (unless we have them already)
+   //-------------------------------------------
+   setup_patches(mesh_pt);
+   std::map<Node*,Vector<ELEMENT*>*>& adjacent_elements_pt=
+    Adjacent_elements_pt;
    
    // Determine number of coefficients for expansion of recovered vorticity
    // Use complete polynomial of given order for recovery
@@ -1457,14 +1845,6 @@ class VorticitySmoother
      
     } // end of loop over derivatives
 
-   // Cleanup
-   for (typename std::map<Node*,Vector<ELEMENT*>*>::iterator it=
-         adjacent_elements_pt.begin();
-        it!=adjacent_elements_pt.end();it++)
-    {
-     delete it->second;
-    }
-
    oomph_info << "Time for vorticity recovery: " 
               << TimingHelpers::timer()-t_start 
               << " sec " << std::endl;
@@ -1475,5 +1855,16 @@ class VorticitySmoother
  /// Order of recovery polynomials
  unsigned Recovery_order;
 
+ /// \short The mesh for which the patches have been set up (null if
+ /// there are none)
+ Mesh* Patch_mesh_pt;
+
+ /// \short Elements in the patch around each vertex node (see
+ /// setup_patches(...))
+ std::map<Node*,Vector<ELEMENT*>*> Adjacent_elements_pt;
+
+ /// Vertex nodes (see setup_patches(...))
+ Vector<Node*> Vertex_node_pt;
+
 };
 